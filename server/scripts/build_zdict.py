@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+从抓到的聊天包生成 zlib 预置字典，见 src/common/msg.h 中的“预置字典压缩”。
+
+输入两种格式：
+  --frames  抓包得到的 TCP 字节流（服务器发给客户端或客户端发给服务器的一个方向），
+            里面是连续的 v1（chat_msg_header）或 v2 帧，压缩的包体会先解压
+  --lines   每行一个包体（比如从日志里导出的 JSON）
+
+做法是简化的 COVER 算法：统计 d 字节的子串出现在多少个样本里，把样本切成 k 字节的片段，
+按片段里还没被覆盖的子串的样本数打分，贪心地挑分数最高的片段，直到字典达到 --size。
+分数越高的片段放得越靠后，zlib 匹配距离越近编码越短。
+每 10 个样本留 1 个不参与训练，最后用它们对比有无字典的压缩率。
+
+用法：
+  build_zdict.py --frames capture.bin -o chat.zdict
+  build_zdict.py --lines payloads.txt --size 2048 -o chat.zdict
+生成的字典用 ZlibUtil::loadDictionary() 加载，打印出来的 dictid 就是帧头里的 chat_msg_header::dictid。
+字典越大每次压缩的 deflateSetDictionary 越慢（约 2ns/字节），一般 2~4KB 就够了。
+"""
+
+import argparse
+import heapq
+import struct
+import sys
+import zlib
+from collections import Counter
+
+HEADER_LEN = 25             # sizeof(chat_msg_header)
+MAX_BODY = 0x10000000       # BINARY_PACKAGE_MAXLEN_2
+
+
+def read_varint(buf, pos, end):
+    value = 0
+    shift = 0
+    while pos < end and shift < 35:
+        c = buf[pos]
+        pos += 1
+        value |= (c & 0x7F) << shift
+        shift += 7
+        if not c & 0x80:
+            return value, pos
+    return None, pos
+
+
+def parse_frames(data):
+    """按帧切开字节流，返回解压后的包体列表"""
+    bodies = []
+    pos = 0
+    while pos < len(data):
+        flag = data[pos]
+        if flag & 0xFC == 0xC0:
+            body_len, p = read_varint(data, pos + 1, len(data))
+            if body_len is None or p + body_len > len(data):
+                break
+            body = data[p:p + body_len]
+            pos = p + body_len
+            if flag & 0x01:
+                _, q = read_varint(body, 0, len(body))
+                body = zlib.decompress(body[q:])
+            bodies.append(body)
+            continue
+
+        if len(data) - pos < HEADER_LEN:
+            break
+        compressflag, originsize, compresssize, dictid = struct.unpack_from("<biiI", data, pos)
+        if compressflag not in (0, 1) or not 0 <= originsize <= MAX_BODY:
+            sys.exit("bad frame header at offset %d" % pos)
+        body_len = compresssize if compressflag else originsize
+        start = pos + HEADER_LEN
+        if start + body_len > len(data):
+            break
+        body = data[start:start + body_len]
+        pos = start + body_len
+        if compressflag:
+            if dictid != 0:
+                # 已经用字典压缩过的包没法在这里解，跳过
+                continue
+            body = zlib.decompress(body)
+        bodies.append(body)
+    return bodies
+
+
+def load_samples(args):
+    samples = []
+    for name in args.frames or []:
+        with open(name, "rb") as f:
+            samples.extend(parse_frames(f.read()))
+    for name in args.lines or []:
+        with open(name, "rb") as f:
+            samples.extend(line.rstrip(b"\r\n") for line in f)
+    return [s for s in samples if s]
+
+
+def build(samples, size, d, k):
+    # 每个 d 字节子串出现在多少个样本里
+    freq = Counter()
+    for s in samples:
+        freq.update({s[i:i + d] for i in range(len(s) - d + 1)})
+
+    def score(seg, covered):
+        return sum(freq[g] for g in {seg[i:i + d] for i in range(len(seg) - d + 1)}
+                   if g not in covered and freq[g] > 1)
+
+    # 候选片段去重，每隔 d/2 字节取一个
+    step = max(1, d // 2)
+    candidates = set()
+    for s in samples:
+        for i in range(0, max(1, len(s) - k + 1), step):
+            candidates.add(s[i:i + k])
+
+    covered = set()
+    heap = [(-score(c, covered), c) for c in candidates]
+    heapq.heapify(heap)
+
+    # 懒惰贪心：弹出的片段重新打分，仍然不低于堆顶才选中
+    picked = []
+    total = 0
+    while heap and total < size:
+        neg, seg = heapq.heappop(heap)
+        cur = score(seg, covered)
+        if cur <= 0:
+            continue
+        if heap and cur < -heap[0][0]:
+            heapq.heappush(heap, (-cur, seg))
+            continue
+        picked.append(seg)
+        total += len(seg)
+        covered.update(seg[i:i + d] for i in range(len(seg) - d + 1))
+
+    # 先选中的分数高，放到最后
+    return b"".join(reversed(picked))[-size:]
+
+
+def compressed_size(samples, zdict=None):
+    total = 0
+    for s in samples:
+        c = zlib.compressobj(6, zlib.DEFLATED, 15, 8, zlib.Z_DEFAULT_STRATEGY, zdict) if zdict else zlib.compressobj(6)
+        total += len(c.compress(s) + c.flush())
+    return total
+
+
+def main():
+    parser = argparse.ArgumentParser(description="build a zlib preset dictionary from captured chat traffic")
+    parser.add_argument("--frames", nargs="*", help="captured TCP byte streams of chat frames")
+    parser.add_argument("--lines", nargs="*", help="text files with one payload per line")
+    parser.add_argument("-o", "--output", required=True, help="dictionary file to write")
+    parser.add_argument("--size", type=int, default=2048, help="dictionary size in bytes (<= 32768)")
+    parser.add_argument("-d", type=int, default=8, help="length of the substrings counted")
+    parser.add_argument("-k", type=int, default=48, help="length of the segments copied into the dictionary")
+    args = parser.parse_args()
+
+    if not args.frames and not args.lines:
+        parser.error("need --frames or --lines")
+    if not 0 < args.size <= 32768:
+        parser.error("--size must be in (0, 32768]")
+
+    samples = load_samples(args)
+    if len(samples) < 10:
+        sys.exit("need at least 10 samples, got %d" % len(samples))
+
+    train = [s for i, s in enumerate(samples) if i % 10 != 9]
+    test = [s for i, s in enumerate(samples) if i % 10 == 9]
+    zdict = build(train, args.size, args.d, args.k)
+    with open(args.output, "wb") as f:
+        f.write(zdict)
+
+    raw = sum(len(s) for s in test)
+    plain = compressed_size(test)
+    with_dict = compressed_size(test, zdict)
+    print("samples: %d train, %d test, dictionary %d bytes" % (len(train), len(test), len(zdict)))
+    print("dictid: %u" % (zlib.adler32(zdict) & 0xFFFFFFFF))
+    print("test set: raw %d, zlib %d (%.3f), zlib+dict %d (%.3f)" % (
+        raw, plain, plain / raw, with_dict, with_dict / raw))
+
+
+if __name__ == "__main__":
+    main()
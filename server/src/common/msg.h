@@ -55,10 +55,46 @@ struct chat_msg_header
     char     compressflag;     //压缩标志，如果为1，则启用压缩，反之不启用压缩
     int32_t  originsize;       //包体压缩前大小
     int32_t  compresssize;     //包体压缩后大小
-    char     reserved[16];
+    uint32_t dictid;           //压缩用的预置字典 id（字典内容的 adler32），0 表示没有使用字典
+    char     reserved[12];
 };
 #pragma pack(pop)
 
+/**
+ *  预置字典压缩
+ **/
+/*
+    字典由 scripts/build_zdict.py 从抓到的包体离线生成，服务器启动时用 ZlibUtil::loadDictionary() 加载，
+    id 就是字典内容的 adler32，和 zlib 流头里的 DICTID 一致。
+    协商：客户端发来的帧 dictid 不为 0 且服务器加载了这个字典时，服务器对这个连接也用这个字典压缩
+    （TcpSession::set_dict_id()），否则 dictid 填 0，按原来的方式压缩。只用于 v1 帧
+ **/
+
+/**
+ *  紧凑协议 v2
+ **/
+/*
+    帧格式：flag(1字节) + 包体长度(7bit编码) + [压缩前大小(7bit编码)，仅压缩时] + 包体
+    flag 的高 6 位固定为 0xC0，v1 包头第一个字节 compressflag 只能是 0 或 1，两种帧可以按第一个字节区分
+    flag & 0x01: 包体经过 zlib 压缩
+    flag & 0x02: 批量帧，包体里有多条消息
+
+    单条消息的包体：cmd(7bit编码) + seq(7bit编码) + data，data 长度就是包体剩下的部分
+    批量帧的包体：重复 [消息长度(7bit编码) + cmd(7bit编码) + seq(7bit编码) + data]，消息长度不含自身
+    cmd、seq 按 uint32 编码，负数占 5 字节
+
+    协商：客户端发出的第一个帧（一般是登录包）用 v2 格式，服务器收到后对这个连接改用 v2 应答，
+    老客户端始终发 v1 帧，服务器始终用 v1 应答。已经按 v1 序列化好的包体（带 targetid 等附加字段）
+    仍以 v1 帧发送，v2 客户端两种帧都要能解
+ **/
+enum
+{
+    CHAT_FRAME_V2_MAGIC         = 0xC0,
+    CHAT_FRAME_V2_MAGIC_MASK    = 0xFC,
+    CHAT_FRAME_V2_COMPRESSED    = 0x01,
+    CHAT_FRAME_V2_BATCH         = 0x02,
+};
+
 //type为1发出加好友申请 2 收到加好友请求(仅客户端使用) 3应答加好友 4删除好友请求 5应答删除好友
 //当type=3时，accept是必须字段，0对方拒绝，1对方接受
 enum friend_operation_type
@@ -2,13 +2,159 @@
  *  ѹ�������࣬ZlibUtil.cpp
  *  zhangyl 2018.03.09
  */
-#include "zlib/zlib.h"
+#include "zlib.h"
 #include <string.h>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <sstream>
 #include "zlibutil.h"
 
 
 #define MAX_COMPRESS_BUF_SIZE 10*1024*1024
 
+namespace
+{
+    //一次性的 compress() 每次都要 deflateInit，分配约 256KB 的窗口和哈希表。
+    //每个线程保留 z_stream，用 deflateReset 复用。deflateReset 还要清零哈希表，
+    //默认 memLevel 8 的哈希表 64KB，清零比压缩一个小包还慢，所以小包用一个 memLevel 低的上下文，
+    //输出仍然是标准的 zlib 格式，对端用 uncompress() 解
+    struct DeflateContext
+    {
+        z_stream    zs;
+        bool        inited;
+        const int   memLevel;
+        int         level;
+
+        explicit DeflateContext(int nMemLevel) : inited(false), memLevel(nMemLevel), level(Z_DEFAULT_COMPRESSION) { memset(&zs, 0, sizeof(zs)); }
+        ~DeflateContext()
+        {
+            if (inited)
+                ::deflateEnd(&zs);
+        }
+
+        z_stream* get(int nLevel)
+        {
+            if (!inited)
+            {
+                //默认和 compress() 一样的压缩级别和 zlib 格式
+                if (::deflateInit2(&zs, nLevel, Z_DEFLATED, MAX_WBITS, memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+                    return NULL;
+                inited = true;
+                level = nLevel;
+                return &zs;
+            }
+
+            if (::deflateReset(&zs) != Z_OK)
+                return NULL;
+            //刚 reset 还没有输入，换级别只是改参数
+            if (nLevel != level)
+            {
+                if (::deflateParams(&zs, nLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+                    return NULL;
+                level = nLevel;
+            }
+            return &zs;
+        }
+    };
+
+    struct InflateContext
+    {
+        z_stream    zs;
+        bool        inited;
+
+        InflateContext() : inited(false) { memset(&zs, 0, sizeof(zs)); }
+        ~InflateContext()
+        {
+            if (inited)
+                ::inflateEnd(&zs);
+        }
+
+        z_stream* get()
+        {
+            if (!inited)
+            {
+                if (::inflateInit(&zs) != Z_OK)
+                    return NULL;
+                inited = true;
+            }
+            else if (::inflateReset(&zs) != Z_OK)
+            {
+                return NULL;
+            }
+            return &zs;
+        }
+    };
+
+    //不超过这个长度的输入用 t_deflateSmall
+    const size_t SMALL_COMPRESS_SIZE = 4096;
+
+    thread_local DeflateContext t_deflate(8);                     //和 compress() 相同
+    thread_local DeflateContext t_deflateSmall(5);                //哈希表 8KB
+    thread_local InflateContext t_inflate;
+
+    std::atomic<size_t> g_minCompressSize(64);
+
+    //预置字典，启动时加载，之后只读
+    std::map<uint32_t, std::string>& dictionaries()
+    {
+        static std::map<uint32_t, std::string> dicts;
+        return dicts;
+    }
+
+    const std::string* findDictionary(uint32_t nDictId)
+    {
+        std::map<uint32_t, std::string>::const_iterator it = dictionaries().find(nDictId);
+        return it == dictionaries().end() ? NULL : &it->second;
+    }
+
+    //用 ctx 压缩到 pDestBuf，nDestBufLength 传入可用空间，返回压缩后的大小
+    bool deflateWith(DeflateContext& ctx, const char* pSrcBuf, size_t nSrcBufLength, char* pDestBuf, size_t& nDestBufLength, const std::string* pDict, int nLevel)
+    {
+        z_stream* zs = ctx.get(nLevel);
+        if (zs == NULL)
+            return false;
+
+        //deflateReset 会清掉字典，每次都要重新设置，耗时和字典长度成正比
+        if (pDict != NULL && ::deflateSetDictionary(zs, (const Bytef*)pDict->data(), (uInt)pDict->length()) != Z_OK)
+            return false;
+
+        zs->next_in = (Bytef*)pSrcBuf;
+        zs->avail_in = (uInt)nSrcBufLength;
+        zs->next_out = (Bytef*)pDestBuf;
+        zs->avail_out = (uInt)nDestBufLength;
+        if (::deflate(zs, Z_FINISH) != Z_STREAM_END)
+            return false;
+
+        nDestBufLength = zs->total_out;
+        return true;
+    }
+
+    //压缩到 pDestBuf，nDestBufLength 传入可用空间，返回压缩后的大小
+    bool deflateTo(const char* pSrcBuf, size_t nSrcBufLength, char* pDestBuf, size_t& nDestBufLength, const std::string* pDict = NULL, int nLevel = Z_DEFAULT_COMPRESSION)
+    {
+        if (nSrcBufLength > SMALL_COMPRESS_SIZE)
+            return deflateWith(t_deflate, pSrcBuf, nSrcBufLength, pDestBuf, nDestBufLength, pDict, nLevel);
+
+        //compressBound() 是按 memLevel 8 算的，压不下来的数据在小窗口下会分成更多的存储块，可能放不下，这时换大窗口重压
+        size_t nAvailLength = nDestBufLength;
+        if (deflateWith(t_deflateSmall, pSrcBuf, nSrcBufLength, pDestBuf, nDestBufLength, pDict, nLevel))
+            return true;
+        nDestBufLength = nAvailLength;
+        return deflateWith(t_deflate, pSrcBuf, nSrcBufLength, pDestBuf, nDestBufLength, pDict, nLevel);
+    }
+}
+
+void ZlibUtil::setMinCompressSize(size_t nSize)
+{
+    g_minCompressSize = nSize;
+}
+
+size_t ZlibUtil::getMinCompressSize()
+{
+    return g_minCompressSize;
+}
+
 bool ZlibUtil::compressBuf(const char* pSrcBuf, size_t nSrcBufLength, char* pDestBuf, size_t & nDestBufLength)
 {
 
@@ -18,68 +164,113 @@ bool ZlibUtil::compressBuf(const char* pSrcBuf, size_t nSrcBufLength, char* pDes
 
     nDestBufLength = compressBound(nSrcBufLength);
 
-    //ѹ��
-    int ret = compress((Bytef*)pDestBuf, (uLongf*)& nDestBufLength, (const Bytef*)pSrcBuf, nSrcBufLength);
-    if (ret != Z_OK)
-        return false;
-
-    return true;
+    //压缩
+    return deflateTo(pSrcBuf, nSrcBufLength, pDestBuf, nDestBufLength);
 }
 
 bool ZlibUtil::compressBuf(const std::string& strSrcBuf, std::string& strDestBuf)
 {
-    if (strSrcBuf.empty())
-        return false;
+    return compressBuf(strSrcBuf.c_str(), strSrcBuf.length(), strDestBuf);
+}
 
-    int nSrcLength = strSrcBuf.length();
-    if (nSrcLength > MAX_COMPRESS_BUF_SIZE)
-        return false;
+bool ZlibUtil::compressBuf(const char* pSrcBuf, size_t nSrcBufLength, std::string& strDestBuf)
+{
+    return compressBuf(pSrcBuf, nSrcBufLength, strDestBuf, 0);
+}
 
-    int nDestBufLength = compressBound(nSrcLength);
-    if (nDestBufLength <= 0)
+bool ZlibUtil::compressBuf(const char* pSrcBuf, size_t nSrcBufLength, std::string& strDestBuf, uint32_t nDictId, int nLevel/* = -1*/)
+{
+    if (pSrcBuf == NULL || nSrcBufLength == 0 || nSrcBufLength > MAX_COMPRESS_BUF_SIZE)
+        return false;
+    if (nLevel < Z_DEFAULT_COMPRESSION || nLevel > Z_BEST_COMPRESSION)
         return false;
 
-    char* pDestBuf = new char[nDestBufLength];
-    memset(pDestBuf, 0, nDestBufLength * sizeof(char));
+    const std::string* pDict = NULL;
+    if (nDictId != 0)
+    {
+        pDict = findDictionary(nDictId);
+        if (pDict == NULL)
+            return false;
+    }
 
-    //ѹ��
-    int ret = compress((Bytef*)pDestBuf, (uLongf*)& nDestBufLength, (const Bytef*)strSrcBuf.c_str(), nSrcLength);
-    if (ret != Z_OK)
+    //先按上限扩容，压缩完再截到实际大小。用字典时 zlib 流头多 4 字节的 DICTID，compressBound 没算在内
+    size_t nOldLength = strDestBuf.length();
+    size_t nDestBufLength = compressBound(nSrcBufLength) + (pDict != NULL ? 4 : 0);
+    strDestBuf.resize(nOldLength + nDestBufLength);
+    if (!deflateTo(pSrcBuf, nSrcBufLength, &strDestBuf[nOldLength], nDestBufLength, pDict, nLevel))
     {
-        delete[] pDestBuf;
+        strDestBuf.resize(nOldLength);
         return false;
     }
 
-    strDestBuf.append(pDestBuf, nDestBufLength);
-    delete[] pDestBuf;
-
+    strDestBuf.resize(nOldLength + nDestBufLength);
     return true;
 }
 
 bool ZlibUtil::uncompressBuf(const std::string& strSrcBuf, std::string& strDestBuf, size_t nDestBufLength)
 {
-    char* pDestBuf = new char[nDestBufLength];
-    memset(pDestBuf, 0, nDestBufLength * sizeof(char));
-    int nPrevDestBufLength = nDestBufLength;
-    //��ѹ��
-    int ret = uncompress((Bytef*)pDestBuf, (uLongf*)& nDestBufLength, (const Bytef*)strSrcBuf.c_str(), strSrcBuf.length());
-    if (ret != Z_OK)
+    return uncompressBuf(strSrcBuf.c_str(), strSrcBuf.length(), strDestBuf, nDestBufLength);
+}
+
+bool ZlibUtil::uncompressBuf(const char* pSrcBuf, size_t nSrcBufLength, std::string& strDestBuf, size_t nDestBufLength)
+{
+    z_stream* zs = t_inflate.get();
+    if (zs == NULL)
+        return false;
+
+    size_t nOldLength = strDestBuf.length();
+    strDestBuf.resize(nOldLength + nDestBufLength);
+
+    //解压
+    zs->next_in = (Bytef*)pSrcBuf;
+    zs->avail_in = (uInt)nSrcBufLength;
+    zs->next_out = (Bytef*)&strDestBuf[nOldLength];
+    zs->avail_out = (uInt)nDestBufLength;
+    int ret = ::inflate(zs, Z_FINISH);
+    if (ret == Z_NEED_DICT)
+    {
+        //需要字典时 zs->adler 就是流头里的 DICTID
+        const std::string* pDict = findDictionary((uint32_t)zs->adler);
+        if (pDict != NULL && ::inflateSetDictionary(zs, (const Bytef*)pDict->data(), (uInt)pDict->length()) == Z_OK)
+            ret = ::inflate(zs, Z_FINISH);
+    }
+    if (ret != Z_STREAM_END)
     {
-        delete[] pDestBuf;
+        strDestBuf.resize(nOldLength);
         return false;
     }
 
-    //if (nPrevDestBufLength == nDestBufLength)
-    //{
-    //    int k = 0;
-    //    k++;
-    //}
-    strDestBuf.append(pDestBuf, nDestBufLength);
-    delete[] pDestBuf;
-
+    strDestBuf.resize(nOldLength + zs->total_out);
     return true;
 }
 
+uint32_t ZlibUtil::addDictionary(const std::string& strDict)
+{
+    if (strDict.empty())
+        return 0;
+
+    uint32_t nDictId = (uint32_t)::adler32(::adler32(0L, Z_NULL, 0), (const Bytef*)strDict.data(), (uInt)strDict.length());
+    dictionaries()[nDictId] = strDict;
+    return nDictId;
+}
+
+bool ZlibUtil::loadDictionary(const std::string& strFile, uint32_t& nDictId)
+{
+    std::ifstream file(strFile.c_str(), std::ios::in | std::ios::binary);
+    if (!file)
+        return false;
+
+    std::ostringstream oss;
+    oss << file.rdbuf();
+    nDictId = addDictionary(oss.str());
+    return nDictId != 0;
+}
+
+bool ZlibUtil::hasDictionary(uint32_t nDictId)
+{
+    return nDictId != 0 && findDictionary(nDictId) != NULL;
+}
+
 bool ZlibUtil::deflate(const std::string& strSrc, std::string& strDest)
 {
     int err = Z_DATA_ERROR;
@@ -1,6 +1,7 @@
 #ifndef __ZLIB_UTIL_H__
 #define __ZLIB_UTIL_H__
 #include <string>
+#include <stdint.h>
 
 class ZlibUtil
 {
@@ -10,9 +11,29 @@ private:
     ZlibUtil(const ZlibUtil& rhs) = delete;
 
 public:
+    //compressBuf/uncompressBuf 使用每个线程自己的 z_stream，只在线程第一次调用时初始化，
+    //之后每次 deflateReset/inflateReset，输出格式和一次性的 compress()/uncompress() 相同
     static bool compressBuf(const char* pSrcBuf, size_t nSrcBufLength, char* pDestBuf, size_t& nDestBufLength);
     static bool compressBuf(const std::string& strSrcBuf, std::string& strDestBuf);
+    //压缩结果直接追加到 strDestBuf 末尾，不经过临时缓冲区
+    static bool compressBuf(const char* pSrcBuf, size_t nSrcBufLength, std::string& strDestBuf);
     static bool uncompressBuf(const std::string& strSrcBuf, std::string& strDestBuf, size_t nDestBufLength);
+    //解压结果直接追加到 strDestBuf 末尾，nDestBufLength 是解压后的大小
+    static bool uncompressBuf(const char* pSrcBuf, size_t nSrcBufLength, std::string& strDestBuf, size_t nDestBufLength);
+
+    //按预置字典压缩，nDictId 为 0 时和不带字典的版本相同。
+    //解压不需要传字典 id，zlib 流头里带着 DICTID，uncompressBuf 自动找已加载的字典。
+    //nLevel 是 zlib 压缩级别 0~9，-1 是默认级别（6）
+    static bool compressBuf(const char* pSrcBuf, size_t nSrcBufLength, std::string& strDestBuf, uint32_t nDictId, int nLevel = -1);
+
+    //加载预置字典，返回字典 id（字典内容的 adler32）。只能在启动时、还没有线程压缩解压之前调用
+    static uint32_t addDictionary(const std::string& strDict);
+    static bool loadDictionary(const std::string& strFile, uint32_t& nDictId);
+    static bool hasDictionary(uint32_t nDictId);
+
+    //小于这个长度的包不压缩，直接以 compressflag = 0 发送，默认 64 字节，0 表示全部压缩
+    static void setMinCompressSize(size_t nSize);
+    static size_t getMinCompressSize();
 
     //gzipѹ��
     static bool inflate(const std::string& strSrc, std::string& dest);
@@ -56,6 +56,14 @@ bool ConfigParser::whisp_load_config(const std::string &file_name, struct WhispC
                 whisp_config.mysql_config.database = config["mysql"]["database"].as<std::string>();
         }
 
+        // 解析绑核配置
+        if (config["affinity"]) {
+            if (config["affinity"]["enable"].IsDefined())
+                whisp_config.affinity_config.affinity_enable = config["affinity"]["enable"].as<bool>();
+            if (config["affinity"]["log_cpus"].IsDefined())
+                whisp_config.affinity_config.log_cpus = config["affinity"]["log_cpus"].as<std::vector<int>>();
+        }
+
         return true;
 
     } catch (const YAML::Exception& e) {
@@ -94,4 +102,18 @@ void ConfigParser::whisp_print_config(const struct WhispConfig& whisp_config) {
     std::cout << "  User: " << whisp_config.mysql_config.user << std::endl;
     std::cout << "  Password: " << whisp_config.mysql_config.password << std::endl;
     std::cout << "  Database: " << whisp_config.mysql_config.database << std::endl;
+
+    // 打印绑核配置
+    auto print_cpus = [](const std::vector<int>& cpus) {
+        std::string str;
+        for (size_t i = 0; i < cpus.size(); ++i) {
+            if (i > 0)
+                str += ",";
+            str += std::to_string(cpus[i]);
+        }
+        return str.empty() ? std::string("any") : str;
+    };
+    std::cout << "Affinity Config:" << std::endl;
+    std::cout << "  Enable: " << (whisp_config.affinity_config.affinity_enable ? "true" : "false") << std::endl;
+    std::cout << "  Log CPUs: " << print_cpus(whisp_config.affinity_config.log_cpus) << std::endl;
 }
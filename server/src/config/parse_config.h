@@ -2,6 +2,7 @@
 #define PARSE_CONFIG_H
 
 #include <string>
+#include <vector>
 #include <yaml-cpp/yaml.h>
 
 struct ClientConfig {
@@ -34,12 +35,19 @@ struct MysqlConfig {
     std::string database;
 };
 
+// 线程绑核，见 util/cpu_affinity.h
+struct AffinityConfig {
+    bool affinity_enable = false;
+    std::vector<int> log_cpus;      // 日志写线程可用的核，空表示不限制
+};
+
 struct WhispConfig {
     struct ClientConfig client_config;
     struct MonitorConfig monitor_config;
     struct HttpConfig http_config;
     struct LogConfig log_config;
     struct MysqlConfig mysql_config;
+    struct AffinityConfig affinity_config;
 };
 
 class ConfigParser {
@@ -1,4 +1,5 @@
 #include "whisp_log.h"
+#include "util/cpu_affinity.h"
 // #include <ctime>
 // #include <time.h>
 // #include <stdio.h>
@@ -524,6 +525,14 @@ bool WhispLog::write2file(const std::string& data)
     return true;
 }
 
+bool WhispLog::log_set_cpus(const std::vector<int>& cpus)
+{
+    if (!write_thread_pool_)
+        return false;
+
+    return cpu_bind_thread(*write_thread_pool_, cpus);
+}
+
 void WhispLog::crash()  // dump掉
 {
     char *p = nullptr;
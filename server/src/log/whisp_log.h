@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <string>
 #include <list>
+#include <vector>
 #include <thread>
 #include <memory>
 #include <mutex>
@@ -63,6 +64,12 @@ public:
 
     void log_set_level(LOG_LEVEL levelv);
 
+    // 这一级的日志会不会输出，参数要现拼字符串的日志先用它判断
+    bool log_enabled(LOG_LEVEL levelv) const { return levelv >= cur_level_ || levelv == LOG_LEVEL_CRITICAL; }
+
+    // 把写日志线程绑到 cpus 中的核上，在 log_init() 之后调用，空表示不绑
+    bool log_set_cpus(const std::vector<int>& cpus);
+
     bool log_isrunning();
 
     bool log_output(LOG_LEVEL levelv, const char* fmt, ...);
@@ -175,6 +175,13 @@ int main(int argc, char* argv[])
         std::cout << "log init return true" << std::endl;
     }
     WHISP_LOG_INFO("[MAIN] Init log module success");
+
+    // 绑核：日志写线程
+    const AffinityConfig& affinity = whisp_config.affinity_config;
+    if (affinity.affinity_enable) {
+        WhispLog::get_instance().log_set_cpus(affinity.log_cpus);
+        WHISP_LOG_INFO("[MAIN] Bind log writer to %d cpus", (int)affinity.log_cpus.size());
+    }
     
     // 初始化数据库配置
     std::string db_server;
@@ -10,6 +10,7 @@ Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reusepor
     : loop_(loop),
     accept_socket_(w_sockets::socks_create_noblocking_or_die()),
     accept_channel_(loop, accept_socket_.fd()),
+    max_accepts_per_wakeup_(default_max_accepts_per_wakeup),
     listening_(false)
 {
 #ifndef WIN32
@@ -42,12 +43,80 @@ void Acceptor::listen()
 void Acceptor::_handle_read()
 {
     loop_->assert_in_loop_thread();
-    InetAddress peerAddr;
-    int connfd = accept_socket_.sock_accept(&peerAddr);
-    if (connfd >= 0)
+    //一次可读事件把 backlog 中排队的连接尽量取完（每次最多 max_accepts_per_wakeup_ 个），
+    //剩下的下一轮 epoll_wait 还会通知
+    int accepted = 0;
+    int rejected = 0;
+    for (int i = 0; i < max_accepts_per_wakeup_; ++i)
     {
-        std::string hostport = peerAddr.inet_2_ipport();
-        WHISP_LOG_DEBUG("Accepts of %s", hostport.c_str());
+        InetAddress peerAddr;
+        int connfd = accept_socket_.sock_accept(&peerAddr);
+        if (connfd < 0)
+        {
+#ifdef WIN32
+            break;
+#else
+            if (errno == EAGAIN)
+                break;
+
+            /*
+            The special problem of accept()ing when you can't
+
+            Many implementations of the POSIX accept function (for example, found in post-2004 Linux)
+            have the peculiar behaviour of not removing a connection from the pending queue in all error cases.
+
+            For example, larger servers often run out of file descriptors (because of resource limits),
+            causing accept to fail with ENFILE but not rejecting the connection, leading to libev signalling
+            readiness on the next iteration again (the connection still exists after all), and typically
+            causing the program to loop at 100% CPU usage.
+
+            Unfortunately, the set of errors that cause this issue differs between operating systems,
+            there is usually little the app can do to remedy the situation, and no known thread-safe
+            method of removing the connection to cope with overload is known (to me).
+
+            One of the easiest ways to handle this situation is to just ignore it - when the program encounters
+            an overload, it will just loop until the situation is over. While this is a form of busy waiting,
+            no OS offers an event-based way to handle this situation, so it's the best one can do.
+
+            A better way to handle the situation is to log any errors other than EAGAIN and EWOULDBLOCK,
+            making sure not to flood the log with such messages, and continue as usual, which at least gives
+            the user an idea of what could be wrong ("raise the ulimit!"). For extra points one could
+            stop the ev_io watcher on the listening fd "for a while", which reduces CPU usage.
+
+            If your program is single-threaded, then you could also keep a dummy file descriptor for overload
+            situations (e.g. by opening /dev/null), and when you run into ENFILE or EMFILE, close it,
+            run accept, close that fd, and create a new dummy fd. This will gracefully refuse clients under
+            typical overload conditions.
+
+            The last way to handle it is to simply log the error and exit, as is often done with malloc
+            failures, but this results in an easy opportunity for a DoS attack.
+            */
+            if (errno == EMFILE || errno == ENFILE)
+            {
+                if (!_reject_with_idle_fd())
+                    break;
+
+                ++rejected;
+                continue;
+            }
+
+            //ECONNABORTED 等错误只影响这一个连接，继续取下一个
+            if (errno == ECONNABORTED || errno == EINTR || errno == EPROTO || errno == EPERM)
+                continue;
+
+            break;
+#endif
+        }
+
+        if (admit_callback_ && !admit_callback_(peerAddr))
+        {
+            _reject(connfd);
+            ++rejected;
+            continue;
+        }
+
+        ++accepted;
+        WHISP_LOG_DEBUG("Accepts of %s", peerAddr.inet_2_ipport().c_str());
         //newConnectionCallback_实际指向TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
         if (new_conn_callback_)
         {
@@ -58,50 +127,40 @@ void Acceptor::_handle_read()
             w_sockets::socks_close(connfd);
         }
     }
-    else
+
+    if (rejected > 0)
     {
-        WHISP_LOG_SYSERROR("in Acceptor::handleRead");
+        //每次可读事件最多一条，不会刷屏
+        WHISP_LOG_WARN("Acceptor fd = %d, accepted %d, rejected %d connections", accept_socket_.fd(), accepted, rejected);
+    }
+}
 
+bool Acceptor::_reject_with_idle_fd()
+{
 #ifndef WIN32
-        /*
-        The special problem of accept()ing when you can't
-
-        Many implementations of the POSIX accept function (for example, found in post-2004 Linux)
-        have the peculiar behaviour of not removing a connection from the pending queue in all error cases.
-
-        For example, larger servers often run out of file descriptors (because of resource limits),
-        causing accept to fail with ENFILE but not rejecting the connection, leading to libev signalling
-        readiness on the next iteration again (the connection still exists after all), and typically
-        causing the program to loop at 100% CPU usage.
-
-        Unfortunately, the set of errors that cause this issue differs between operating systems,
-        there is usually little the app can do to remedy the situation, and no known thread-safe
-        method of removing the connection to cope with overload is known (to me).
-
-        One of the easiest ways to handle this situation is to just ignore it - when the program encounters
-        an overload, it will just loop until the situation is over. While this is a form of busy waiting,
-        no OS offers an event-based way to handle this situation, so it's the best one can do.
-
-        A better way to handle the situation is to log any errors other than EAGAIN and EWOULDBLOCK,
-        making sure not to flood the log with such messages, and continue as usual, which at least gives
-        the user an idea of what could be wrong ("raise the ulimit!"). For extra points one could
-        stop the ev_io watcher on the listening fd "for a while", which reduces CPU usage.
-
-        If your program is single-threaded, then you could also keep a dummy file descriptor for overload
-        situations (e.g. by opening /dev/null), and when you run into ENFILE or EMFILE, close it,
-        run accept, close that fd, and create a new dummy fd. This will gracefully refuse clients under
-        typical overload conditions.
-
-        The last way to handle it is to simply log the error and exit, as is often done with malloc
-        failures, but this results in an easy opportunity for a DoS attack.
-        */
-        if (errno == EMFILE)
-        {
-            ::close(idle_fd_);
-            idle_fd_ = ::accept(accept_socket_.fd(), NULL, NULL);
-            ::close(idle_fd_);
-            idle_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
-        }
-#endif
+    ::close(idle_fd_);
+    int connfd = ::accept(accept_socket_.fd(), NULL, NULL);
+    if (connfd >= 0)
+    {
+        _reject(connfd);
     }
-}
\ No newline at end of file
+    idle_fd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return connfd >= 0;
+#else
+    return false;
+#endif
+}
+
+void Acceptor::_reject(int connfd)
+{
+    //SO_LINGER 为 0 时 close 直接发 RST，服务端不留 TIME_WAIT
+    struct linger lin;
+    lin.l_onoff = 1;
+    lin.l_linger = 0;
+#ifdef WIN32
+    ::setsockopt(connfd, SOL_SOCKET, SO_LINGER, (const char*)&lin, sizeof(lin));
+#else
+    ::setsockopt(connfd, SOL_SOCKET, SO_LINGER, &lin, static_cast<socklen_t>(sizeof lin));
+#endif
+    w_sockets::socks_close(connfd);
+}
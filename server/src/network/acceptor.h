@@ -14,6 +14,11 @@ namespace w_network
     {
     public:
         typedef std::function<void(int sockfd, const InetAddress&)> NewConnectionCallback;
+        //准入控制，返回 false 时新连接直接被拒绝（RST），不会创建 TcpConnection
+        typedef std::function<bool(const InetAddress&)> AdmitCallback;
+
+        //每次可读事件最多 accept 的连接数，避免一次建连风暴把 loop 占满
+        static const int default_max_accepts_per_wakeup = 64;
 
         Acceptor(EventLoop* loop, const InetAddress& listenAddr, bool reuseport);
         ~Acceptor();
@@ -24,17 +29,33 @@ namespace w_network
             new_conn_callback_ = cb;
         }
 
+        void set_admit_callback(const AdmitCallback& cb)
+        {
+            admit_callback_ = cb;
+        }
+
+        void set_max_accepts_per_wakeup(int n)
+        {
+            max_accepts_per_wakeup_ = n > 0 ? n : 1;
+        }
+
+        EventLoop* get_loop() const { return loop_; }
         bool listenning() const { return listening_; }
         void listen();
 
     private:
         void _handle_read();
+        // 资源耗尽（EMFILE/ENFILE）时腾出一个 fd 把排队的连接取出来关掉，返回是否取到了
+        bool _reject_with_idle_fd();
+        static void _reject(int connfd);
 
     private:
         EventLoop* loop_;
         Socket                accept_socket_;
         Channel               accept_channel_;
         NewConnectionCallback new_conn_callback_;
+        AdmitCallback         admit_callback_;
+        int                   max_accepts_per_wakeup_;
         bool                  listening_;
 
 #ifndef WIN32
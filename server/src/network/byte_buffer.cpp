@@ -7,24 +7,28 @@ using namespace w_network;
 const char ByteBuffer::CLRF_[] = "\r\n";
 const size_t ByteBuffer::cheap_prepend;
 const size_t ByteBuffer::initial_size;
+const size_t ByteBuffer::max_read_hint;
 
 
 int32_t ByteBuffer::bb_read_fd(int fd, int* saved_errno)
 {
     // saved an ioctl()/FIONREAD call to tell how much to read
     char extrabuf[65536];
+#ifndef WIN32
+    _shrink_if_oversized();
+    //按预计的大小预留好可写空间，大部分数据直接读进 buffer_，不再拷贝
+    bb_bytes_check_writable(read_hint_);
     const size_t writable = bb_bytes_writeable();
-#ifdef WIN32
-    struct iovec vec[2];
 
-    vec[0].iov_base = _begin() + write_idx_;
+    struct iovec vec[2];
+    vec[0].iov_base = bb_write_beginning();
     vec[0].iov_len = writable;
     vec[1].iov_base = extrabuf;
     vec[1].iov_len = sizeof extrabuf;
     // when there is enough space in this ByteBuffer, don't read into extrabuf.
     // when extrabuf is used, we read 128k-1 bytes at most.
     const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
-    const ssize_t n = w_sockets::socks_readv(fd, vec, iovcnt);
+    const int32_t n = static_cast<int32_t>(w_sockets::socks_readv(fd, vec, iovcnt));
 #else
     const int32_t n = w_sockets::socks_read(fd, extrabuf, sizeof(extrabuf));
 #endif
@@ -35,30 +39,62 @@ int32_t ByteBuffer::bb_read_fd(int fd, int* saved_errno)
 #else
         * saved_errno = errno;
 #endif
+        return n;
     }
-    else if (size_t(n) <= writable)
-    {
+
 #ifdef WIN32
-        //Windows平台需要手动把接收到的数据加入ByteBuffer中，Linux平台已经在 struct iovec 中指定了缓冲区写入位置
-        bb_append(extrabuf, n);
+    //Windows平台需要手动把接收到的数据加入ByteBuffer中
+    bb_append(extrabuf, n);
 #else
-    write_idx_ += n;
-#endif
+    if (size_t(n) <= writable)
+    {
+        //Linux平台已经在 struct iovec 中指定了缓冲区写入位置
+        write_idx_ += n;
     }
     else
     {
-#ifdef WIN32
-        //Windows平台直接将所有的字节放入缓冲区去
-        bb_append(extrabuf, n);
-#else
         //Linux平台把剩下的字节补上去
         write_idx_ = buffer_.size();
         bb_append(extrabuf, n - writable);
-#endif
     }
-    // if (n == writable + sizeof extrabuf)
-    // {
-    //   goto line_30;
-    // }
+    _adjust_read_hint(n);
+#endif
+
     return n;
-}
\ No newline at end of file
+}
+
+void ByteBuffer::_adjust_read_hint(size_t n)
+{
+    if (n >= read_hint_)
+    {
+        //读满了预留的空间，下次预留加倍
+        small_reads_ = 0;
+        read_hint_ = std::min(read_hint_ * 2, max_read_hint);
+    }
+    else if (n <= read_hint_ / 2)
+    {
+        //连续两次都只用了不到一半才减半，避免大小包交替时来回抖动
+        if (++small_reads_ >= 2)
+        {
+            small_reads_ = 0;
+            read_hint_ = std::max(read_hint_ / 2, initial_size);
+        }
+    }
+    else
+    {
+        small_reads_ = 0;
+    }
+}
+
+void ByteBuffer::_shrink_if_oversized()
+{
+    //突发的大包（如远程桌面、群发的大消息）过后，把缓冲区缩回到和当前流量相称的大小。
+    //超过需要的 4 倍才缩，留出余量，避免刚缩完又要扩。
+    //还有没取走的数据时不缩：半个帧留在缓冲区里时，解码器已经为整个帧预留了空间（见 ChatFrameCodec）
+    if (bb_bytes_readable() != 0)
+        return;
+    if (buffer_.size() - cheap_prepend > 4 * read_hint_)
+    {
+        bb_shrink(read_hint_);
+    }
+}
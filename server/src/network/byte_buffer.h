@@ -3,6 +3,7 @@
 #include "platform.h"
 #include <algorithm>
 #include <string>
+#include <vector>
 #include <string.h>     // strlen()
 #include "w_sockets.h"
 #include "inet_endian.h"
@@ -20,11 +21,15 @@ namespace w_network
     public:
         static const size_t cheap_prepend = 8;
         static const size_t initial_size  = 1024;
+        //bb_read_fd() 单次预留的可写空间的上限，超出部分先读到栈上再补进来
+        static const size_t max_read_hint = 64 * 1024;
 
         explicit ByteBuffer(size_t size = initial_size) : 
-            buffer_(cheap_prepend + initial_size),
+            buffer_(cheap_prepend + size),
             read_idx_(cheap_prepend),
-            write_idx_(cheap_prepend) 
+            write_idx_(cheap_prepend),
+            read_hint_(initial_size),
+            small_reads_(0)
         {
         
         }
@@ -34,6 +39,8 @@ namespace w_network
             buffer_.swap(rhs.buffer_);
             std::swap(read_idx_, rhs.read_idx_);
             std::swap(write_idx_, rhs.write_idx_);
+            std::swap(read_hint_, rhs.read_hint_);
+            std::swap(small_reads_, rhs.small_reads_);
         }
 
         size_t bb_bytes_readable() const
@@ -184,7 +191,7 @@ namespace w_network
         {
             //其实相当于把已有数据往前挪动
             bb_bytes_check_writable(len);
-            std::copy(data, data + len, bb_bytes_writeable());
+            std::copy(data, data + len, bb_write_beginning());
             bb_bytes_written(len);
         }
 
@@ -378,9 +385,10 @@ namespace w_network
         void bb_shrink(size_t reserve)
         {
             // FIXME: use vector::shrink_to_fit() in C++ 11 if possible.
-            ByteBuffer other;
-            other.bb_bytes_check_writable(bb_bytes_readable() + reserve);
-            other.bb_append(bb_2_string_piece());
+            ByteBuffer other(bb_bytes_readable() + reserve);
+            other.bb_append(bb_peek(), bb_bytes_readable());
+            other.read_hint_ = read_hint_;
+            other.small_reads_ = small_reads_;
             bb_swap(other);
         }
 
@@ -391,10 +399,17 @@ namespace w_network
 
         /// Read data directly into buffer.
         ///
-        /// It may implement with readv(2)
+        /// Linux 上用 readv(2) 直接读进可写空间，放不下的部分才经过栈上的缓冲区。
+        /// 预留的可写空间按最近几次读到的字节数自适应调整，突发流量过后、数据都取走了时缓冲区会缩回去。
         /// @return result of read(2), @c errno is saved
         int32_t bb_read_fd(int fd, int* saved_errno);        
 
+        /// bb_read_fd() 下一次预计读到的字节数
+        size_t bb_read_hint() const
+        {
+            return read_hint_;
+        }
+
     private:
         char* _begin()
         {
@@ -430,10 +445,15 @@ namespace w_network
             }
         }
 
+        void _adjust_read_hint(size_t n);
+        void _shrink_if_oversized();
+
     private:
         std::vector<char> buffer_;
         size_t read_idx_;
         size_t write_idx_;
+        size_t read_hint_;      // 自适应的单次读取大小
+        int    small_reads_;    // 连续读到不足 read_hint_ 一半的次数
 
         static const char CLRF_[];
     };
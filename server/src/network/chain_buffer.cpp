@@ -0,0 +1,205 @@
+#include "chain_buffer.h"
+#include "w_sockets.h"
+
+#ifndef WIN32
+#include <limits.h>     // IOV_MAX
+#else
+#include <io.h>
+#endif
+
+using namespace w_network;
+
+const size_t ChainBuffer::copy_threshold;
+const size_t ChainBuffer::block_size;
+
+#ifndef WIN32
+#ifdef IOV_MAX
+static const int max_iov = IOV_MAX;
+#else
+static const int max_iov = 1024;
+#endif
+#endif
+
+//一次 cb_write_fd() 最多写这么多，结果要放得进 int32_t
+static const size_t max_write_per_call = 1u << 30;
+
+bool ChainBuffer::_merge_into_tail(const char* data, size_t len)
+{
+    if (len > copy_threshold || chunks_.empty())
+        return false;
+
+    Chunk& tail = chunks_.back();
+    if (tail.shared_ || tail.is_file() || tail.owned_.size() + len > block_size)
+        return false;
+
+    tail.owned_.append(data, len);
+    size_ += len;
+    return true;
+}
+
+void ChainBuffer::cb_append(const char* data, size_t len)
+{
+    if (len == 0 || _merge_into_tail(data, len))
+        return;
+
+    chunks_.emplace_back();
+    chunks_.back().owned_.assign(data, len);
+    size_ += len;
+}
+
+void ChainBuffer::cb_append(std::string&& data, size_t offset/* = 0*/)
+{
+    if (offset >= data.size() || _merge_into_tail(data.data() + offset, data.size() - offset))
+        return;
+
+    chunks_.emplace_back();
+    Chunk& chunk = chunks_.back();
+    chunk.owned_ = std::move(data);
+    chunk.offset_ = offset;
+    size_ += chunk.size();
+}
+
+void ChainBuffer::cb_append(const Payload& payload, size_t offset/* = 0*/)
+{
+    if (!payload || offset >= payload->size() || _merge_into_tail(payload->data() + offset, payload->size() - offset))
+        return;
+
+    chunks_.emplace_back();
+    Chunk& chunk = chunks_.back();
+    chunk.shared_ = payload;
+    chunk.offset_ = offset;
+    size_ += chunk.size();
+}
+
+void ChainBuffer::cb_append_file(int file_fd, int64_t offset, size_t len, const FileOwner& owner/* = FileOwner()*/)
+{
+    if (file_fd < 0 || len == 0)
+        return;
+
+    chunks_.emplace_back();
+    Chunk& chunk = chunks_.back();
+    chunk.file_fd_ = file_fd;
+    chunk.file_offset_ = offset;
+    chunk.file_len_ = len;
+    chunk.file_owner_ = owner;
+    size_ += len;
+    file_bytes_ += len;
+}
+
+void ChainBuffer::cb_retrieve(size_t len)
+{
+    if (len >= size_)
+    {
+        cb_retrieve_all();
+        return;
+    }
+
+    size_ -= len;
+    while (len > 0)
+    {
+        Chunk& front = chunks_.front();
+        size_t n = front.size();
+        if (len < n)
+        {
+            front.offset_ += len;
+            if (front.is_file())
+                file_bytes_ -= len;
+            return;
+        }
+
+        len -= n;
+        if (front.is_file())
+            file_bytes_ -= n;
+        chunks_.pop_front();
+    }
+}
+
+void ChainBuffer::cb_retrieve_all()
+{
+    chunks_.clear();
+    size_ = 0;
+    file_bytes_ = 0;
+}
+
+int32_t ChainBuffer::cb_write_fd(int fd, int* saved_errno)
+{
+    //内存块和文件块交替时一次写不完，一直写到队列空、写了一部分或者出错
+    size_t total = 0;
+    while (size_ > 0 && total < max_write_per_call)
+    {
+        size_t expected = 0;
+        int32_t n = _write_front(fd, &expected);
+        if (n < 0)
+        {
+#ifdef WIN32
+            * saved_errno = ::WSAGetLastError();
+#else
+            * saved_errno = errno;
+#endif
+            if (total > 0)
+                break;
+            return n;
+        }
+
+        cb_retrieve(n);
+        total += n;
+        if (static_cast<size_t>(n) < expected)
+            break;
+    }
+
+    return static_cast<int32_t>(total);
+}
+
+int32_t ChainBuffer::_write_front(int fd, size_t* expected)
+{
+    const Chunk& front = chunks_.front();
+    if (front.is_file())
+    {
+        size_t len = front.size() < max_write_per_call ? front.size() : max_write_per_call;
+        *expected = len;
+#ifdef WIN32
+        //Windows 上没有 sendfile，读一段再发
+        char buf[64 * 1024];
+        if (len > sizeof(buf))
+            len = sizeof(buf);
+        *expected = len;
+        if (::_lseeki64(front.file_fd_, front.file_offset_ + front.offset_, SEEK_SET) < 0)
+            return -1;
+        int n = ::_read(front.file_fd_, buf, static_cast<unsigned int>(len));
+        if (n <= 0)
+            return -1;
+        return w_sockets::socks_write(fd, buf, n);
+#else
+        ssize_t n = w_sockets::socks_sendfile(fd, front.file_fd_, front.file_offset_ + front.offset_, len);
+        if (n == 0)
+        {
+            //文件比入队时短了，这一块永远发不完
+            errno = EIO;
+            return -1;
+        }
+        return static_cast<int32_t>(n);
+#endif
+    }
+
+#ifdef WIN32
+    //Windows 上没有 writev，一次只写第一块
+    *expected = front.size();
+    return w_sockets::socks_write(fd, front.data(), static_cast<int32_t>(front.size()));
+#else
+    struct iovec vec[max_iov];
+    int iovcnt = 0;
+    size_t len = 0;
+    for (const auto& chunk : chunks_)
+    {
+        if (iovcnt == max_iov || chunk.is_file() || len >= max_write_per_call)
+            break;
+
+        vec[iovcnt].iov_base = const_cast<char*>(chunk.data());
+        vec[iovcnt].iov_len = chunk.size();
+        len += chunk.size();
+        ++iovcnt;
+    }
+    *expected = len;
+    return static_cast<int32_t>(w_sockets::socks_writev(fd, vec, iovcnt));
+#endif
+}
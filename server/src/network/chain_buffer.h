@@ -0,0 +1,110 @@
+#pragma once
+
+#include "platform.h"
+#include <deque>
+#include <memory>
+#include <string>
+
+namespace w_network
+{
+    /// 由多个引用计数块组成的输出队列，替代连续的 ByteBuffer 作为 TcpConnection 的发送缓冲
+    ///
+    /// 大块数据按引用（Payload）或 move 进来，入队时不拷贝，也不会因为扩容被反复搬动；
+    /// 小块数据拷贝到可追加的尾块里合并，避免 iovec 过多。
+    /// 文件区间也可以入队（cb_append_file()），和内存块按顺序发送，数据不经过用户态。
+    /// Linux 上 cb_write_fd() 用 writev(2) 一次写出最多 IOV_MAX 块，文件块用 sendfile(2)。
+    /// +---------+---------+-----+------------------+
+    /// | chunk 0 | chunk 1 | ... | chunk n（可追加） |
+    /// +---------+---------+-----+------------------+
+    /// 不是线程安全的，只在连接所属的 loop 线程中使用。
+    class ChainBuffer
+    {
+    public:
+        /// 不可修改的共享数据，可以同时挂在多个连接的输出队列上
+        typedef std::shared_ptr<const std::string> Payload;
+
+        //小于这个大小的数据拷贝到尾块里合并
+        static const size_t copy_threshold = 4 * 1024;
+        //尾块最多合并到这么大
+        static const size_t block_size = 16 * 1024;
+
+        /// 文件块的持有者，发送完之前保持引用，析构时由它关闭 fd
+        typedef std::shared_ptr<const void> FileOwner;
+
+        ChainBuffer() : size_(0), file_bytes_(0) {}
+
+        size_t cb_bytes_readable() const
+        {
+            return size_;
+        }
+
+        /// 不算文件块，真正占用内存的字节数
+        size_t cb_bytes_in_memory() const
+        {
+            return size_ - file_bytes_;
+        }
+
+        size_t cb_chunk_count() const
+        {
+            return chunks_.size();
+        }
+
+        void cb_append(const char* data, size_t len);
+        /// 从 data 的 offset 处开始入队，大块数据直接接管 data，不拷贝
+        void cb_append(std::string&& data, size_t offset = 0);
+        /// 从 payload 的 offset 处开始入队，大块数据只增加引用计数
+        void cb_append(const Payload& payload, size_t offset = 0);
+        /// 入队文件 fd 从 offset 开始的 len 字节，发送时才读文件。
+        /// owner 不为空时一直引用到这一块发完，为空时由调用者保证 fd 在发完之前不关闭
+        void cb_append_file(int file_fd, int64_t offset, size_t len, const FileOwner& owner = FileOwner());
+
+        void cb_retrieve(size_t len);
+        void cb_retrieve_all();
+
+        /// 尽量多地写到 fd，写出去的数据会从队列中取走
+        /// @return result of write(2)/writev(2), @c errno is saved
+        int32_t cb_write_fd(int fd, int* saved_errno);
+
+    private:
+        struct Chunk
+        {
+            Payload     shared_;    // 引用的数据，为空时使用 owned_
+            std::string owned_;     // 自己持有的数据，尾块可以继续往后追加
+            size_t      offset_;    // 已经写出去的字节数
+            int         file_fd_;   // 文件块的 fd，-1 表示内存块
+            int64_t     file_offset_;
+            size_t      file_len_;
+            FileOwner   file_owner_;
+
+            Chunk() : offset_(0), file_fd_(-1), file_offset_(0), file_len_(0) {}
+
+            bool is_file() const
+            {
+                return file_fd_ >= 0;
+            }
+
+            const char* data() const
+            {
+                return (shared_ ? shared_->data() : owned_.data()) + offset_;
+            }
+
+            size_t size() const
+            {
+                if (is_file())
+                    return file_len_ - offset_;
+                return (shared_ ? shared_->size() : owned_.size()) - offset_;
+            }
+        };
+
+        // 能合并进尾块就拷贝进去
+        bool _merge_into_tail(const char* data, size_t len);
+        // 写一次：队首是文件块时发这一块，否则把队首连续的内存块一次 writev，
+        // 这次想写的字节数放到 expected 中
+        int32_t _write_front(int fd, size_t* expected);
+
+    private:
+        std::deque<Chunk>   chunks_;
+        size_t              size_;
+        size_t              file_bytes_;    // size_ 中文件块的字节数
+    };
+}
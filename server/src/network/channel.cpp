@@ -12,6 +12,11 @@ namespace w_network
     const int Channel::none_event_ = 0;
     const int Channel::read_event_ = POLLIN | POLLPRI;  // 修正：XPOLLIN → POLLIN
     const int Channel::write_event_ = POLLOUT;           // 修正：XPOLLOUT → POLLOUT
+#ifdef WIN32
+    const int Channel::edge_event_ = 0;
+#else
+    const int Channel::edge_event_ = EPOLLET;
+#endif
 
     Channel::Channel(EventLoop* loop, int fd)
         : loop_(loop),
@@ -19,6 +24,8 @@ namespace w_network
           events_(0),
           revents_(0),
           index_(-1),
+          edge_triggered_(false),
+          want_write_(false),
           read_callback_(nullptr),
           write_callback_(nullptr),
           close_callback_(nullptr),
@@ -32,6 +39,9 @@ namespace w_network
 
     bool Channel::enable_reading()
     {
+        if (edge_triggered_)
+            return _register_edge_triggered();
+
         events_ |= read_event_;
         return _update();
     }
@@ -44,12 +54,25 @@ namespace w_network
 
     bool Channel::enable_writing()
     {
+        if (edge_triggered_)
+        {
+            want_write_ = true;
+            return _register_edge_triggered();
+        }
+
         events_ |= write_event_;
         return _update();
     }
 
     bool Channel::disable_writing()
     {
+        if (edge_triggered_)
+        {
+            //可写事件保持注册，下次 enable_writing() 不需要 epoll_ctl
+            want_write_ = false;
+            return true;
+        }
+
         events_ &= ~write_event_;
         return _update();
     }
@@ -57,6 +80,17 @@ namespace w_network
     bool Channel::disable_all()
     {
         events_ = none_event_;
+        want_write_ = false;
+        return _update();
+    }
+
+    bool Channel::_register_edge_triggered()
+    {
+        const int events = read_event_ | write_event_ | edge_event_;
+        if (events_ == events)
+            return true;
+
+        events_ = events;
         return _update();
     }
 
@@ -73,7 +107,10 @@ namespace w_network
 
     void Channel::handle_event(Timestamp receive_time)
     {
-        WHISP_LOG_DEBUG(revents_2_string().c_str());
+        if (WhispLog::get_instance().log_enabled(LOG_LEVEL_DEBUG))
+        {
+            WHISP_LOG_DEBUG("%s", revents_2_string().c_str());
+        }
 
         // 处理挂断事件（POLLHUP 且无数据可读）
         if ((revents_ & POLLHUP) && !(revents_ & POLLIN))
@@ -102,8 +139,8 @@ namespace w_network
                 read_callback_(receive_time);
         }
 
-        // 处理写事件（POLLOUT）
-        if (revents_ & POLLOUT)
+        // 处理写事件（POLLOUT），边缘触发模式下可写事件一直注册着，没有数据要写时忽略
+        if ((revents_ & POLLOUT) && (!edge_triggered_ || want_write_))
         {
             if (write_callback_)
                 write_callback_();
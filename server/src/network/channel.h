@@ -1,4 +1,4 @@
-#pragma oncce
+#pragma once
 
 #include "common/whisp_timestamp.h"
 #include <functional>
@@ -39,13 +39,20 @@ namespace w_network
         // int revents() const { return revents_; }
         bool is_event_none() const { return events_ == none_event_; }
 
+        /// 边缘触发模式，在第一次 enable_reading()/enable_writing() 之前设置。
+        /// 注册后可写事件一直留在 epoll 中，enable_writing()/disable_writing() 只改本地标志，
+        /// 不再调用 epoll_ctl；使用者必须把读、写都做到 EAGAIN 为止。监听 socket 不要用
+        void set_edge_triggered(bool on) { edge_triggered_ = on; }
+        bool edge_triggered() const { return edge_triggered_; }
+
         bool enable_reading();
         bool disable_reading();
         bool enable_writing();
         bool disable_writing();
         bool disable_all();
 
-        bool is_writing() const { return events_ & write_event_; }
+        /// 是否有数据等着写，边缘触发模式下与注册的事件无关
+        bool is_writing() const { return edge_triggered_ ? want_write_ : (events_ & write_event_) != 0; }
 
         int index() { return index_; }
         void set_index(int idx) { index_ = idx; }
@@ -57,16 +64,21 @@ namespace w_network
 
     private:
         bool _update();
+        // 边缘触发模式下把读写事件一次性注册上，已经注册过就不再调用 epoll_ctl
+        bool _register_edge_triggered();
 
         static const int            none_event_;
         static const int            read_event_;
         static const int            write_event_;
+        static const int            edge_event_;
 
         EventLoop* loop_;
         const int                   fd_;
         int                         events_;
         int                         revents_;
         int                         index_;
+        bool                        edge_triggered_;
+        bool                        want_write_;        // 只在边缘触发模式下使用
 
         ReadEventCallback           read_callback_;
         EventCallback               write_callback_;
@@ -0,0 +1,235 @@
+#include "chat_frame_codec.h"
+#include "byte_buffer.h"
+#include "tcp_connect.h"
+#include <string.h>
+
+using namespace w_network;
+
+const size_t ChatFrameCodec::header_len;
+const size_t ChatFrameCodec::max_reserve;
+
+static void default_frame_error_callback(const TcpConnectionPtr& conn, const char* reason)
+{
+    WHISP_LOG_WARN("bad chat frame from %s: %s, close it", conn->peer_address().inet_2_ipport().c_str(), reason);
+    conn->force_close();
+}
+
+//读一个 7bit 编码的 uint32，返回占用的字节数，数据不够返回 0，超过 5 字节返回 -1。
+//read7BitEncoded() 不检查长度，先确认结束字节在范围内再交给它
+static int read_varint(const char* p, size_t len, uint32_t* value)
+{
+    size_t n = len < 5 ? len : 5;
+    for (size_t i = 0; i < n; ++i)
+    {
+        if ((p[i] & 0x80) == 0)
+        {
+            read7BitEncoded(p, static_cast<uint32_t>(i + 1), *value);
+            return static_cast<int>(i + 1);
+        }
+    }
+    return len < 5 ? 0 : -1;
+}
+
+ChatFrameCodec::ChatFrameCodec(const FrameCallback& cb, size_t max_body/* = BINARY_PACKAGE_MAXLEN_2*/)
+    : frame_callback_(cb),
+    error_callback_(default_frame_error_callback),
+    max_body_(max_body < static_cast<size_t>(BINARY_PACKAGE_MAXLEN_2) ? max_body : static_cast<size_t>(BINARY_PACKAGE_MAXLEN_2))
+{
+}
+
+ChatFrameCodec::DecodeResult ChatFrameCodec::decode(const char* data, size_t len, ChatFrame* frame, size_t* consumed_or_needed, const char** reason) const
+{
+    if (len > 0 && (static_cast<unsigned char>(data[0]) & CHAT_FRAME_V2_MAGIC_MASK) == CHAT_FRAME_V2_MAGIC)
+        return _decode_v2(data, len, frame, consumed_or_needed, reason);
+
+    if (len < header_len)
+    {
+        *consumed_or_needed = header_len;
+        return kNeedMore;
+    }
+
+    //包头按发送端的内存布局（#pragma pack(1)，主机字节序）原样读出，字段不一定对齐，用 memcpy
+    chat_msg_header header;
+    ::memcpy(&header, data, header_len);
+    if (header.compressflag != PACKAGE_UNCOMPRESSED && header.compressflag != PACKAGE_COMPRESSED)
+    {
+        *reason = "invalid compressflag";
+        return kBadFrame;
+    }
+    if (header.originsize < 0 || static_cast<size_t>(header.originsize) > static_cast<size_t>(BINARY_PACKAGE_MAXLEN_2))
+    {
+        *reason = "invalid originsize";
+        return kBadFrame;
+    }
+
+    //不压缩时包体就是原始数据，长度看 originsize
+    int32_t body_len = header.compressflag == PACKAGE_COMPRESSED ? header.compresssize : header.originsize;
+    if (body_len < 0 || static_cast<size_t>(body_len) > max_body_)
+    {
+        *reason = "body too large";
+        return kBadFrame;
+    }
+
+    size_t frame_len = header_len + static_cast<size_t>(body_len);
+    if (len < frame_len)
+    {
+        *consumed_or_needed = frame_len;
+        return kNeedMore;
+    }
+
+    frame->version = 1;
+    frame->batch = false;
+    frame->compressflag = header.compressflag;
+    frame->originsize = header.originsize;
+    frame->compresssize = header.compresssize;
+    frame->dictid = header.dictid;
+    frame->reserved = data + offsetof(chat_msg_header, reserved);
+    frame->body = data + header_len;
+    frame->body_len = static_cast<size_t>(body_len);
+    *consumed_or_needed = frame_len;
+    return kFrame;
+}
+
+ChatFrameCodec::DecodeResult ChatFrameCodec::_decode_v2(const char* data, size_t len, ChatFrame* frame, size_t* consumed_or_needed, const char** reason) const
+{
+    unsigned char flag = static_cast<unsigned char>(data[0]);
+    uint32_t body_len = 0;
+    int n = read_varint(data + 1, len - 1, &body_len);
+    if (n == 0)
+    {
+        //长度还没收全，至少再要一个字节
+        *consumed_or_needed = len + 1;
+        return kNeedMore;
+    }
+    if (n < 0)
+    {
+        *reason = "invalid length";
+        return kBadFrame;
+    }
+    if (body_len > max_body_)
+    {
+        *reason = "body too large";
+        return kBadFrame;
+    }
+
+    size_t frame_len = 1 + static_cast<size_t>(n) + body_len;
+    if (len < frame_len)
+    {
+        *consumed_or_needed = frame_len;
+        return kNeedMore;
+    }
+
+    const char* body = data + 1 + n;
+    uint32_t originsize = body_len;
+    if (flag & CHAT_FRAME_V2_COMPRESSED)
+    {
+        int m = read_varint(body, body_len, &originsize);
+        if (m <= 0 || originsize > static_cast<uint32_t>(BINARY_PACKAGE_MAXLEN_2))
+        {
+            *reason = "invalid originsize";
+            return kBadFrame;
+        }
+        body += m;
+        body_len -= m;
+    }
+
+    frame->version = 2;
+    frame->batch = (flag & CHAT_FRAME_V2_BATCH) != 0;
+    frame->compressflag = (flag & CHAT_FRAME_V2_COMPRESSED) ? PACKAGE_COMPRESSED : PACKAGE_UNCOMPRESSED;
+    frame->originsize = static_cast<int32_t>(originsize);
+    frame->compresssize = frame->compressflag == PACKAGE_COMPRESSED ? static_cast<int32_t>(body_len) : 0;
+    frame->dictid = 0;
+    frame->reserved = nullptr;
+    frame->body = body;
+    frame->body_len = body_len;
+    *consumed_or_needed = frame_len;
+    return kFrame;
+}
+
+//一条消息：cmd + seq + data，data 是剩下的全部字节
+static bool parse_v2_message(const char* p, size_t len, ChatMessageView* msg)
+{
+    uint32_t cmd = 0;
+    uint32_t seq = 0;
+    int n = read_varint(p, len, &cmd);
+    if (n <= 0)
+        return false;
+    int m = read_varint(p + n, len - n, &seq);
+    if (m <= 0)
+        return false;
+
+    msg->cmd = static_cast<int32_t>(cmd);
+    msg->seq = static_cast<int32_t>(seq);
+    msg->data = p + n + m;
+    msg->data_len = len - n - m;
+    return true;
+}
+
+bool ChatFrameCodec::parse_v2_payload(const char* payload, size_t len, bool batch, const MessageVisitor& visitor)
+{
+    ChatMessageView msg;
+    if (!batch)
+    {
+        if (!parse_v2_message(payload, len, &msg))
+            return false;
+        visitor(msg);
+        return true;
+    }
+
+    size_t offset = 0;
+    while (offset < len)
+    {
+        uint32_t msg_len = 0;
+        int n = read_varint(payload + offset, len - offset, &msg_len);
+        if (n <= 0 || msg_len > len - offset - n)
+            return false;
+        if (!parse_v2_message(payload + offset + n, msg_len, &msg))
+            return false;
+        visitor(msg);
+        offset += n + msg_len;
+    }
+    return true;
+}
+
+void ChatFrameCodec::on_message(const TcpConnectionPtr& conn, ByteBuffer* buf, Timestamp receive_time)
+{
+    const char* data = buf->bb_peek();
+    size_t len = buf->bb_bytes_readable();
+    size_t offset = 0;
+    while (true)
+    {
+        ChatFrame frame;
+        size_t n = 0;
+        const char* reason = nullptr;
+        DecodeResult result = decode(data + offset, len - offset, &frame, &n, &reason);
+        if (result == kBadFrame)
+        {
+            buf->bb_retrieve_all();
+            error_callback_(conn, reason);
+            return;
+        }
+
+        if (result == kNeedMore)
+        {
+            size_t missing = n - (len - offset);
+            if (missing > buf->bb_bytes_writeable() && n <= max_reserve)
+            {
+                //先把解完的帧取走，再为剩下的整帧预留空间，之后 data 就失效了
+                buf->bb_retrieve(offset);
+                buf->bb_bytes_check_writable(missing);
+                return;
+            }
+            break;
+        }
+
+        offset += n;
+        frame_callback_(conn, frame, receive_time);
+
+        //回调里可能关闭了连接，或者输出积压暂停了读（见 TcpConnection::set_read_backpressure()），
+        //剩下的帧等恢复时再处理
+        if (!conn->connected() || conn->reading_paused())
+            break;
+    }
+
+    buf->bb_retrieve(offset);
+}
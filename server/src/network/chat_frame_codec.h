@@ -0,0 +1,83 @@
+#pragma once
+
+#include "net_callback.h"
+#include "protocol_stream.h"
+#include "msg.h"
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace w_network
+{
+    /// 一个完整的 chat_msg_header 帧，body 直接指向 ByteBuffer 里的数据，不拷贝，
+    /// 只在帧回调返回之前有效
+    struct ChatFrame
+    {
+        int             version;        // 1: chat_msg_header 帧，2: 紧凑协议 v2 帧（见 msg.h）
+        bool            batch;          // v2 批量帧，v1 始终为 false
+        char            compressflag;
+        int32_t         originsize;
+        int32_t         compresssize;
+        uint32_t        dictid;         // 压缩用的预置字典，见 msg.h，v2 帧为 0
+        const char*     reserved;       // chat_msg_header::reserved，12 字节，v2 帧为空
+        const char*     body;           // v2 压缩帧不含压缩前大小，直接是 zlib 数据
+        size_t          body_len;
+    };
+
+    /// v2 包体里的一条消息，data 指向包体内部，不拷贝
+    struct ChatMessageView
+    {
+        int32_t         cmd;
+        int32_t         seq;
+        const char*     data;
+        size_t          data_len;
+    };
+
+    /// chat_msg_header 帧（TcpSession::make_frame() 生成的格式）和 v2 帧
+    /// （TcpSession::make_frame_v2()）的增量解码器，两种帧按第一个字节区分，同一个连接上可以混用
+    ///
+    /// 包头在 ByteBuffer 里原地解析，一次可读事件里有多少个完整的帧就连续回调多少次，
+    /// 最后统一 bb_retrieve 一次，中间不产生 std::string。不完整的帧留在缓冲区里，
+    /// 下一次可读事件接着解。包体长度超过 max_body（最大 BINARY_PACKAGE_MAXLEN_2）、
+    /// 压缩标志或长度不合法时调用错误回调，默认关闭连接。
+    /// 不保存每个连接的状态，一个解码器可以给所有连接共用
+    class ChatFrameCodec
+    {
+    public:
+        typedef std::function<void(const TcpConnectionPtr&, const ChatFrame&, Timestamp)> FrameCallback;
+        typedef std::function<void(const TcpConnectionPtr&, const char* reason)> ErrorCallback;
+        typedef std::function<void(const ChatMessageView&)> MessageVisitor;
+
+        static const size_t header_len = sizeof(chat_msg_header);
+
+        enum DecodeResult
+        {
+            kFrame,         // 解出一个帧，consumed 是整个帧的长度
+            kNeedMore,      // 数据不够，needed 是整个帧至少要多少字节
+            kBadFrame,      // 包头不合法
+        };
+
+        explicit ChatFrameCodec(const FrameCallback& cb, size_t max_body = BINARY_PACKAGE_MAXLEN_2);
+
+        void set_error_callback(const ErrorCallback& cb) { error_callback_ = cb; }
+
+        /// 可以直接作为 TcpConnection 的 MessageCallback
+        void on_message(const TcpConnectionPtr& conn, ByteBuffer* buf, Timestamp receive_time);
+
+        /// 从 data 开头解一个帧，不依赖连接，方便单独测试
+        DecodeResult decode(const char* data, size_t len, ChatFrame* frame, size_t* consumed_or_needed, const char** reason) const;
+
+        /// 解析 v2 帧（压缩帧要先解压）的包体，每条消息回调一次，格式不对返回 false
+        static bool parse_v2_payload(const char* payload, size_t len, bool batch, const MessageVisitor& visitor);
+
+    private:
+        DecodeResult _decode_v2(const char* data, size_t len, ChatFrame* frame, size_t* consumed_or_needed, const char** reason) const;
+
+        // 半个大帧留在缓冲区里时，先把整个帧的空间一次预留出来，避免边读边扩容搬数据
+        static const size_t max_reserve = 256 * 1024;
+
+        FrameCallback   frame_callback_;
+        ErrorCallback   error_callback_;
+        const size_t    max_body_;
+    };
+}
@@ -0,0 +1,254 @@
+#include "compress_policy.h"
+#include "msg.h"
+#include <algorithm>
+#include <stdio.h>
+
+using namespace w_network;
+
+const int CompressPolicy::probe_interval;
+const int CompressPolicy::warmup_samples;
+
+//指数滑动平均的权重，新样本占 1/4
+static const double ewma_alpha = 0.25;
+//CPU 耗时的单个样本最多是当前估计的几倍
+static const double max_cpu_jump = 4.0;
+
+static double s_byte_cost_ns[CompressPolicy::kLinkCount] = { 8.0, 160.0, 1600.0 };
+
+static void bump(std::atomic<int64_t>& counter, int64_t n)
+{
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+static CompressPolicy::Counters& global_counters_mutable()
+{
+    //故意不析构，进程退出时可能还有连接在发送
+    static CompressPolicy::Counters* counters = new CompressPolicy::Counters();
+    return *counters;
+}
+
+CompressPolicy::Counters::Counters()
+    : probes(0),
+    too_small(0),
+    bytes_in(0),
+    bytes_out(0),
+    cpu_ns(0)
+{
+    for (int i = 0; i < kLevelCount; ++i)
+        decisions[i] = 0;
+}
+
+CompressPolicy::TypeStats::TypeStats()
+    : count(0),
+    last(kDefault)
+{
+    for (int i = 0; i < kLevelCount; ++i)
+    {
+        ratio[i] = 1.0;
+        ns_per_byte[i] = 0.0;
+        samples[i] = 0;
+    }
+}
+
+CompressPolicy::CompressPolicy()
+    : link_(kLinkWifi)
+{
+}
+
+const CompressPolicy::Counters& CompressPolicy::global_counters()
+{
+    return global_counters_mutable();
+}
+
+void CompressPolicy::set_byte_cost_ns(Link link, double ns)
+{
+    s_byte_cost_ns[link] = ns;
+}
+
+int CompressPolicy::zlib_level(Level level)
+{
+    switch (level)
+    {
+    case kStore:
+        return 0;
+    case kFast:
+        return 1;
+    default:
+        return -1;      // Z_DEFAULT_COMPRESSION，和原来的 compress() 相同
+    }
+}
+
+const char* CompressPolicy::level_name(Level level)
+{
+    static const char* names[kLevelCount] = { "store", "fast", "default" };
+    return names[level];
+}
+
+const char* CompressPolicy::link_name(Link link)
+{
+    static const char* names[kLinkCount] = { "lan", "wifi", "cellular" };
+    return names[link];
+}
+
+void CompressPolicy::set_online_type(int online_type)
+{
+    Link link;
+    switch (online_type)
+    {
+    case online_type_pc_online:
+    case online_type_pc_invisible:
+    case online_type_mac:
+        link = kLinkLan;
+        break;
+    case online_type_android_cellular:
+        link = kLinkCellular;
+        break;
+    default:
+        //android wifi、ios 以及不认识的类型
+        link = kLinkWifi;
+        break;
+    }
+    link_.store(link, std::memory_order_relaxed);
+}
+
+CompressPolicy::Decision CompressPolicy::choose(int32_t cmd)
+{
+    Decision decision = { kDefault, true };
+    double byte_cost = s_byte_cost_ns[link()];
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    TypeStats& stats = types_[cmd];
+    ++stats.count;
+
+    //还没有数据的级别先用一用
+    if (stats.samples[kDefault] < warmup_samples)
+    {
+        decision.level = kDefault;
+    }
+    else if (stats.samples[kFast] < warmup_samples)
+    {
+        decision.level = kFast;
+    }
+    else
+    {
+        //收益 = 每个输入字节省下的字节折算成的时间 - 每个输入字节的压缩耗时，store 的收益是 0
+        Level best = kStore;
+        double best_gain = 0.0;
+        for (int i = kFast; i < kLevelCount; ++i)
+        {
+            double gain = (1.0 - stats.ratio[i]) * byte_cost - stats.ns_per_byte[i];
+            if (gain > best_gain)
+            {
+                best = static_cast<Level>(i);
+                best_gain = gain;
+            }
+        }
+
+        decision.level = best;
+        decision.probe = false;
+        //定期抽样没选中的压缩级别，数据变了（比如开始发图片）能发现
+        if (stats.count % probe_interval == 0)
+        {
+            if (best == kStore)
+                decision.level = (stats.count / probe_interval) % 2 ? kFast : kDefault;
+            else
+                decision.level = best == kFast ? kDefault : kFast;
+            decision.probe = true;
+        }
+    }
+
+    stats.last = decision.level;
+    return decision;
+}
+
+void CompressPolicy::record(int32_t cmd, const Decision& decision, size_t in, size_t out, int64_t cpu_ns)
+{
+    Counters& global = global_counters_mutable();
+    bump(counters_.decisions[decision.level], 1);
+    bump(global.decisions[decision.level], 1);
+    if (decision.probe)
+    {
+        bump(counters_.probes, 1);
+        bump(global.probes, 1);
+    }
+    bump(counters_.bytes_in, static_cast<int64_t>(in));
+    bump(global.bytes_in, static_cast<int64_t>(in));
+    bump(counters_.bytes_out, static_cast<int64_t>(out));
+    bump(global.bytes_out, static_cast<int64_t>(out));
+    bump(counters_.cpu_ns, cpu_ns);
+    bump(global.cpu_ns, cpu_ns);
+
+    if (decision.level == kStore || in == 0)
+        return;
+
+    double ratio = static_cast<double>(out) / static_cast<double>(in);
+    double ns_per_byte = static_cast<double>(cpu_ns) / static_cast<double>(in);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    TypeStats& stats = types_[cmd];
+    int level = decision.level;
+    if (stats.samples[level] == 0)
+    {
+        stats.ratio[level] = ratio;
+        stats.ns_per_byte[level] = ns_per_byte;
+    }
+    else
+    {
+        stats.ratio[level] += ewma_alpha * (ratio - stats.ratio[level]);
+        //线程被切走一次，一条消息的耗时就能比平时大上千倍。热身时取最小值，之后单个样本最多算当前估计的 max_cpu_jump 倍
+        if (stats.samples[level] < warmup_samples)
+            stats.ns_per_byte[level] = std::min(stats.ns_per_byte[level], ns_per_byte);
+        else
+            stats.ns_per_byte[level] += ewma_alpha * (std::min(ns_per_byte, stats.ns_per_byte[level] * max_cpu_jump) - stats.ns_per_byte[level]);
+    }
+    ++stats.samples[level];
+}
+
+void CompressPolicy::record_small()
+{
+    bump(counters_.too_small, 1);
+    bump(global_counters_mutable().too_small, 1);
+}
+
+static void append_counters(std::string& out, const CompressPolicy::Counters& counters)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "store=%lld fast=%lld default=%lld probes=%lld small=%lld in=%lld out=%lld cpu_us=%lld",
+        (long long)counters.decisions[CompressPolicy::kStore].load(std::memory_order_relaxed),
+        (long long)counters.decisions[CompressPolicy::kFast].load(std::memory_order_relaxed),
+        (long long)counters.decisions[CompressPolicy::kDefault].load(std::memory_order_relaxed),
+        (long long)counters.probes.load(std::memory_order_relaxed),
+        (long long)counters.too_small.load(std::memory_order_relaxed),
+        (long long)counters.bytes_in.load(std::memory_order_relaxed),
+        (long long)counters.bytes_out.load(std::memory_order_relaxed),
+        (long long)(counters.cpu_ns.load(std::memory_order_relaxed) / 1000));
+    out += buf;
+}
+
+std::string CompressPolicy::to_string() const
+{
+    std::string out = "link=";
+    out += link_name(link());
+    out += " ";
+    append_counters(out, counters_);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (const auto& item : types_)
+    {
+        const TypeStats& stats = item.second;
+        char buf[160];
+        snprintf(buf, sizeof(buf), " | %d:%s r=%.2f/%.2f ns/B=%.1f/%.1f",
+            item.first, level_name(stats.last),
+            stats.ratio[kFast], stats.ratio[kDefault],
+            stats.ns_per_byte[kFast], stats.ns_per_byte[kDefault]);
+        out += buf;
+    }
+    return out;
+}
+
+std::string CompressPolicy::global_to_string()
+{
+    std::string out;
+    append_counters(out, global_counters());
+    return out;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace w_network
+{
+    /// 一个连接的自适应压缩策略，见 TcpSession::set_online_type()
+    ///
+    /// 按消息类型（cmd）分别统计每个压缩级别实际的压缩率和每字节的 CPU 耗时（指数滑动平均），
+    /// 按对端的链路类型把省下的一个字节折算成值得花多少纳秒 CPU，选省下的时间减去 CPU 耗时最大的级别；
+    /// 图片、已经压缩过的数据压不下来，收益为负，选 store（compressflag = 0）。
+    /// 每种消息的前几条先轮流用各个级别压缩收集数据，之后每隔 probe_interval 条再抽样一次，
+    /// 数据特征变了也能跟上。
+    ///
+    /// 同一个连接可能在多个业务线程里发送，choose()/record() 加锁，只在这个连接内竞争
+    class CompressPolicy
+    {
+    public:
+        /// 候选的 zlib 压缩级别，kStore 表示不压缩
+        enum Level
+        {
+            kStore,
+            kFast,
+            kDefault,
+            kLevelCount
+        };
+
+        /// 链路类型，由 online_type 推出来
+        enum Link
+        {
+            kLinkLan,           // 电脑、MAC，带宽便宜，CPU 更值钱
+            kLinkWifi,          // 手机 wifi，以及不知道链路的客户端
+            kLinkCellular,      // 手机 3G/4G/5G，流量最贵
+            kLinkCount
+        };
+
+        /// 计数都是单调递增的，所有连接另外累加到 global_counters()
+        struct Counters
+        {
+            std::atomic<int64_t>    decisions[kLevelCount];    // 每个级别实际用了多少次，含抽样
+            std::atomic<int64_t>    probes;                    // 其中为了收集数据而不是按收益选的次数
+            std::atomic<int64_t>    too_small;                 // 包体小于 ZlibUtil::getMinCompressSize()，没有压缩
+            std::atomic<int64_t>    bytes_in;                  // 压缩前的字节数
+            std::atomic<int64_t>    bytes_out;                 // 压缩后（store 就是原样）的字节数
+            std::atomic<int64_t>    cpu_ns;                    // 压缩花的时间
+
+            Counters();
+        };
+
+        struct Decision
+        {
+            Level   level;
+            bool    probe;
+        };
+
+        static const int probe_interval = 64;
+        static const int warmup_samples = 2;
+
+        CompressPolicy();
+
+        /// 对端的 online_type（见 msg.h），决定链路类型，Thread safe
+        void set_online_type(int online_type);
+        Link link() const { return static_cast<Link>(link_.load(std::memory_order_relaxed)); }
+
+        /// 为一条类型为 cmd 的消息选择压缩级别
+        Decision choose(int32_t cmd);
+        /// 报告按 decision 发送的结果：in 是压缩前的大小，out 是压缩后的大小（store 时等于 in），
+        /// cpu_ns 是压缩花的时间
+        void record(int32_t cmd, const Decision& decision, size_t in, size_t out, int64_t cpu_ns);
+        /// 选了压缩级别但包太小没有压缩
+        void record_small();
+
+        const Counters& counters() const { return counters_; }
+        static const Counters& global_counters();
+
+        /// 一行文本，打日志用，如 "link=wifi store=.. fast=.. default=.. probes=.. in=.. out=.. cpu_us=.. | 1100:fast r=0.41 ..."
+        std::string to_string() const;
+        static std::string global_to_string();
+
+        /// 每种链路省下一个字节值得花多少纳秒 CPU，默认按带宽折算成传输一个字节的时间：
+        /// LAN 8（1Gbps）、wifi 160（50Mbps）、蜂窝 1600（5Mbps）。设得很大就总是压缩。
+        /// 不是线程安全的，在启动时设置
+        static void set_byte_cost_ns(Link link, double ns);
+
+        /// zlib 压缩级别
+        static int zlib_level(Level level);
+        static const char* level_name(Level level);
+        static const char* link_name(Link link);
+
+    private:
+        CompressPolicy(const CompressPolicy& rhs) = delete;
+        CompressPolicy& operator=(const CompressPolicy& rhs) = delete;
+
+        struct TypeStats
+        {
+            double      ratio[kLevelCount];         // 压缩后 / 压缩前
+            double      ns_per_byte[kLevelCount];   // 每个输入字节的压缩耗时
+            int         samples[kLevelCount];
+            uint32_t    count;
+            Level       last;
+
+            TypeStats();
+        };
+
+    private:
+        std::atomic<int>                link_;
+        mutable std::mutex              mutex_;
+        std::map<int32_t, TypeStats>    types_;     // 消息类型不多，用 map 就够了
+        Counters                        counters_;
+    };
+}
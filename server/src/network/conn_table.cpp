@@ -0,0 +1,103 @@
+#include "conn_table.h"
+
+using namespace w_network;
+
+ConnectionTable::ConnectionTable()
+    : next_seq_(0),
+    size_(0)
+{
+}
+
+uint64_t ConnectionTable::reserve()
+{
+    uint32_t index;
+    if (free_slots_.empty())
+    {
+        index = static_cast<uint32_t>(slots_.size());
+        slots_.push_back(Slot{ 0, TcpConnectionPtr() });
+    }
+    else
+    {
+        index = free_slots_.back();
+        free_slots_.pop_back();
+    }
+
+    //序号从 1 开始，id 不会是 0
+    if (++next_seq_ == 0)
+        ++next_seq_;
+
+    uint64_t id = (static_cast<uint64_t>(next_seq_) << 32) | index;
+    slots_[index].id_ = id;
+    return id;
+}
+
+void ConnectionTable::fill(uint64_t id, const TcpConnectionPtr& conn)
+{
+    Slot* slot = _slot(id);
+    if (slot == nullptr || slot->conn_)
+        return;
+
+    slot->conn_ = conn;
+    ++size_;
+}
+
+void ConnectionTable::release(uint64_t id)
+{
+    Slot* slot = _slot(id);
+    if (slot == nullptr || slot->conn_)
+        return;
+
+    slot->id_ = 0;
+    free_slots_.push_back(static_cast<uint32_t>(id));
+}
+
+TcpConnectionPtr ConnectionTable::find(uint64_t id) const
+{
+    const Slot* slot = _slot(id);
+    return slot != nullptr ? slot->conn_ : TcpConnectionPtr();
+}
+
+bool ConnectionTable::erase(uint64_t id)
+{
+    Slot* slot = _slot(id);
+    if (slot == nullptr || !slot->conn_)
+        return false;
+
+    slot->id_ = 0;
+    slot->conn_.reset();
+    free_slots_.push_back(static_cast<uint32_t>(id));
+    --size_;
+    return true;
+}
+
+void ConnectionTable::take_all(std::vector<TcpConnectionPtr>* conns)
+{
+    conns->reserve(conns->size() + size_);
+    for (Slot& slot : slots_)
+    {
+        if (slot.conn_)
+            conns->push_back(std::move(slot.conn_));
+    }
+
+    slots_.clear();
+    free_slots_.clear();
+    size_ = 0;
+}
+
+ConnectionTable::Slot* ConnectionTable::_slot(uint64_t id)
+{
+    uint32_t index = static_cast<uint32_t>(id);
+    if (id == 0 || index >= slots_.size() || slots_[index].id_ != id)
+        return nullptr;
+
+    return &slots_[index];
+}
+
+const ConnectionTable::Slot* ConnectionTable::_slot(uint64_t id) const
+{
+    uint32_t index = static_cast<uint32_t>(id);
+    if (id == 0 || index >= slots_.size() || slots_[index].id_ != id)
+        return nullptr;
+
+    return &slots_[index];
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "tcp_connect.h"
+#include <vector>
+#include <cstdint>
+
+namespace w_network
+{
+    /// 按连接 id 下标的连接表，增删查都是 O(1)，不做字符串比较，也不用哈希
+    ///
+    /// id 低 32 位是槽号，高 32 位是递增序号，同一个槽被复用后 id 也不会重复。
+    /// Not thread safe, TcpServer 用 conn_mutex_ 保护
+    class ConnectionTable
+    {
+    public:
+        ConnectionTable();
+
+        /// 先占一个槽拿到 id，连接创建好之后再 fill()，占着的槽不计入 size()
+        uint64_t reserve();
+        void fill(uint64_t id, const TcpConnectionPtr& conn);
+        /// 放弃 reserve() 占的槽
+        void release(uint64_t id);
+
+        TcpConnectionPtr find(uint64_t id) const;
+        bool erase(uint64_t id);
+        size_t size() const { return size_; }
+
+        /// 取出所有连接并清空表
+        void take_all(std::vector<TcpConnectionPtr>* conns);
+
+    private:
+        struct Slot
+        {
+            uint64_t            id_;        // 0 表示空闲
+            TcpConnectionPtr    conn_;
+        };
+
+        // id 对应的槽，id 已经失效返回 nullptr
+        Slot* _slot(uint64_t id);
+        const Slot* _slot(uint64_t id) const;
+
+    private:
+        std::vector<Slot>       slots_;
+        std::vector<uint32_t>   free_slots_;
+        uint32_t                next_seq_;
+        size_t                  size_;
+    };
+}
@@ -6,6 +6,7 @@
 #include "channel.h" // Include the header where Channel is fully defined
 #include "event_loop.h" // Include the header where EventLoop is fully defined
 #include <memory.h>
+#include <algorithm>
 
 using namespace w_network;
 
@@ -18,6 +19,7 @@ namespace {
 EpollPoller::EpollPoller(EventLoop* loop)
     : epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
     events_(init_event_list_size_),
+    next_generation_(0),
     owner_loop_(loop)
 {
     if (epollfd_ < 0)
@@ -34,8 +36,7 @@ EpollPoller::~EpollPoller()
 bool EpollPoller::has_channel(Channel* channel) const
 {
     assert_in_loop_thread();
-    ChannelMap::const_iterator it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    return _find(channel->fd()) == channel;
 }
 
 void EpollPoller::assert_in_loop_thread() const
@@ -80,13 +81,20 @@ void EpollPoller::_fill_active_channels(int events_num, ChannelList* active_chan
 {
     for (int i = 0; i < events_num; ++i)
     {
-        Channel* channel = static_cast<Channel*>(events_[i].data.ptr);
-        int fd = channel->fd();
-        ChannelMap::const_iterator it = channels_.find(fd);
-        if (it == channels_.end() || it->second != channel)
-            return;
-        channel->set_revents(events_[i].events);
-        active_channels->push_back(channel);
+        uint64_t data = events_[i].data.u64;
+        int fd = static_cast<int>(data >> 32);
+        if (fd < 0 || static_cast<size_t>(fd) >= channels_.size())
+            continue;
+
+        //这里在所有事件处理之前执行，删除 channel 时又做了 EPOLL_CTL_DEL，正常情况下不会有旧事件。
+        //epoll 注册挂在打开的文件上而不是 fd 号上：fd 没 DEL 就被关掉、而文件还被 dup 出的 fd 引用时，
+        //旧注册会继续带着原来的 data 上报，fd 号被新 channel 复用后靠 generation 把这种事件丢掉
+        const Slot& slot = channels_[fd];
+        if (slot.channel_ == nullptr || slot.generation_ != static_cast<uint32_t>(data))
+            continue;
+
+        slot.channel_->set_revents(events_[i].events);
+        active_channels->push_back(slot.channel_);
     }
 }
 
@@ -95,30 +103,40 @@ bool EpollPoller::update_channel(Channel* channel)
     assert_in_loop_thread();
     WHISP_LOG_DEBUG("fd = %d  events = %d", channel->fd(), channel->events());
     const int index = channel->index();
+    const int fd = channel->fd();
+    if (fd < 0)
+        return false;
+
     if (index == new_ || index == deleted_)
     {
-        int fd = channel->fd();
         if (index == new_)
         {
-            if (channels_.find(fd) != channels_.end())
+            if (static_cast<size_t>(fd) >= channels_.size())
+            {
+                //fd 基本是连续分配的，按两倍扩容
+                channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2), Slot{ nullptr, 0 });
+            }
+
+            Slot& slot = channels_[fd];
+            if (slot.channel_ != nullptr)
             {
                 WHISP_LOG_DEBUG("fd = %d  must not exist in channels_", fd);
                 return false;
             }
 
-
-            channels_[fd] = channel;
+            slot.channel_ = channel;
+            slot.generation_ = ++next_generation_;
         }
         else // index == deleted_
         {
-            if (channels_.find(fd) == channels_.end())
+            Channel* current = _find(fd);
+            if (current == nullptr)
             {
                 WHISP_LOG_ERROR("fd = %d  must exist in channels_", fd);
                 return false;
             }
 
-            //assert(channels_[fd] == channel);
-            if (channels_[fd] != channel)
+            if (current != channel)
             {
                 WHISP_LOG_ERROR("current channel is not matched current fd, fd = %d", fd);
                 return false;
@@ -131,8 +149,7 @@ bool EpollPoller::update_channel(Channel* channel)
     else
     {
         // update existing one with EPOLL_CTL_MOD/DEL
-        int fd = channel->fd();
-        if (channels_.find(fd) == channels_.end() || channels_[fd] != channel || index != added_)
+        if (_find(fd) != channel || index != added_)
         {
             WHISP_LOG_ERROR("current channel is not matched current fd, fd = %d, channel = 0x%x", fd, channel);
             return false;
@@ -160,16 +177,14 @@ void EpollPoller::remove_channel(Channel* channel)
     assert_in_loop_thread();
     int fd = channel->fd();
 
-    if (channels_.find(fd) == channels_.end() || channels_[fd] != channel || !channel->is_event_none())
+    if (_find(fd) != channel || !channel->is_event_none())
         return;
 
     int index = channel->index();
     if (index != added_ && index != deleted_)
         return;
 
-    size_t n = channels_.erase(fd);
-    if (n != 1)
-        return;
+    channels_[fd].channel_ = nullptr;
 
     if (index == added_)
     {
@@ -183,8 +198,8 @@ bool EpollPoller::_update(int operation, Channel* channel)
     struct epoll_event event;
     memset(&event, 0, sizeof event);
     event.events = channel->events();
-    event.data.ptr = channel;
     int fd = channel->fd();
+    event.data.u64 = (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 32) | channels_[fd].generation_;
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
         if (operation == XEPOLL_CTL_DEL)
@@ -3,7 +3,7 @@
 #ifndef WIN32
 
 #include <vector>
-#include <map>
+#include <cstdint>
 
 #include "common/platform.h"
 #include "poller.h"
@@ -32,13 +32,28 @@ namespace w_network
 
         void _fill_active_channels(int events_num, ChannelList* active_channels) const;
         bool _update(int operation, Channel* channel);
+        // fd 对应的 channel，不在表里返回 nullptr
+        Channel* _find(int fd) const
+        {
+            return fd >= 0 && static_cast<size_t>(fd) < channels_.size() ? channels_[fd].channel_ : nullptr;
+        }
     
     private:
+        // 按 fd 下标的 channel 表。注册时分配 generation，和 fd 一起放进 epoll_event.data。
+        // 只用来防御没有 EPOLL_CTL_DEL 就关闭的 fd（文件还被别的 fd 引用时旧注册不会消失），
+        // 它的事件不会被当成复用同一 fd 号的新 channel 的事件
+        struct Slot
+        {
+            Channel*    channel_;
+            uint32_t    generation_;
+        };
+
         typedef std::vector<struct epoll_event> EventList;
         int  epollfd_;
         EventList events_;
-        typedef std::map<int, Channel*> ChannelMap;
-        ChannelMap channels_;
+        typedef std::vector<Slot> ChannelTable;
+        ChannelTable channels_;
+        uint32_t next_generation_;
         EventLoop* owner_loop_;
     };
 }
@@ -1,11 +1,13 @@
 #include "event_loop.h"
 #include "channel.h"
+#include "timing_wheel.h"
 #include "w_sockets.h"
 
 #ifdef WIN32
 #include "select_poller.h"
 #else
 #include "epoll_poller.h"
+#include "io_uring_poller.h"
 #endif
 
 #include <sstream>
@@ -18,7 +20,19 @@ using namespace w_network;
 
 thread_local  EventLoop* loop_in_thread = 0;
 
+#ifdef WIN32
 const int poll_time_ms = 1;
+#else
+//定时器由 timerfd 唤醒，没有事件时一直阻塞在 epoll_wait 上
+const int poll_time_ms = -1;
+#endif
+
+static EventLoop::PollerBackend poller_backend = EventLoop::kEpollBackend;
+
+void EventLoop::set_poller_backend(PollerBackend backend)
+{
+    poller_backend = backend;
+}
 
 EventLoop* get_curthread_eventloop()
 {
@@ -31,10 +45,14 @@ EventLoop::EventLoop() :
     quit_(false),
     event_handling_(false),
     doing_other_tasks_(false),
+    queued_in_loop_(false),
     thread_id_(std::this_thread::get_id()),
-    timer_queue_(new TimerQueue(this)),
     iteration_(0L),
-    current_active_channel_(nullptr)
+    current_active_channel_(nullptr),
+#ifndef WIN32
+    native_thread_(pthread_self()),
+#endif
+    wakeup_pending_(false)
 {
     create_wakeup_fd();
 
@@ -44,8 +62,21 @@ EventLoop::EventLoop() :
 
 #else
     wakeup_channel_.reset(new Channel(this, wakeup_fd_));
-    poller_.reset(new EpollPoller(this));
+    if (poller_backend == kIoUringBackend)
+    {
+        poller_.reset(IoUringPoller::create(this));
+        if (!poller_)
+        {
+            WHISP_LOG_WARN("io_uring is not available, fall back to epoll");
+        }
+    }
+    if (!poller_)
+    {
+        poller_.reset(new EpollPoller(this));
+    }
 #endif
+    //TimerQueue 构造时要把 timerfd 注册到 poller_ 上，所以必须在 poller_ 之后创建
+    timer_queue_.reset(new TimerQueue(this));
 
     if (loop_in_thread)
     {
@@ -95,32 +126,54 @@ void EventLoop::loop()
     quit_ = false;  // FIXME: what if someone calls quit() before loop() ?
     WHISP_LOG_DEBUG("EventLoop 0x%x  start looping", this);
 
+    //上一次迭代结束的时间，也就是这次 poll 开始等待的时间
+    int64_t last_end_us = Timestamp::now().microSecondsSinceEpoch();
     while (!quit_)
     {
+#ifdef WIN32
         timer_queue_->do_timer();
+#endif
 
         active_channels_.clear();
-        poll_return_time_ = poller_->poll(poll_time_ms, &active_channels_);
-        //if (Logger::logLevel() <= Logger::TRACE)
-        //{
-        print_active_channels();
-        //}
+        activity_.mark_polling();
+        //上一轮任务、flush 之后又有 loop 线程自己投递的工作，这些投递没有唤醒 loop，只检查一下事件
+        int timeout_ms = (queued_in_loop_ || !flush_functors_.empty()) ? 0 : poll_time_ms;
+        poll_return_time_ = poller_->poll(timeout_ms, &active_channels_);
+        int64_t poll_return_us = poll_return_time_.microSecondsSinceEpoch();
+        metrics_.on_poll(poll_return_us - last_end_us, active_channels_.size());
+        //拼调试字符串的开销不小，只在打开调试日志时才做
+        if (WhispLog::get_instance().log_enabled(LOG_LEVEL_DEBUG))
+        {
+            print_active_channels();
+        }
         ++iteration_;
         // TODO sort channel by priority
         event_handling_ = true;
         for (const auto& it : active_channels_)
         {
             current_active_channel_ = it;
+            activity_.mark(LoopActivity::kChannel, it->fd());
             current_active_channel_->handle_event(poll_return_time_);
         }
         current_active_channel_ = nullptr;
         event_handling_ = false;
-        do_other_tasks();
+        size_t functors = do_other_tasks();
 
         if (frame_functor_)
         {
+            activity_.mark(LoopActivity::kFrame);
             frame_functor_();
         }
+
+        //frame_functor_ 里也可能发数据，放在它后面
+        if (!flush_functors_.empty())
+        {
+            do_flush_functors();
+        }
+
+        last_end_us = Timestamp::now().microSecondsSinceEpoch();
+        metrics_.on_iteration(last_end_us - poll_return_us, functors);
+        load_.on_iteration(poll_return_us, last_end_us, functors);
     }
 
     WHISP_LOG_DEBUG("EventLoop 0x%0x stop looping", this);
@@ -159,22 +212,66 @@ void EventLoop::run_in_loop(const Functor& cb)
 
 void EventLoop::queue_in_loop(const Functor& cb)
 {
+    queue_in_loop(Functor(cb));
+}
+
+void EventLoop::run_in_loop(Functor&& cb)
+{
+    if (is_in_loop_thread())
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        pending_functors_.push_back(cb);
+        cb();
     }
+    else
+    {
+        queue_in_loop(std::move(cb));
+    }
+}
+
+void EventLoop::queue_in_loop(Functor&& cb)
+{
+    pending_functors_.push(std::move(cb));
 
     if (!is_in_loop_thread() || doing_other_tasks_)
     {
-        wakeup();
+        //别的生产者已经唤醒过了，loop 处理时会把这个任务一起取走
+        if (!wakeup_pending_.exchange(true))
+        {
+            wakeup();
+        }
+    }
+    else
+    {
+        queued_in_loop_ = true;
     }
 }
 
+void EventLoop::do_flush_functors()
+{
+    //执行过程中再 queue_flush 的放到下一轮
+    running_flush_functors_.swap(flush_functors_);
+    for (Functor& functor : running_flush_functors_)
+    {
+        activity_.mark(LoopActivity::kFlush);
+        functor();
+    }
+    running_flush_functors_.clear();
+}
+
 void EventLoop::set_frame_functor(const Functor& cb)
 {
     frame_functor_ = cb;
 }
 
+TimingWheel* EventLoop::timing_wheel()
+{
+    assert_in_loop_thread();
+    if (!timing_wheel_)
+    {
+        timing_wheel_.reset(new TimingWheel(this));
+    }
+    return timing_wheel_.get();
+}
+
 TimerId EventLoop::run_at(const Timestamp& time, const TimerCallback& cb)
 {
     //只执行一次
@@ -386,22 +483,17 @@ bool EventLoop::handle_read()
     return true;
 }
 
-void EventLoop::do_other_tasks()
+size_t EventLoop::do_other_tasks()
 {
-    std::vector<Functor> functors;
     doing_other_tasks_ = true;
+    queued_in_loop_ = false;
 
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pending_functors_);
-    }
-
-    for (size_t i = 0; i < functors.size(); ++i)
-    {
-        functors[i]();
-    }
+    //必须先清标志再取任务：取的时候还没入队完成的生产者，会看到标志已清掉而重新唤醒 loop
+    wakeup_pending_.exchange(false);
+    size_t n = pending_functors_.run_all(&activity_);
 
     doing_other_tasks_ = false;
+    return n;
 }
 
 void EventLoop::print_active_channels() const
@@ -3,10 +3,17 @@
 #include "net_callback.h"
 #include "timer_id.h"
 #include "timer_queue.h"
+#include "task_queue.h"
+#include "loop_load.h"
+#include "loop_metrics.h"
+#include "loop_activity.h"
 #include "common/whisp_timestamp.h"
 #include "common/platform.h"
-#include <mutex>
+#include <atomic>
 #include <thread>
+#ifndef WIN32
+#include <pthread.h>
+#endif
 
 namespace w_network
 {
@@ -14,10 +21,22 @@ namespace w_network
     class Channel;
     class Poller;
     class CTimerHeap;
+    class TimingWheel;
 
     class EventLoop {
     public:
         typedef std::function<void()> Functor;
+
+        enum PollerBackend
+        {
+            kEpollBackend,
+            kIoUringBackend,        // 内核不支持时退回 epoll，见 IoUringPoller
+        };
+
+        /// 之后创建的 EventLoop 使用的 Poller 后端，默认 epoll。
+        /// Not thread safe, 在创建 EventLoop（包括 IO 线程）之前调用
+        static void set_poller_backend(PollerBackend backend);
+
         EventLoop();
         ~EventLoop();
 
@@ -28,6 +47,9 @@ namespace w_network
       
         void run_in_loop(const Functor& cb);
         void queue_in_loop(const Functor& cb);
+        // 跨线程投递时 cb 只 move 一次，不拷贝
+        void run_in_loop(Functor&& cb);
+        void queue_in_loop(Functor&& cb);
       
         TimerId run_at(const Timestamp& time, const TimerCallback& cb);
         TimerId run_after(int64_t delay, const TimerCallback& cb);
@@ -40,6 +62,29 @@ namespace w_network
         TimerId run_every(int64_t interval, TimerCallback&& cb);
       
         void set_frame_functor(const Functor& cb);
+
+        /// 本轮迭代处理完事件、任务和 frame_functor_ 之后执行一次，用来合并同一轮里的多次发送。
+        /// 只能在 loop 线程中调用。flush 回调里再调用的放到下一轮，下一轮的 poll 不会阻塞
+        void queue_flush(Functor&& cb) { flush_functors_.push_back(std::move(cb)); }
+
+        // 本 loop 的空闲超时时间轮，第一次使用时创建，只能在 loop 线程中调用
+        TimingWheel* timing_wheel();
+
+        // 实时负载计数，任意线程可读，见 LoopLoad
+        LoopLoad& load() { return load_; }
+        const LoopLoad& load() const { return load_; }
+
+        // 每次迭代的耗时、事件数、任务数和定时器延迟的直方图，任意线程可读，见 LoopMetrics
+        LoopMetrics& metrics() { return metrics_; }
+        const LoopMetrics& metrics() const { return metrics_; }
+
+        // 当前在执行哪个回调，给 LoopWatchdog 采样，见 LoopActivity
+        LoopActivity& activity() { return activity_; }
+        const LoopActivity& activity() const { return activity_; }
+#ifndef WIN32
+        // loop 线程的 pthread_t，LoopWatchdog 向它发信号取调用栈
+        pthread_t native_thread() const { return native_thread_; }
+#endif
       
         bool update_channel(Channel* channel);
         void remove_channel(Channel* channel);
@@ -60,7 +105,8 @@ namespace w_network
         bool wakeup();
         void abort_not_in_loop_thread();
         bool handle_read();
-        void do_other_tasks();
+        size_t do_other_tasks();
+        void do_flush_functors();
       
         void print_active_channels() const;
       
@@ -70,10 +116,14 @@ namespace w_network
         bool quit_;
         bool event_handling_;
         bool doing_other_tasks_;
+        // loop 线程在 do_other_tasks() 之外投递过任务。投递时不写 eventfd，
+        // 如果是在 do_other_tasks() 之后（frame_functor_、flush 回调里）投递的，下一次 poll 不能阻塞
+        bool queued_in_loop_;
         const std::thread::id thread_id_;
         Timestamp poll_return_time_;
         std::unique_ptr<Poller> poller_;
         std::unique_ptr<TimerQueue> timer_queue_;
+        std::unique_ptr<TimingWheel> timing_wheel_;    // 依赖 timer_queue_，必须声明在它后面
         int64_t iteration_;
       
       #ifdef WIN32
@@ -89,10 +139,19 @@ namespace w_network
         ChannelList active_channels_;
         Channel* current_active_channel_;
       
-        std::mutex mutex_;
-        std::vector<Functor> pending_functors_;
+        LoopLoad load_;     // 队列里的任务析构时可能还会用到，必须声明在 pending_functors_ 前面
+        LoopMetrics metrics_;
+        LoopActivity activity_;
+#ifndef WIN32
+        const pthread_t native_thread_;
+#endif
+        TaskQueue pending_functors_;
+        // 已经写过 eventfd 且 loop 还没开始处理，一批连续的投递只唤醒一次
+        std::atomic<bool> wakeup_pending_;
       
         Functor frame_functor_;
+        std::vector<Functor> flush_functors_;   // 只在 loop 线程中使用，执行完保留容量
+        std::vector<Functor> running_flush_functors_;
     };
       
 }  // namespace w_network
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "event_loop_thread.h"
 #include "event_loop.h"
+#include "util/cpu_affinity.h"
+#include "log/whisp_log.h"
 #include <functional>
 
 using namespace w_network;
@@ -8,7 +10,8 @@ EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,
     const std::string& name/* = ""*/)
     : loop_(NULL),
     exiting_(false),
-    callback_(cb)
+    callback_(cb),
+    cpu_(-1)
 {
 }
 
@@ -52,6 +55,11 @@ void EventLoopThread::stop_loop()
 
 void EventLoopThread::_thread_func()
 {
+    if (cpu_ >= 0 && cpu_bind_current_thread(std::vector<int>(1, cpu_)))
+    {
+        WHISP_LOG_INFO("EventLoopThread bound to cpu %d, numa node %d", cpu_, cpu_numa_node(cpu_));
+    }
+
     EventLoop loop;
 
     if (callback_)
@@ -17,6 +17,10 @@ namespace w_network
 
         EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(), const std::string& name = "");
         ~EventLoopThread();
+        /// 在 start_loop() 之前调用，线程先绑到 cpu 上再创建 EventLoop，
+        /// 这样 loop 自己的内存按 first-touch 落在该核的 NUMA 节点上。cpu < 0 表示不绑
+        void set_cpu(int cpu) { cpu_ = cpu; }
+
         EventLoop* start_loop();
         void stop_loop();
 
@@ -29,6 +33,7 @@ namespace w_network
         std::mutex                   mutex_;
         std::condition_variable      cond_;
         ThreadInitCallback           callback_;
+        int                          cpu_;
     };
 
 }
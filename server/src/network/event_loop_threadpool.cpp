@@ -14,7 +14,8 @@ EventLoopThreadPool::EventLoopThreadPool()
     : base_loop_(NULL),
     started_(false),
     num_threads_(0),
-    next_(0)
+    next_(0),
+    policy_(kRoundRobin)
 {
 }
 
@@ -50,6 +51,8 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
 
         std::unique_ptr<EventLoopThread> t(new EventLoopThread(cb, buf));
         //EventLoopThread* t = new EventLoopThread(cb, buf);        
+        if (!thread_cpus_.empty())
+            t->set_cpu(thread_cpus_[i % thread_cpus_.size()]);
         loops_.push_back(t->start_loop());
         threads_.push_back(std::move(t));
     }
@@ -76,17 +79,68 @@ EventLoop* EventLoopThreadPool::get_next_loop()
 
     EventLoop* loop = base_loop_;
 
-    if (!loops_.empty())
+    if (loops_.empty())
+        return loop;
+
+    if (selector_)
+        return selector_(loops_);
+
+    switch (policy_)
+    {
+    case kLeastLoaded:
+        return _least_loaded_loop();
+    case kPowerOfTwoChoices:
+        return _power_of_two_choices_loop();
+    default:
+        break;
+    }
+
+    // round-robin
+    loop = loops_[next_];
+    ++next_;
+    if (size_t(next_) >= loops_.size())
+    {
+        next_ = 0;
+    }
+    return loop;
+}
+
+EventLoop* EventLoopThreadPool::_least_loaded_loop()
+{
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    //分数相同时从上次选中的下一个开始，避免总是选第一个
+    size_t start = next_;
+    EventLoop* best = loops_[start];
+    int64_t best_score = best->load().score(now);
+    for (size_t i = 1; i < loops_.size(); ++i)
     {
-        // round-robin
-        loop = loops_[next_];
-        ++next_;
-        if (size_t(next_) >= loops_.size())
+        EventLoop* loop = loops_[(start + i) % loops_.size()];
+        int64_t score = loop->load().score(now);
+        if (score < best_score)
         {
-            next_ = 0;
+            best = loop;
+            best_score = score;
         }
     }
-    return loop;
+
+    next_ = (start + 1) % loops_.size();
+    return best;
+}
+
+EventLoop* EventLoopThreadPool::_power_of_two_choices_loop()
+{
+    if (loops_.size() == 1)
+        return loops_[0];
+
+    size_t a = rand_() % loops_.size();
+    size_t b = rand_() % (loops_.size() - 1);
+    if (b >= a)
+    {
+        ++b;
+    }
+
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    return loops_[a]->load().score(now) <= loops_[b]->load().score(now) ? loops_[a] : loops_[b];
 }
 
 EventLoop* EventLoopThreadPool::get_loop_for_hash(size_t hashCode)
@@ -117,10 +171,17 @@ std::vector<EventLoop*> EventLoopThreadPool::get_all_loops()
 const std::string EventLoopThreadPool::info() const
 {
     std::stringstream ss;
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
     ss << "print threads id info " << std::endl;
     for (size_t i = 0; i < loops_.size(); i++)
     {
-        ss << i << ": id = " << loops_[i]->get_thread_id() << std::endl;
+        const LoopLoad& load = loops_[i]->load();
+        ss << i << ": id = " << loops_[i]->get_thread_id()
+            << ", conns = " << load.conns()
+            << ", bytes/s = " << load.bytes_per_sec(now)
+            << ", functors_run = " << load.functors_run()
+            << ", busy_us = " << load.busy_us()
+            << ", score = " << load.score(now) << std::endl;
     }
     return ss.str();
 }
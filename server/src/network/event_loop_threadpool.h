@@ -4,6 +4,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <random>
 
 namespace w_network
 {
@@ -14,6 +15,15 @@ namespace w_network
     {
     public:
         typedef std::function<void(EventLoop*)> ThreadInitCallback;
+        /// 自定义的选 loop 策略，loops 不为空，可以通过 EventLoop::load() 读取负载
+        typedef std::function<EventLoop*(const std::vector<EventLoop*>& loops)> LoopSelector;
+
+        enum SelectPolicy
+        {
+            kRoundRobin,
+            kLeastLoaded,           // 遍历所有 loop，选 LoopLoad::score() 最小的
+            kPowerOfTwoChoices,     // 随机取两个，选分数小的，loop 多时比遍历便宜，也不会都挤到同一个 loop 上
+        };
 
         EventLoopThreadPool();
         ~EventLoopThreadPool();
@@ -23,7 +33,16 @@ namespace w_network
 
         void stop();
 
-        /// round-robin
+        /// Not thread safe, 在 start() 之前调用
+        void set_select_policy(SelectPolicy policy) { policy_ = policy; }
+        /// 设置后优先于 set_select_policy()
+        void set_loop_selector(const LoopSelector& selector) { selector_ = selector; }
+
+        /// 第 i 个 IO 线程绑到 cpus[i % cpus.size()] 上，空表示不绑
+        /// Not thread safe, 在 start() 之前调用
+        void set_thread_cpus(const std::vector<int>& cpus) { thread_cpus_ = cpus; }
+
+        /// 按选 loop 策略返回下一个连接应该放的 loop，默认 round-robin
         EventLoop* get_next_loop();
 
         /// with the same hash code, it will always return the same EventLoop
@@ -43,6 +62,10 @@ namespace w_network
 
         const std::string info() const;
 
+    private:
+        EventLoop* _least_loaded_loop();
+        EventLoop* _power_of_two_choices_loop();
+
     private:
 
         EventLoop* base_loop_;
@@ -52,6 +75,10 @@ namespace w_network
         int                                             next_;
         std::vector<std::unique_ptr<EventLoopThread> >  threads_;
         std::vector<EventLoop*>                         loops_;
+        SelectPolicy                                    policy_;
+        LoopSelector                                    selector_;
+        std::vector<int>                                thread_cpus_;
+        std::minstd_rand                                rand_;      // 只在 base loop 线程中使用
     };
 
 }
@@ -0,0 +1,410 @@
+#include "io_uring_poller.h"
+
+#ifndef WIN32
+#include "log/whisp_log.h"
+#include "channel.h"
+#include "event_loop.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+using namespace w_network;
+
+namespace {
+    const int new_ = -1;
+    const int added_ = 1;
+    const int deleted_ = 2;
+
+    //编号为 0 的 user_data 是 POLL_REMOVE 自己的完成事件，不对应任何 channel
+    inline uint64_t make_user_data(int fd, uint32_t generation)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 32) | generation;
+    }
+
+    inline int sys_io_uring_setup(unsigned entries, struct io_uring_params* params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    inline int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, const void* arg, size_t argsz)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz));
+    }
+}
+
+const unsigned IoUringPoller::ring_entries_;
+
+IoUringPoller* IoUringPoller::create(EventLoop* loop)
+{
+    IoUringPoller* poller = new IoUringPoller(loop);
+    if (!poller->_init())
+    {
+        delete poller;
+        return nullptr;
+    }
+
+    return poller;
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+    : ring_fd_(-1),
+    ring_ptr_(MAP_FAILED),
+    ring_size_(0),
+    sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+    sqes_size_(0),
+    sq_head_(nullptr),
+    sq_tail_(nullptr),
+    sq_mask_(0),
+    sq_entries_(0),
+    sq_local_tail_(0),
+    cq_head_(nullptr),
+    cq_tail_(nullptr),
+    cq_mask_(0),
+    cqes_(nullptr),
+    next_generation_(0),
+    round_(0),
+    owner_loop_(loop)
+{
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    if (sqes_ != MAP_FAILED)
+        ::munmap(sqes_, sqes_size_);
+    if (ring_ptr_ != MAP_FAILED)
+        ::munmap(ring_ptr_, ring_size_);
+    if (ring_fd_ >= 0)
+        ::close(ring_fd_);
+}
+
+bool IoUringPoller::_init()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = sys_io_uring_setup(ring_entries_, &params);
+    if (ring_fd_ < 0)
+    {
+        WHISP_LOG_WARN("io_uring_setup failed, errno = %d, %s", errno, strerror(errno));
+        return false;
+    }
+
+    //等待超时要用 IORING_ENTER_EXT_ARG（5.11），CQ 满了不能丢事件
+    const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required)
+    {
+        WHISP_LOG_WARN("io_uring lacks required features, features = 0x%x", params.features);
+        return false;
+    }
+    //边缘触发的 channel 要用 multishot poll。单次 poll 每轮重新挂上就成了水平触发，
+    //一直可写的 POLLOUT 会让 loop 空转，所以不支持时整个退回 epoll。
+    //multishot poll 和 RSRC_TAGS 同在 5.13 加入，没有单独的特性位
+#ifdef IORING_FEAT_RSRC_TAGS
+    if ((params.features & IORING_FEAT_RSRC_TAGS) == 0)
+    {
+        WHISP_LOG_WARN("io_uring lacks multishot poll, features = 0x%x", params.features);
+        return false;
+    }
+#else
+    WHISP_LOG_WARN("io_uring headers predate multishot poll");
+    return false;
+#endif
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring_size_ = sq_size > cq_size ? sq_size : cq_size;
+    ring_ptr_ = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (ring_ptr_ == MAP_FAILED)
+    {
+        WHISP_LOG_SYSERROR("IoUringPoller mmap ring");
+        return false;
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        WHISP_LOG_SYSERROR("IoUringPoller mmap sqes");
+        return false;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* ring = static_cast<char*>(ring_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+    sq_entries_ = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_entries);
+    sq_local_tail_ = *sq_tail_;
+    cq_head_ = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+
+    //SQ 的间接数组固定成一一对应，第 i 个槽就是第 i 个 SQE
+    unsigned* array = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries_; ++i)
+        array[i] = i;
+
+    WHISP_LOG_INFO("IoUringPoller ready, sq entries = %u", sq_entries_);
+    return true;
+}
+
+bool IoUringPoller::has_channel(Channel* channel) const
+{
+    assert_in_loop_thread();
+    ChannelMap::const_iterator it = channels_.find(channel->fd());
+    return it != channels_.end() && it->second.channel_ == channel;
+}
+
+void IoUringPoller::assert_in_loop_thread() const
+{
+    owner_loop_->assert_in_loop_thread();
+}
+
+io_uring_sqe* IoUringPoller::_get_sqe()
+{
+    //提交队列满了先交给内核，不等完成事件
+    if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+    {
+        _enter(false, 0);
+        if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+        {
+            WHISP_LOG_ERROR("io_uring submission queue is full");
+            return nullptr;
+        }
+    }
+
+    io_uring_sqe* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+    memset(sqe, 0, sizeof(*sqe));
+    ++sq_local_tail_;
+    return sqe;
+}
+
+int IoUringPoller::_enter(bool wait, int timeout_ms)
+{
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    unsigned to_submit = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (!wait && to_submit == 0)
+        return 0;
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (wait && timeout_ms >= 0)
+    {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000 * 1000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    if (wait)
+        flags |= IORING_ENTER_GETEVENTS;
+
+    return sys_io_uring_enter(ring_fd_, to_submit, wait ? 1 : 0, flags, &arg, sizeof(arg));
+}
+
+Timestamp IoUringPoller::poll(int timeout_ms, ChannelList* active_channels)
+{
+    //上一轮完成的单次 poll、新注册或者修改过事件的 channel 都在这里挂上，和等待一起提交
+    //换到另一个成员里遍历，_arm() 期间再标记的 fd 进新的 dirty_fds_；两个数组交替使用，容量都保留
+    arming_fds_.swap(dirty_fds_);
+    for (int fd : arming_fds_)
+    {
+        ChannelMap::iterator it = channels_.find(fd);
+        if (it == channels_.end())
+            continue;
+
+        it->second.dirty_ = false;
+        if (it->second.events_ == 0 && !it->second.channel_->is_event_none())
+            _arm(fd, it->second);
+    }
+    arming_fds_.clear();
+
+    //已经有完成事件（比如上一轮 CQ 溢出留下的）就不阻塞
+    bool ready = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) != *cq_head_;
+    int ret = _enter(true, ready ? 0 : timeout_ms);
+    int savedErrno = errno;
+    Timestamp now(Timestamp::now());
+    if (ret < 0 && savedErrno != ETIME && savedErrno != EINTR && savedErrno != EBUSY)
+    {
+        errno = savedErrno;
+        WHISP_LOG_SYSERROR("IoUringPoller::poll()");
+    }
+
+    _fill_active_channels(active_channels);
+    return now;
+}
+
+void IoUringPoller::_fill_active_channels(ChannelList* active_channels)
+{
+    ++round_;
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+        uint32_t generation = static_cast<uint32_t>(cqe->user_data);
+        int fd = static_cast<int>(cqe->user_data >> 32);
+        int res = cqe->res;
+        bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+        if (generation == 0)
+            continue;
+
+        ChannelMap::iterator it = channels_.find(fd);
+        if (it == channels_.end() || it->second.generation_ != generation)
+            continue;
+
+        //单次 poll 完成了，或者 multishot 被内核终止了，下一轮重新挂上
+        Entry& entry = it->second;
+        if (!more)
+        {
+            entry.events_ = 0;
+            _mark_dirty(fd, entry);
+        }
+
+        if (res < 0)
+        {
+            if (res != -ECANCELED)
+                WHISP_LOG_ERROR("io_uring poll fd = %d failed, res = %d, %s", fd, res, strerror(-res));
+            continue;
+        }
+
+        if (entry.round_ == round_)
+        {
+            entry.channel_->add_revents(res);
+        }
+        else
+        {
+            entry.round_ = round_;
+            entry.channel_->set_revents(res);
+            active_channels->push_back(entry.channel_);
+        }
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::_arm(int fd, Entry& entry)
+{
+    io_uring_sqe* sqe = _get_sqe();
+    if (sqe == nullptr)
+    {
+        _mark_dirty(fd, entry);
+        return;
+    }
+
+    if (++next_generation_ == 0)
+        ++next_generation_;
+
+    //EPOLLET 不是 poll 事件，触发方式由单次/multishot 决定
+    uint32_t events = static_cast<uint32_t>(entry.channel_->events()) & ~static_cast<uint32_t>(EPOLLET);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    if (entry.channel_->edge_triggered())
+        sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = make_user_data(fd, next_generation_);
+
+    entry.generation_ = next_generation_;
+    entry.events_ = events;
+}
+
+void IoUringPoller::_disarm(int fd, Entry& entry)
+{
+    if (entry.events_ == 0)
+        return;
+
+    io_uring_sqe* sqe = _get_sqe();
+    if (sqe != nullptr)
+    {
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = make_user_data(fd, entry.generation_);
+        sqe->user_data = make_user_data(fd, 0);
+    }
+
+    //即使 POLL_REMOVE 没放进去，换了编号旧 poll 的完成事件也会被丢掉
+    entry.generation_ = 0;
+    entry.events_ = 0;
+}
+
+void IoUringPoller::_mark_dirty(int fd, Entry& entry)
+{
+    if (entry.dirty_)
+        return;
+
+    entry.dirty_ = true;
+    dirty_fds_.push_back(fd);
+}
+
+bool IoUringPoller::update_channel(Channel* channel)
+{
+    assert_in_loop_thread();
+    int fd = channel->fd();
+    const int index = channel->index();
+    ChannelMap::iterator it = channels_.find(fd);
+    if (index == new_)
+    {
+        if (it != channels_.end())
+        {
+            WHISP_LOG_DEBUG("fd = %d  must not exist in channels_", fd);
+            return false;
+        }
+
+        Entry entry;
+        entry.channel_ = channel;
+        entry.generation_ = 0;
+        entry.events_ = 0;
+        entry.round_ = 0;
+        entry.dirty_ = false;
+        it = channels_.emplace(fd, entry).first;
+    }
+    else if (it == channels_.end() || it->second.channel_ != channel)
+    {
+        WHISP_LOG_ERROR("current channel is not matched current fd, fd = %d", fd);
+        return false;
+    }
+
+    //挂着的事件和要关注的一样就什么也不做（边缘触发模式下 enable_writing 不会走到这里）
+    Entry& entry = it->second;
+    uint32_t events = static_cast<uint32_t>(channel->events()) & ~static_cast<uint32_t>(EPOLLET);
+    if (entry.events_ != 0 && entry.events_ == events)
+    {
+        channel->set_index(added_);
+        return true;
+    }
+
+    _disarm(fd, entry);
+    if (channel->is_event_none())
+    {
+        channel->set_index(deleted_);
+    }
+    else
+    {
+        channel->set_index(added_);
+        _mark_dirty(fd, entry);
+    }
+    return true;
+}
+
+void IoUringPoller::remove_channel(Channel* channel)
+{
+    assert_in_loop_thread();
+    int fd = channel->fd();
+    ChannelMap::iterator it = channels_.find(fd);
+    if (it == channels_.end() || it->second.channel_ != channel || !channel->is_event_none())
+        return;
+
+    int index = channel->index();
+    if (index != added_ && index != deleted_)
+        return;
+
+    _disarm(fd, it->second);
+    channels_.erase(it);
+    channel->set_index(new_);
+}
+
+#endif
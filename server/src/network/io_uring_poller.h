@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef WIN32
+
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "poller.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace w_network
+{
+    class EventLoop;
+
+    /// 基于 io_uring 的 Poller，对外还是就绪通知，和 EpollPoller 可以互换
+    ///
+    /// 注册、修改、删除 channel 只是往提交队列里放 POLL_ADD/POLL_REMOVE，
+    /// 到下一次 poll() 时和等待一起用一次 io_uring_enter 提交，不再有单独的 epoll_ctl。
+    /// 水平触发的 channel 用单次 poll，每次完成后重新挂上（同样在下一次提交里）；
+    /// 边缘触发的 channel（见 Channel::set_edge_triggered()）用 multishot poll，一直挂着。
+    class IoUringPoller : public Poller {
+    public:
+        /// 内核不支持（早于 5.13、被禁用或者权限不够）时返回 nullptr，调用者退回 EpollPoller
+        static IoUringPoller* create(EventLoop* loop);
+        virtual ~IoUringPoller();
+
+        virtual Timestamp poll(int timeout_ms, ChannelList* active_channels);
+        virtual bool update_channel(Channel* channel);
+        virtual void remove_channel(Channel* channel);
+
+        virtual bool has_channel(Channel* channel) const;
+
+        void assert_in_loop_thread() const;
+
+    private:
+        static const unsigned ring_entries_ = 1024;
+
+        struct Entry
+        {
+            Channel*    channel_;
+            uint32_t    generation_;    // 当前挂在内核里的 poll 的编号，旧编号的完成事件直接丢掉
+            uint32_t    events_;        // 当前挂在内核里的事件，0 表示没挂
+            uint64_t    round_;         // 最近一次放进 active_channels 的轮次，multishot 一轮可能完成多次
+            bool        dirty_;         // 已经放进 dirty_fds_，等下一次提交前挂上
+        };
+
+        explicit IoUringPoller(EventLoop* loop);
+        bool _init();
+
+        io_uring_sqe* _get_sqe();
+        // 把已经放进提交队列、内核还没取走的 SQE 交给内核，wait 为 true 时同时等完成事件
+        int _enter(bool wait, int timeout_ms);
+        void _arm(int fd, Entry& entry);
+        void _disarm(int fd, Entry& entry);
+        void _mark_dirty(int fd, Entry& entry);
+        void _fill_active_channels(ChannelList* active_channels);
+
+    private:
+        typedef std::map<int, Entry> ChannelMap;
+
+        int             ring_fd_;
+
+        void*           ring_ptr_;              // SQ、CQ 共用一次 mmap（IORING_FEAT_SINGLE_MMAP）
+        size_t          ring_size_;
+        io_uring_sqe*   sqes_;
+        size_t          sqes_size_;
+
+        unsigned*       sq_head_;
+        unsigned*       sq_tail_;
+        unsigned        sq_mask_;
+        unsigned        sq_entries_;
+        unsigned        sq_local_tail_;         // 还没发布给内核的队尾
+
+        unsigned*       cq_head_;
+        unsigned*       cq_tail_;
+        unsigned        cq_mask_;
+        io_uring_cqe*   cqes_;
+
+        uint32_t        next_generation_;       // 整个 poller 递增，fd 复用后也不会和旧 poll 撞号
+        uint64_t        round_;
+        ChannelMap      channels_;
+        std::vector<int> dirty_fds_;
+        std::vector<int> arming_fds_;           // 只在 poll() 里用，和 dirty_fds_ 交换
+        EventLoop*      owner_loop_;
+    };
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include "ip_rate_limiter.h"
+#include <algorithm>
+
+using namespace w_network;
+
+//至少隔这么久才清理一次，单位微秒
+static const int64_t sweep_interval_us = 10 * 1000 * 1000;
+
+IpRateLimiter::IpRateLimiter()
+    : rate_(0),
+    burst_(0),
+    last_sweep_us_(0)
+{
+}
+
+void IpRateLimiter::set_rate(int rate, int burst)
+{
+    rate_ = rate;
+    burst_ = std::max(burst, rate > 0 ? 1 : 0);
+}
+
+bool IpRateLimiter::allow(uint32_t ip, Timestamp now)
+{
+    if (rate_ <= 0)
+        return true;
+
+    const int64_t now_us = now.microSecondsSinceEpoch();
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (now_us - last_sweep_us_ >= sweep_interval_us)
+    {
+        _sweep(now_us);
+    }
+
+    auto result = buckets_.emplace(ip, Bucket{ static_cast<double>(burst_), now_us });
+    Bucket& bucket = result.first->second;
+    if (!result.second)
+    {
+        double elapsed = static_cast<double>(now_us - bucket.last_us_) / Timestamp::kMicroSecondsPerSecond;
+        bucket.tokens_ = std::min<double>(burst_, bucket.tokens_ + elapsed * rate_);
+        bucket.last_us_ = now_us;
+    }
+
+    if (bucket.tokens_ < 1.0)
+        return false;
+
+    bucket.tokens_ -= 1.0;
+    return true;
+}
+
+void IpRateLimiter::_sweep(int64_t now_us)
+{
+    last_sweep_us_ = now_us;
+    for (auto iter = buckets_.begin(); iter != buckets_.end(); )
+    {
+        double elapsed = static_cast<double>(now_us - iter->second.last_us_) / Timestamp::kMicroSecondsPerSecond;
+        if (iter->second.tokens_ + elapsed * rate_ >= burst_)
+        {
+            iter = buckets_.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "common/whisp_timestamp.h"
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+
+namespace w_network
+{
+    /// 按源 IP 限制新连接速率的令牌桶，多个 Acceptor 所在的线程可以同时调用
+    class IpRateLimiter
+    {
+    public:
+        IpRateLimiter();
+
+        /// 每个 IP 每秒最多 rate 个新连接，允许 burst 个的突发；rate <= 0 表示不限制
+        /// Not thread safe, 在 TcpServer::start() 之前调用
+        void set_rate(int rate, int burst);
+
+        bool enabled() const { return rate_ > 0; }
+
+        /// ip 是网络字节序，令牌不够返回 false
+        bool allow(uint32_t ip, Timestamp now);
+
+    private:
+        IpRateLimiter(const IpRateLimiter& rhs) = delete;
+        IpRateLimiter& operator=(const IpRateLimiter& rhs) = delete;
+
+        // 清掉已经攒满令牌的桶，它们和新建的桶没有区别
+        void _sweep(int64_t now_us);
+
+    private:
+        struct Bucket
+        {
+            double  tokens_;
+            int64_t last_us_;
+        };
+
+        int                                     rate_;
+        int                                     burst_;
+        int64_t                                 last_sweep_us_;
+        std::mutex                              mutex_;
+        std::unordered_map<uint32_t, Bucket>    buckets_;
+    };
+}
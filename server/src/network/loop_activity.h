@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace w_network
+{
+    /// EventLoop 当前在执行什么，给 LoopWatchdog 在别的线程里看
+    ///
+    /// 每个回调开始前 mark() 一次，只有一次 relaxed store，不取时间；
+    /// 看门狗定时采样，同一个值停留太久就说明这个回调卡住了。
+    /// 值的高 32 位是递增序号，中间 8 位是 Kind，低 24 位是 fd（或任务序号）
+    class LoopActivity
+    {
+    public:
+        enum Kind
+        {
+            kPolling,       // 阻塞在 poll 上，不算卡住
+            kChannel,       // Channel::handle_event()，fd 是 channel 的 fd
+            kFunctor,       // queue_in_loop 的任务，fd 位置是本轮第几个任务
+            kTimer,         // 定时器回调
+            kFrame,         // frame_functor_
+            kFlush,         // queue_flush 的任务
+        };
+
+        LoopActivity() : token_(0), seq_(0), polls_(0) {}
+
+        /// 每次迭代进入 poll 前调用，只在 loop 线程中调用。
+        /// 迭代很快时看门狗可能采样不到 kPolling，靠 polls() 的变化区分前后两次迭代
+        void mark_polling()
+        {
+            mark(kPolling);
+            polls_.store(polls_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        /// 只在 loop 线程中调用
+        void mark(Kind kind, int fd = -1)
+        {
+            ++seq_;
+            token_.store((static_cast<uint64_t>(seq_) << 32) | (static_cast<uint64_t>(kind) << 24) | (static_cast<uint32_t>(fd) & 0xFFFFFF),
+                std::memory_order_relaxed);
+        }
+
+        uint64_t token() const { return token_.load(std::memory_order_relaxed); }
+        uint64_t polls() const { return polls_.load(std::memory_order_relaxed); }
+
+        static Kind kind_of(uint64_t token) { return static_cast<Kind>((token >> 24) & 0xFF); }
+        static int fd_of(uint64_t token)
+        {
+            uint32_t fd = static_cast<uint32_t>(token & 0xFFFFFF);
+            return fd == 0xFFFFFF ? -1 : static_cast<int>(fd);
+        }
+        static const char* kind_name(Kind kind)
+        {
+            switch (kind)
+            {
+            case kPolling:
+                return "poll";
+            case kChannel:
+                return "channel";
+            case kFunctor:
+                return "functor";
+            case kTimer:
+                return "timer";
+            case kFrame:
+                return "frame functor";
+            case kFlush:
+                return "flush functor";
+            default:
+                return "unknown";
+            }
+        }
+
+    private:
+        LoopActivity(const LoopActivity& rhs) = delete;
+        LoopActivity& operator=(const LoopActivity& rhs) = delete;
+
+    private:
+        std::atomic<uint64_t>   token_;
+        uint32_t                seq_;       // 只在 loop 线程中使用
+        std::atomic<uint64_t>   polls_;
+    };
+}
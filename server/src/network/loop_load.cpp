@@ -0,0 +1,55 @@
+#include "loop_load.h"
+
+using namespace w_network;
+
+const int64_t LoopLoad::rate_window_us;
+
+LoopLoad::LoopLoad()
+    : conns_(0),
+    bytes_per_sec_(0),
+    rate_window_end_us_(0),
+    functors_run_(0),
+    busy_us_(0),
+    window_start_us_(0),
+    window_bytes_(0)
+{
+}
+
+int64_t LoopLoad::bytes_per_sec(int64_t now_us) const
+{
+    //loop 阻塞在 poll 上时不会更新窗口，窗口太旧说明这段时间没有流量
+    if (now_us - rate_window_end_us_.load(std::memory_order_relaxed) > 2 * rate_window_us)
+        return 0;
+
+    return bytes_per_sec_.load(std::memory_order_relaxed);
+}
+
+int64_t LoopLoad::score(int64_t now_us) const
+{
+    return conns()
+        + bytes_per_sec(now_us) / (64 * 1024)
+        + functors_run()
+        + busy_us() / 100;
+}
+
+void LoopLoad::on_iteration(int64_t poll_return_us, int64_t end_us, int64_t functors)
+{
+    functors_run_.store(functors, std::memory_order_relaxed);
+
+    //权重 1/8 的滑动平均
+    int64_t busy = end_us - poll_return_us;
+    int64_t avg = busy_us_.load(std::memory_order_relaxed);
+    busy_us_.store(avg + (busy - avg) / 8, std::memory_order_relaxed);
+
+    if (window_start_us_ == 0)
+    {
+        window_start_us_ = end_us;
+    }
+    else if (end_us - window_start_us_ >= rate_window_us)
+    {
+        bytes_per_sec_.store(window_bytes_ * rate_window_us / (end_us - window_start_us_), std::memory_order_relaxed);
+        rate_window_end_us_.store(end_us, std::memory_order_relaxed);
+        window_start_us_ = end_us;
+        window_bytes_ = 0;
+    }
+}
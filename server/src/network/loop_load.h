@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace w_network
+{
+    /// 一个 EventLoop 的实时负载计数，供 EventLoopThreadPool 选 loop 时参考
+    ///
+    /// 除了连接数，其他计数都只由 loop 线程写（单写者，不需要原子加），
+    /// 任意线程都可以无锁读，读到的是近似值。
+    class LoopLoad
+    {
+    public:
+        //流量按这个窗口统计成每秒字节数，单位微秒
+        static const int64_t rate_window_us = 1000 * 1000;
+
+        LoopLoad();
+
+        /// 当前连接数，TcpConnection 构造和析构时更新，可能在任意线程
+        int64_t conns() const { return conns_.load(std::memory_order_relaxed); }
+        /// 最近一个统计窗口的收发字节数/秒，loop 空闲超过两个窗口时为 0
+        int64_t bytes_per_sec(int64_t now_us) const;
+        /// 最近一次迭代执行的 queue_in_loop 任务数，即那次取任务时队列的深度；
+        /// 不是当前的积压，两次迭代之间新投递的任务不算
+        int64_t functors_run() const { return functors_run_.load(std::memory_order_relaxed); }
+        /// 每次迭代处理事件和任务耗时的滑动平均，不含 poll 等待，单位微秒
+        int64_t busy_us() const { return busy_us_.load(std::memory_order_relaxed); }
+
+        /// 综合负载分数，越小越空闲：
+        /// 每个连接 1 分，每 64 KB/s 流量 1 分，上一次迭代执行的每个任务 1 分，每 100 微秒迭代耗时 1 分
+        int64_t score(int64_t now_us) const;
+
+        void add_conn() { conns_.fetch_add(1, std::memory_order_relaxed); }
+        void remove_conn() { conns_.fetch_sub(1, std::memory_order_relaxed); }
+
+        // 以下只在 loop 线程中调用
+        void add_bytes(int64_t n) { window_bytes_ += n; }
+        void on_iteration(int64_t poll_return_us, int64_t end_us, int64_t functors);
+
+    private:
+        LoopLoad(const LoopLoad& rhs) = delete;
+        LoopLoad& operator=(const LoopLoad& rhs) = delete;
+
+    private:
+        std::atomic<int64_t>    conns_;
+        std::atomic<int64_t>    bytes_per_sec_;
+        std::atomic<int64_t>    rate_window_end_us_;    // bytes_per_sec_ 统计窗口的结束时间
+        std::atomic<int64_t>    functors_run_;
+        std::atomic<int64_t>    busy_us_;
+
+        int64_t                 window_start_us_;       // 只在 loop 线程中使用
+        int64_t                 window_bytes_;
+    };
+}
@@ -0,0 +1,125 @@
+#include "loop_metrics.h"
+#include <stdio.h>
+#ifdef WIN32
+#include <intrin.h>
+#endif
+
+using namespace w_network;
+
+const int LoopHistogram::sub_bucket_bits;
+const int LoopHistogram::sub_buckets;
+const int LoopHistogram::bucket_count;
+
+LoopHistogram::LoopHistogram()
+    : count_(0),
+    sum_(0),
+    max_(0)
+{
+    for (auto& bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+int LoopHistogram::_bucket_index(uint64_t value)
+{
+    //小于 sub_buckets 的值每个一个桶，之后每段 [2^e, 2^(e+1)) 分成 sub_buckets 个桶
+    if (value < static_cast<uint64_t>(sub_buckets))
+        return static_cast<int>(value);
+
+#ifdef WIN32
+    unsigned long exponent = 0;
+    _BitScanReverse64(&exponent, value);
+#else
+    int exponent = 63 - __builtin_clzll(value);
+#endif
+    int sub = static_cast<int>(value >> (exponent - sub_bucket_bits)) & (sub_buckets - 1);
+    return (static_cast<int>(exponent) - sub_bucket_bits + 1) * sub_buckets + sub;
+}
+
+int64_t LoopHistogram::_bucket_high(int index)
+{
+    if (index < sub_buckets)
+        return index;
+
+    int exponent = index / sub_buckets + sub_bucket_bits - 1;
+    int sub = index % sub_buckets;
+    uint64_t low = static_cast<uint64_t>(sub_buckets + sub) << (exponent - sub_bucket_bits);
+    uint64_t width = 1ULL << (exponent - sub_bucket_bits);
+    return static_cast<int64_t>(low + width - 1);
+}
+
+void LoopHistogram::record(int64_t value)
+{
+    //时钟回拨时差值可能是负的
+    if (value < 0)
+        value = 0;
+
+    _bump(buckets_[_bucket_index(static_cast<uint64_t>(value))], 1);
+    _bump(count_, 1);
+    _bump(sum_, value);
+    if (value > max_.load(std::memory_order_relaxed))
+    {
+        max_.store(value, std::memory_order_relaxed);
+    }
+}
+
+int64_t LoopHistogram::percentile(double q) const
+{
+    int64_t total = count();
+    if (total == 0)
+        return 0;
+
+    int64_t rank = static_cast<int64_t>(q * total + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    int64_t seen = 0;
+    for (int i = 0; i < bucket_count; ++i)
+    {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            int64_t high = _bucket_high(i);
+            int64_t maxv = max();
+            return high < maxv ? high : maxv;
+        }
+    }
+
+    //读的时候写者还在更新，各个桶加起来可能比 count_ 少
+    return max();
+}
+
+LoopHistogram::Snapshot LoopHistogram::snapshot() const
+{
+    Snapshot result;
+    result.count = count();
+    result.max = max();
+    result.mean = result.count > 0 ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / result.count : 0.0;
+    result.p50 = percentile(0.5);
+    result.p90 = percentile(0.9);
+    result.p99 = percentile(0.99);
+    result.p999 = percentile(0.999);
+    return result;
+}
+
+static void append_histogram(std::string& out, const char* name, const LoopHistogram& histogram)
+{
+    LoopHistogram::Snapshot s = histogram.snapshot();
+    char buf[256];
+    snprintf(buf, sizeof(buf), "%s%s n=%lld mean=%.1f p50=%lld p90=%lld p99=%lld p999=%lld max=%lld",
+        out.empty() ? "" : ", ", name, (long long)s.count, s.mean,
+        (long long)s.p50, (long long)s.p90, (long long)s.p99, (long long)s.p999, (long long)s.max);
+    out += buf;
+}
+
+std::string LoopMetrics::to_string() const
+{
+    std::string out;
+    append_histogram(out, "poll_wait_us", poll_wait_us_);
+    append_histogram(out, "handling_us", handling_us_);
+    append_histogram(out, "active_channels", active_channels_);
+    append_histogram(out, "pending_functors", pending_functors_);
+    append_histogram(out, "timer_lag_us", timer_lag_us_);
+    return out;
+}
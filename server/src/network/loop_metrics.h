@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace w_network
+{
+    /// HDR 风格的直方图：数值按 2 的幂分段，每段再等分成 sub_buckets 个桶，
+    /// 相对误差不超过 1/sub_buckets，覆盖整个 int64_t 范围，不需要预先知道数值的范围
+    ///
+    /// 只有一个写者（loop 线程），计数用 relaxed load + store，不需要原子加；
+    /// 任意线程都可以无锁读，读到的是近似一致的快照
+    class LoopHistogram
+    {
+    public:
+        static const int sub_bucket_bits = 3;
+        static const int sub_buckets = 1 << sub_bucket_bits;
+        //非负的 int64_t 最高位是第 62 位
+        static const int bucket_count = (63 - sub_bucket_bits + 1) * sub_buckets;
+
+        struct Snapshot
+        {
+            int64_t count;
+            int64_t max;
+            double  mean;
+            int64_t p50;
+            int64_t p90;
+            int64_t p99;
+            int64_t p999;
+        };
+
+        LoopHistogram();
+
+        /// 只在 loop 线程中调用
+        void record(int64_t value);
+
+        int64_t count() const { return count_.load(std::memory_order_relaxed); }
+        int64_t max() const { return max_.load(std::memory_order_relaxed); }
+        /// 第 q 分位（0 ~ 1）所在桶的上界
+        int64_t percentile(double q) const;
+        Snapshot snapshot() const;
+
+    private:
+        LoopHistogram(const LoopHistogram& rhs) = delete;
+        LoopHistogram& operator=(const LoopHistogram& rhs) = delete;
+
+        static int _bucket_index(uint64_t value);
+        static int64_t _bucket_high(int index);
+
+        static void _bump(std::atomic<int64_t>& counter, int64_t n)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<int64_t>    buckets_[bucket_count];
+        std::atomic<int64_t>    count_;
+        std::atomic<int64_t>    sum_;
+        std::atomic<int64_t>    max_;
+    };
+
+    /// 一个 EventLoop 每次迭代的统计，用来在线上找出忙的 loop，见 EventLoop::metrics()
+    ///
+    /// 时间都复用 loop 本来就要取的时间戳，不额外调用 clock_gettime。
+    /// 只由 loop 线程写，任意线程都可以无锁读
+    class LoopMetrics
+    {
+    public:
+        LoopMetrics() {}
+
+        /// poll 等待时间，单位微秒
+        const LoopHistogram& poll_wait_us() const { return poll_wait_us_; }
+        /// 处理事件、任务和 flush 的时间，单位微秒
+        const LoopHistogram& handling_us() const { return handling_us_; }
+        /// 每次 poll 返回的活跃 channel 数
+        const LoopHistogram& active_channels() const { return active_channels_; }
+        /// 每次迭代执行的 queue_in_loop 任务数，即取任务时队列的深度
+        const LoopHistogram& pending_functors() const { return pending_functors_; }
+        /// 定时器实际执行时间比到期时间晚了多少，单位微秒
+        const LoopHistogram& timer_lag_us() const { return timer_lag_us_; }
+
+        /// 一行文本，打日志用，如 "poll_wait_us n=.. p50=.. p99=.. max=.., handling_us ..."
+        std::string to_string() const;
+
+        // 以下只在 loop 线程中调用
+        void on_poll(int64_t wait_us, size_t active) { poll_wait_us_.record(wait_us); active_channels_.record(static_cast<int64_t>(active)); }
+        void on_iteration(int64_t handling_us, size_t functors) { handling_us_.record(handling_us); pending_functors_.record(static_cast<int64_t>(functors)); }
+        void on_timer(int64_t lag_us) { timer_lag_us_.record(lag_us); }
+
+    private:
+        LoopMetrics(const LoopMetrics& rhs) = delete;
+        LoopMetrics& operator=(const LoopMetrics& rhs) = delete;
+
+    private:
+        LoopHistogram   poll_wait_us_;
+        LoopHistogram   handling_us_;
+        LoopHistogram   active_channels_;
+        LoopHistogram   pending_functors_;
+        LoopHistogram   timer_lag_us_;
+    };
+}
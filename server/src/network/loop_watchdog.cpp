@@ -0,0 +1,238 @@
+#include "loop_watchdog.h"
+#include "event_loop.h"
+#include "log/whisp_log.h"
+
+#ifndef WIN32
+#include <execinfo.h>   // backtrace()
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+using namespace w_network;
+
+#ifndef WIN32
+namespace
+{
+    //SIGRTMIN 不是编译期常量，用的时候再算
+    int stall_signal()
+    {
+        return SIGRTMIN + 4;
+    }
+
+    const int max_frames = 64;
+
+    //同一时间只有看门狗线程在取一个调用栈
+    struct BacktraceRequest
+    {
+        std::atomic<int>    state;      // 0 空闲，1 已发信号，2 已取到
+        void*               frames[max_frames];
+        int                 depth;
+    };
+
+    BacktraceRequest backtrace_request;
+
+    void stall_signal_handler(int)
+    {
+        if (backtrace_request.state.load(std::memory_order_acquire) != 1)
+            return;
+
+        backtrace_request.depth = ::backtrace(backtrace_request.frames, max_frames);
+        backtrace_request.state.store(2, std::memory_order_release);
+    }
+
+    void install_stall_signal_handler()
+    {
+        //backtrace() 第一次调用时会加载 libgcc，先在普通上下文里调一次，信号处理函数里就不会再分配内存
+        void* warmup[1];
+        ::backtrace(warmup, 1);
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = stall_signal_handler;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (::sigaction(stall_signal(), &action, NULL) != 0)
+        {
+            WHISP_LOG_SYSERROR("LoopWatchdog, sigaction failed");
+        }
+    }
+}
+#endif
+
+LoopWatchdog::LoopWatchdog(int64_t threshold_ms, int64_t report_interval_ms/* = 10 * 1000*/)
+    : threshold_us_(threshold_ms * 1000),
+    report_interval_us_(report_interval_ms * 1000),
+    running_(false),
+    stall_count_(0)
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+}
+
+void LoopWatchdog::watch(EventLoop* loop)
+{
+    Watched watched;
+    watched.loop_ = loop;
+    watched.last_token_ = 0;
+    watched.last_polls_ = 0;
+    watched.busy_since_us_ = 0;
+    watched.callback_since_us_ = 0;
+    watched.reported_ = false;
+    watched.last_report_us_ = 0;
+    watched.suppressed_ = 0;
+    loops_.push_back(watched);
+}
+
+void LoopWatchdog::start()
+{
+    if (thread_ || loops_.empty() || threshold_us_ <= 0)
+        return;
+
+#ifndef WIN32
+    install_stall_signal_handler();
+#endif
+    running_ = true;
+    thread_.reset(new std::thread(std::bind(&LoopWatchdog::_thread_proc, this)));
+    WHISP_LOG_INFO("LoopWatchdog start, %d loops, threshold %lld ms", (int)loops_.size(), (long long)(threshold_us_ / 1000));
+}
+
+void LoopWatchdog::stop()
+{
+    if (!thread_)
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_all();
+    thread_->join();
+    thread_.reset();
+}
+
+void LoopWatchdog::_thread_proc()
+{
+    //采样间隔取阈值的 1/4，卡顿最多晚 1/4 阈值发现
+    int64_t interval_us = threshold_us_ / 4;
+    if (interval_us < 1000)
+        interval_us = 1000;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cond_.wait_for(lock, std::chrono::microseconds(interval_us));
+        if (!running_)
+            break;
+
+        int64_t now_us = Timestamp::now().microSecondsSinceEpoch();
+        for (Watched& watched : loops_)
+        {
+            _check(watched, now_us);
+        }
+    }
+}
+
+void LoopWatchdog::_check(Watched& watched, int64_t now_us)
+{
+    const LoopActivity& activity = watched.loop_->activity();
+    uint64_t polls = activity.polls();
+    uint64_t token = activity.token();
+    LoopActivity::Kind kind = LoopActivity::kind_of(token);
+    if (token != watched.last_token_)
+    {
+        watched.last_token_ = token;
+        watched.callback_since_us_ = now_us;
+    }
+
+    //两次采样之间回到过 poll 上，是新的一次迭代
+    if (kind == LoopActivity::kPolling || polls != watched.last_polls_)
+    {
+        watched.last_polls_ = polls;
+        watched.busy_since_us_ = kind == LoopActivity::kPolling ? 0 : now_us;
+        watched.reported_ = false;
+        return;
+    }
+
+    if (watched.busy_since_us_ == 0)
+    {
+        watched.busy_since_us_ = now_us;
+        return;
+    }
+
+    if (watched.reported_ || now_us - watched.busy_since_us_ < threshold_us_)
+        return;
+
+    //一次迭代只算一次卡顿
+    watched.reported_ = true;
+    stall_count_.fetch_add(1, std::memory_order_relaxed);
+    if (watched.last_report_us_ != 0 && now_us - watched.last_report_us_ < report_interval_us_)
+    {
+        ++watched.suppressed_;
+        return;
+    }
+
+    _report(watched, token, now_us);
+    watched.last_report_us_ = now_us;
+    watched.suppressed_ = 0;
+}
+
+void LoopWatchdog::_report(Watched& watched, uint64_t token, int64_t now_us)
+{
+    LoopActivity::Kind kind = LoopActivity::kind_of(token);
+    std::string stack = _capture_backtrace(watched.loop_);
+    WHISP_LOG_WARN("EventLoop 0x%x stalled: iteration running for %lld ms, current %s (fd/index %d) running for %lld ms, %lld stalls suppressed since last report\n%s",
+        watched.loop_, (long long)((now_us - watched.busy_since_us_) / 1000),
+        LoopActivity::kind_name(kind), LoopActivity::fd_of(token),
+        (long long)((now_us - watched.callback_since_us_) / 1000), (long long)watched.suppressed_,
+        stack.empty() ? "(no backtrace)" : stack.c_str());
+}
+
+std::string LoopWatchdog::_capture_backtrace(EventLoop* loop)
+{
+#ifdef WIN32
+    return std::string();
+#else
+    int expected = 0;
+    if (!backtrace_request.state.compare_exchange_strong(expected, 1))
+        return std::string();
+
+    if (::pthread_kill(loop->native_thread(), stall_signal()) != 0)
+    {
+        backtrace_request.state.store(0);
+        return std::string();
+    }
+
+    //最多等 100 毫秒
+    for (int i = 0; i < 100 && backtrace_request.state.load(std::memory_order_acquire) != 2; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::string result;
+    expected = 1;
+    if (backtrace_request.state.compare_exchange_strong(expected, 0))
+    {
+        //信号没有及时处理，放弃这次
+        return result;
+    }
+
+    char** symbols = ::backtrace_symbols(backtrace_request.frames, backtrace_request.depth);
+    if (symbols != NULL)
+    {
+        //第 0、1 帧是信号处理函数和内核的信号跳板
+        for (int i = 2; i < backtrace_request.depth; ++i)
+        {
+            result += "    ";
+            result += symbols[i];
+            result += "\n";
+        }
+        ::free(symbols);
+    }
+    backtrace_request.state.store(0, std::memory_order_release);
+    return result;
+#endif
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace w_network
+{
+    class EventLoop;
+
+    /// EventLoop 卡顿看门狗
+    ///
+    /// 独立线程定时采样每个 loop 的 LoopActivity：一次迭代（从 poll 返回开始）超过
+    /// threshold_ms 还没回到 poll 上，就报告当时正在执行的回调（channel 的 fd、第几个
+    /// queue_in_loop 任务、定时器……）和 loop 线程的调用栈，比如业务回调里同步查数据库。
+    /// 调用栈通过给 loop 线程发 stall_signal 信号，在信号处理函数里 backtrace() 取得，
+    /// 信号用 SA_RESTART 安装，被打断的系统调用会自动重启。
+    /// 同一个 loop 每 report_interval_ms 最多报告一次，期间的卡顿只计数。
+    /// loop 本身只在每个回调前多一次 relaxed store，见 LoopActivity::mark()
+    class LoopWatchdog
+    {
+    public:
+        LoopWatchdog(int64_t threshold_ms, int64_t report_interval_ms = 10 * 1000);
+        ~LoopWatchdog();
+
+        /// Not thread safe, 在 start() 之前调用
+        void watch(EventLoop* loop);
+
+        void start();
+        void stop();
+
+        /// 累计发现的卡顿次数，包括被限流没有报告的
+        int64_t stall_count() const { return stall_count_.load(std::memory_order_relaxed); }
+
+    private:
+        LoopWatchdog(const LoopWatchdog& rhs) = delete;
+        LoopWatchdog& operator=(const LoopWatchdog& rhs) = delete;
+
+        struct Watched
+        {
+            EventLoop*  loop_;
+            uint64_t    last_token_;
+            uint64_t    last_polls_;
+            int64_t     busy_since_us_;         // 这次迭代离开 poll 的时间（采样得到），0 表示在 poll 上
+            int64_t     callback_since_us_;     // 当前回调开始的时间（采样得到）
+            bool        reported_;              // 这次迭代已经处理过
+            int64_t     last_report_us_;
+            int64_t     suppressed_;            // 限流期间没有报告的卡顿次数
+        };
+
+        void _thread_proc();
+        void _check(Watched& watched, int64_t now_us);
+        void _report(Watched& watched, uint64_t token, int64_t now_us);
+        // 取 loop 线程当前的调用栈，每行一帧，取不到返回空串
+        std::string _capture_backtrace(EventLoop* loop);
+
+    private:
+        const int64_t               threshold_us_;
+        const int64_t               report_interval_us_;
+        std::vector<Watched>        loops_;
+        std::unique_ptr<std::thread> thread_;
+        std::mutex                  mutex_;
+        std::condition_variable     cond_;
+        bool                        running_;
+        std::atomic<int64_t>        stall_count_;
+    };
+}
@@ -0,0 +1,84 @@
+#include "output_budget.h"
+#include "tcp_connect.h"
+#include "log/whisp_log.h"
+#include <vector>
+
+using namespace w_network;
+
+const int64_t OutputBudget::shed_interval_us;
+
+OutputBudget::OutputBudget(size_t budget_bytes)
+    : budget_(budget_bytes),
+    used_(0),
+    last_shed_us_(0),
+    shed_count_(0)
+{
+}
+
+void OutputBudget::update(const std::shared_ptr<TcpConnection>& conn, size_t old_bytes, size_t new_bytes, int64_t since_us)
+{
+    if (old_bytes == new_bytes)
+        return;
+
+    size_t used;
+    if (new_bytes > old_bytes)
+        used = used_.fetch_add(new_bytes - old_bytes, std::memory_order_relaxed) + (new_bytes - old_bytes);
+    else
+        used = used_.fetch_sub(old_bytes - new_bytes, std::memory_order_relaxed) - (old_bytes - new_bytes);
+
+    if (old_bytes == 0 || new_bytes == 0)
+    {
+        BacklogKey key(since_us, conn->id());
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (old_bytes == 0)
+            backlog_.emplace(key, conn);
+        else
+            backlog_.erase(key);
+    }
+
+    if (used > budget_)
+    {
+        int64_t now_us = Timestamp::now().microSecondsSinceEpoch();
+        int64_t last = last_shed_us_.load(std::memory_order_relaxed);
+        if (now_us - last >= shed_interval_us && last_shed_us_.compare_exchange_strong(last, now_us))
+        {
+            _shed();
+        }
+    }
+}
+
+void OutputBudget::_shed()
+{
+    size_t used = used_.load(std::memory_order_relaxed);
+    if (used <= budget_)
+        return;
+
+    size_t excess = used - budget_;
+    size_t freed = 0;
+    std::vector<std::shared_ptr<TcpConnection>> victims;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto iter = backlog_.begin();
+        while (iter != backlog_.end() && freed < excess)
+        {
+            std::shared_ptr<TcpConnection> conn = iter->second.lock();
+            iter = backlog_.erase(iter);
+            if (!conn)
+                continue;
+
+            freed += conn->queued_output_bytes();
+            victims.push_back(std::move(conn));
+        }
+    }
+
+    //内存要等连接在自己的 loop 里关闭后才释放
+    for (const auto& conn : victims)
+    {
+        WHISP_LOG_WARN("output budget exceeded, shed slow consumer #%llu, %s, queued %zu bytes",
+            (unsigned long long)conn->id(), conn->peer_address().inet_2_ipport().c_str(), conn->queued_output_bytes());
+        conn->force_close();
+    }
+    shed_count_.fetch_add(static_cast<int64_t>(victims.size()), std::memory_order_relaxed);
+    WHISP_LOG_WARN("output budget %zu bytes, used %zu bytes, shed %d connections, freeing ~%zu bytes",
+        budget_, used, (int)victims.size(), freed);
+}
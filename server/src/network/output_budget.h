@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <utility>
+
+namespace w_network
+{
+    class TcpConnection;
+
+    /// 所有连接输出队列共用的内存预算
+    ///
+    /// 每个连接的输出队列变化时调用 update()，总量超过预算时按开始积压的时间从早到晚
+    /// 强制关闭慢消费者，直到腾出超出的部分。队列一直非空的连接只做一次原子加，
+    /// 只有队列从空变非空、从非空变空和淘汰时才加锁。任意 IO 线程都可以调用
+    class OutputBudget
+    {
+    public:
+        /// 两次淘汰之间至少隔这么久，等上一批被关闭的连接释放内存，单位微秒
+        static const int64_t shed_interval_us = 100 * 1000;
+
+        explicit OutputBudget(size_t budget_bytes);
+
+        /// conn 的输出队列从 old_bytes 变成 new_bytes，since_us 是这次积压开始的时间
+        void update(const std::shared_ptr<TcpConnection>& conn, size_t old_bytes, size_t new_bytes, int64_t since_us);
+
+        size_t budget() const { return budget_; }
+        size_t used() const { return used_.load(std::memory_order_relaxed); }
+        /// 累计被淘汰的连接数
+        int64_t shed_count() const { return shed_count_.load(std::memory_order_relaxed); }
+
+    private:
+        OutputBudget(const OutputBudget& rhs) = delete;
+        OutputBudget& operator=(const OutputBudget& rhs) = delete;
+
+        void _shed();
+
+    private:
+        typedef std::pair<int64_t, uint64_t> BacklogKey;       // 开始积压的时间, 连接 id
+
+        const size_t                                                budget_;
+        std::atomic<size_t>                                         used_;
+        std::atomic<int64_t>                                        last_shed_us_;
+        std::atomic<int64_t>                                        shed_count_;
+        std::mutex                                                  mutex_;
+        std::map<BacklogKey, std::weak_ptr<TcpConnection>>          backlog_;
+    };
+}
@@ -11,7 +11,7 @@ namespace w_network
     {
     public:
         Poller();
-        ~Poller();
+        virtual ~Poller();
 
     public:
         typedef std::vector<Channel*> ChannelList;
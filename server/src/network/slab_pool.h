@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace w_network
+{
+    /// 定长对象的 slab 池：一次向系统要 objects_per_slab 个槽，释放的槽挂在空闲链表上复用，
+    /// 内存只增不还，上限就是连接数的峰值。任意线程都可以分配和释放
+    template <size_t Size, size_t Align>
+    class SlabPool
+    {
+    public:
+        static const size_t objects_per_slab = 256;
+
+        static SlabPool& instance()
+        {
+            //故意不析构，进程退出时可能还有连接没释放
+            static SlabPool* pool = new SlabPool();
+            return *pool;
+        }
+
+        void* allocate()
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (free_list_ == nullptr)
+            {
+                _grow();
+            }
+
+            FreeNode* node = free_list_;
+            free_list_ = node->next_;
+            return node;
+        }
+
+        void deallocate(void* p)
+        {
+            FreeNode* node = static_cast<FreeNode*>(p);
+            std::unique_lock<std::mutex> lock(mutex_);
+            node->next_ = free_list_;
+            free_list_ = node;
+        }
+
+    private:
+        struct FreeNode
+        {
+            FreeNode* next_;
+        };
+
+        static const size_t slot_align = Align > alignof(FreeNode) ? Align : alignof(FreeNode);
+        static const size_t slot_size = ((Size > sizeof(FreeNode) ? Size : sizeof(FreeNode)) + slot_align - 1) / slot_align * slot_align;
+
+        SlabPool() : free_list_(nullptr) {}
+        SlabPool(const SlabPool& rhs) = delete;
+        SlabPool& operator=(const SlabPool& rhs) = delete;
+
+        void _grow()
+        {
+            char* slab = static_cast<char*>(::operator new(slot_size * objects_per_slab, std::align_val_t(slot_align)));
+            slabs_.push_back(slab);
+            for (size_t i = objects_per_slab; i > 0; --i)
+            {
+                FreeNode* node = reinterpret_cast<FreeNode*>(slab + (i - 1) * slot_size);
+                node->next_ = free_list_;
+                free_list_ = node;
+            }
+        }
+
+    private:
+        std::mutex          mutex_;
+        FreeNode*           free_list_;
+        std::vector<char*>  slabs_;
+    };
+
+    /// 给 std::allocate_shared 用的分配器，单个对象从对应大小的 SlabPool 中分配，
+    /// 这样对象和 shared_ptr 的控制块在同一个槽里，只有一次分配
+    template <typename T>
+    class SlabAllocator
+    {
+    public:
+        typedef T value_type;
+
+        SlabAllocator() {}
+        template <typename U>
+        SlabAllocator(const SlabAllocator<U>&) {}
+
+        T* allocate(size_t n)
+        {
+            if (n != 1)
+                return static_cast<T*>(::operator new(n * sizeof(T)));
+            return static_cast<T*>(SlabPool<sizeof(T), alignof(T)>::instance().allocate());
+        }
+
+        void deallocate(T* p, size_t n)
+        {
+            if (n != 1)
+            {
+                ::operator delete(p);
+                return;
+            }
+            SlabPool<sizeof(T), alignof(T)>::instance().deallocate(p);
+        }
+
+        template <typename U>
+        bool operator==(const SlabAllocator<U>&) const { return true; }
+        template <typename U>
+        bool operator!=(const SlabAllocator<U>&) const { return false; }
+    };
+}
@@ -0,0 +1,98 @@
+#include "task_queue.h"
+#include "loop_activity.h"
+
+using namespace w_network;
+
+TaskQueue::TaskQueue()
+    : head_(&stub_),
+    pushed_(0),
+    tail_(&stub_),
+    popped_(0)
+{
+}
+
+TaskQueue::~TaskQueue()
+{
+    while (Node* node = _pop())
+    {
+        delete node;
+    }
+}
+
+void TaskQueue::push(Task&& task)
+{
+    //先计数再入队，消费者看到的计数不会比能取到的任务少
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+    _push(new Node(std::move(task)));
+}
+
+void TaskQueue::_push(Node* node)
+{
+    node->next_.store(nullptr, std::memory_order_relaxed);
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    //这里到下一行之间，消费者从 prev 往后看不到 node
+    prev->next_.store(node, std::memory_order_release);
+}
+
+TaskQueue::Node* TaskQueue::_pop()
+{
+    Node* tail = tail_;
+    Node* next = tail->next_.load(std::memory_order_acquire);
+    if (tail == &stub_)
+    {
+        if (next == nullptr)
+            return nullptr;
+
+        tail_ = next;
+        tail = next;
+        next = next->next_.load(std::memory_order_acquire);
+    }
+
+    if (next != nullptr)
+    {
+        tail_ = next;
+        return tail;
+    }
+
+    //tail 不是最后一个节点，有生产者正在入队，下次再取
+    if (tail != head_.load(std::memory_order_acquire))
+        return nullptr;
+
+    //tail 是最后一个节点，把 stub_ 放回队尾才能把它取走
+    _push(&stub_);
+    next = tail->next_.load(std::memory_order_acquire);
+    if (next != nullptr)
+    {
+        tail_ = next;
+        return tail;
+    }
+
+    return nullptr;
+}
+
+size_t TaskQueue::run_all(LoopActivity* activity/* = nullptr*/)
+{
+    //只执行调用时已经入队的个数，任务里再 queue_in_loop 的留到下一轮，避免饿死 I/O。
+    //不能按调用时的队尾节点判断：_pop() 取走最后一个节点时会把 stub_ 放回队尾，
+    //这之前刚入队的任务排在 stub_ 前面，队尾是 stub_ 时队列不一定是空的
+    uint64_t limit = pushed_.load(std::memory_order_relaxed) - popped_;
+
+    size_t n = 0;
+    while (n < limit)
+    {
+        Node* node = _pop();
+        if (node == nullptr)
+            break;
+
+        ++popped_;
+        if (activity)
+        {
+            activity->mark(LoopActivity::kFunctor, static_cast<int>(n));
+        }
+        node->task_();
+        ++n;
+        delete node;
+    }
+
+    return n;
+}
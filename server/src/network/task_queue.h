@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+namespace w_network
+{
+    class LoopActivity;
+
+    /// 多生产者单消费者的无锁任务队列（Vyukov 侵入式 MPSC）
+    ///
+    /// 任意线程都可以 push()，入队只有一次原子 exchange 和一次 store，不加锁。
+    /// 任务被 move 进节点，之后不再拷贝。run_all() 只能在消费者（loop）线程中调用。
+    ///
+    /// 生产者 exchange 了 head_ 但还没链上 next_ 的短暂窗口里，消费者会认为队列已空，
+    /// 剩下的任务留到下一次 run_all()。调用方要保证这种生产者之后还会唤醒消费者，
+    /// 见 EventLoop::queue_in_loop()。
+    class TaskQueue
+    {
+    public:
+        typedef std::function<void()> Task;
+
+        TaskQueue();
+        //没执行的任务直接丢弃
+        ~TaskQueue();
+
+        void push(Task&& task);
+
+        /// 最多执行调用时已经入队的那么多个任务，执行过程中新入队的留到下一次，返回执行的个数。
+        /// activity 不为空时每个任务执行前记一下，见 LoopActivity
+        size_t run_all(LoopActivity* activity = nullptr);
+
+    private:
+        TaskQueue(const TaskQueue& rhs) = delete;
+        TaskQueue& operator=(const TaskQueue& rhs) = delete;
+
+        struct Node
+        {
+            std::atomic<Node*>  next_;
+            Task                task_;
+
+            Node() : next_(nullptr) {}
+            explicit Node(Task&& task) : next_(nullptr), task_(std::move(task)) {}
+        };
+
+        void _push(Node* node);
+        Node* _pop();
+
+    private:
+        //生产者和消费者各自修改的变量放在不同的 cache line 上
+        alignas(64) std::atomic<Node*>  head_;      // 生产者在这里入队
+        std::atomic<uint64_t>           pushed_;    // 入队的任务总数，和 head_ 在同一个 cache line
+        alignas(64) Node*               tail_;      // 消费者从这里出队
+        uint64_t                        popped_;    // 出队的任务总数
+        Node                            stub_;
+    };
+}
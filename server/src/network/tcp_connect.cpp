@@ -1,10 +1,14 @@
 #include "tcp_connect.h"
 #include "event_loop.h"
 #include "log/whisp_log.h"
-#include "channel.h"
+#include "slab_pool.h"
+#include "output_budget.h"
 
 using namespace w_network;
 
+//边缘触发模式下一次可读事件最多读这么多次，剩下的放到下一轮，避免一个连接占住 loop
+static const int max_reads_per_edge = 16;
+
 void w_network::default_conn_callback(const TcpConnectionPtr& conn) 
 {
     WHISP_LOG_DEBUG("%s -> is %s",
@@ -18,31 +22,51 @@ void w_network::default_msg_callback(const TcpConnectionPtr& conn, ByteBuffer* b
     buffer->bb_retrieve_all();
 }
 
-TcpConnection::TcpConnection(EventLoop* loop, const std::string& nameArg, int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr)
+TcpConnection::TcpConnection(EventLoop* loop, uint64_t id, int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr)
     : loop_(loop),
-    name_(nameArg),
+    id_(id),
     state_(kConnecting),
-    socket_(new Socket(sockfd)),
-    channel_(new Channel(loop, sockfd)),
+    socket_(sockfd),
+    channel_(loop, sockfd),
     local_addr_(localAddr),
     peer_addr_(peerAddr),
-    high_water_mark_(64 * 1024 * 1024)
+    high_water_mark_(64 * 1024 * 1024),
+    coalesce_output_(false),
+    flush_pending_(false),
+    read_pause_high_(0),
+    read_pause_low_(0),
+    reading_paused_(false),
+    queued_output_bytes_(0),
+    output_since_us_(0)
 {
-    channel_->set_read_callback(std::bind(&TcpConnection::_handle_read, this, std::placeholders::_1));
-    channel_->set_write_callback(std::bind(&TcpConnection::_handle_write, this));
-    channel_->set_close_callback(std::bind(&TcpConnection::_handle_close, this));
-    channel_->set_error_callback(std::bind(&TcpConnection::_handle_error, this));
-    WHISP_LOG_DEBUG("TcpConnection::ctor[%s] at 0x%x fd=%d", name_.c_str(), this, sockfd);
-    socket_->sock_set_keepalive(true);
+    //只捕获 this 的 lambda 放得进 std::function 的内部缓冲区，std::bind 成员函数每个都要单独分配一次
+    channel_.set_read_callback([this](Timestamp receiveTime) { _handle_read(receiveTime); });
+    channel_.set_write_callback([this]() { _handle_write(); });
+    channel_.set_close_callback([this]() { _handle_close(); });
+    channel_.set_error_callback([this]() { _handle_error(); });
+    WHISP_LOG_DEBUG("TcpConnection::ctor[#%llu] at 0x%x fd=%d", (unsigned long long)id_, this, sockfd);
+    loop_->load().add_conn();
+    socket_.sock_set_keepalive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    WHISP_LOG_DEBUG("TcpConnection::dtor[%s] at 0x%x fd=%d state=%s",
-        name_.c_str(), this, channel_->fd(), _state_2_string());
+    WHISP_LOG_DEBUG("TcpConnection::dtor[#%llu] at 0x%x fd=%d state=%s",
+        (unsigned long long)id_, this, channel_.fd(), _state_2_string());
+    loop_->load().remove_conn();
     //assert(state_ == kDisconnected);
 }
 
+TcpConnectionPtr TcpConnection::create(EventLoop* loop, uint64_t id, int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr)
+{
+    return std::allocate_shared<TcpConnection>(SlabAllocator<TcpConnection>(), loop, id, sockfd, localAddr, peerAddr);
+}
+
+std::string TcpConnection::name() const
+{
+    return local_addr_.inet_2_ipport() + "#" + std::to_string(id_);
+}
+
 void TcpConnection::send(const void* data, int len)
 {
     if (state_ == kConnected)
@@ -53,16 +77,28 @@ void TcpConnection::send(const void* data, int len)
         }
         else
         {
-            std::string message(static_cast<const char*>(data), len);
-            loop_->run_in_loop(
-                std::bind(static_cast<void (TcpConnection::*)(const std::string&)>(&TcpConnection::_send_in_loop),
-                    this,     // FIXME
-                    message));
+            ChainBuffer::Payload message(std::make_shared<std::string>(static_cast<const char*>(data), len));
+            loop_->run_in_loop(std::bind(&TcpConnection::_send_payload_in_loop, shared_from_this(), std::move(message)));
         }
     }
 }
 
 void TcpConnection::send(const std::string& message)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->is_in_loop_thread())
+        {
+            _send_in_loop(message.data(), message.size());
+        }
+        else
+        {
+            send(std::make_shared<const std::string>(message));
+        }
+    }
+}
+
+void TcpConnection::send(std::string&& message)
 {
     if (state_ == kConnected)
     {
@@ -72,16 +108,61 @@ void TcpConnection::send(const std::string& message)
         }
         else
         {
-            loop_->run_in_loop(
-                std::bind(static_cast<void (TcpConnection::*)(const std::string&)>(&TcpConnection::_send_in_loop),
-                    this,     // FIXME
-                    message));
-            //std::forward<std::string>(message)));
+            send(std::make_shared<const std::string>(std::move(message)));
+        }
+    }
+}
+
+void TcpConnection::send(const ChainBuffer::Payload& message)
+{
+    if (state_ == kConnected && message)
+    {
+        //跨线程只传递引用计数，数据本身不拷贝
+        loop_->run_in_loop(std::bind(&TcpConnection::_send_payload_in_loop, shared_from_this(), message));
+    }
+}
+
+void TcpConnection::send_to_all(const std::vector<TcpConnectionPtr>& conns, const ChainBuffer::Payload& message)
+{
+    if (!message)
+        return;
+
+    //loop 的个数就是 IO 线程数，线性查找比哈希表更快
+    std::vector<std::pair<EventLoop*, std::vector<TcpConnectionPtr>>> groups;
+    for (const auto& conn : conns)
+    {
+        if (!conn || !conn->connected())
+            continue;
+
+        EventLoop* loop = conn->get_loop();
+        auto iter = groups.begin();
+        while (iter != groups.end() && iter->first != loop)
+        {
+            ++iter;
         }
+        if (iter == groups.end())
+        {
+            groups.emplace_back(loop, std::vector<TcpConnectionPtr>());
+            iter = groups.end() - 1;
+        }
+        iter->second.push_back(conn);
+    }
+
+    for (auto& group : groups)
+    {
+        group.first->run_in_loop(std::bind(&TcpConnection::_send_to_all_in_loop, std::move(group.second), message));
+    }
+}
+
+void TcpConnection::_send_to_all_in_loop(const std::vector<TcpConnectionPtr>& conns, const ChainBuffer::Payload& message)
+{
+    for (const auto& conn : conns)
+    {
+        //投递之后连接可能已经断开，_prepare_send() 会丢弃
+        conn->_send_payload_in_loop(message);
     }
 }
 
-// FIXME efficiency!!!
 void TcpConnection::send(ByteBuffer* buf)
 {
     if (state_ == kConnected)
@@ -93,51 +174,68 @@ void TcpConnection::send(ByteBuffer* buf)
         }
         else
         {
-            loop_->run_in_loop(
-                std::bind(static_cast<void (TcpConnection::*)(const std::string&)>(&TcpConnection::_send_in_loop),
-                    this,     // FIXME
-                    buf->bb_retrieve_all_as_string()));
-            //std::forward<std::string>(message)));
+            send(buf->bb_retrieve_all_as_string());
         }
     }
 }
 
-void TcpConnection::_send_in_loop(const std::string& message)
+void TcpConnection::_send_in_loop(const void* data, size_t len)
+{
+    size_t nwrote = 0;
+    if (_prepare_send(data, len, &nwrote))
+    {
+        output_buffer_.cb_append(static_cast<const char*>(data) + nwrote, len - nwrote);
+        _output_changed();
+    }
+}
+
+void TcpConnection::_send_in_loop(std::string& message)
 {
-    _send_in_loop(message.c_str(), message.size());
+    size_t nwrote = 0;
+    if (_prepare_send(message.data(), message.size(), &nwrote))
+    {
+        output_buffer_.cb_append(std::move(message), nwrote);
+        _output_changed();
+    }
 }
 
-void TcpConnection::_send_in_loop(const void* data, size_t len)
+void TcpConnection::_send_payload_in_loop(const ChainBuffer::Payload& message)
+{
+    size_t nwrote = 0;
+    if (_prepare_send(message->data(), message->size(), &nwrote))
+    {
+        output_buffer_.cb_append(message, nwrote);
+        _output_changed();
+    }
+}
+
+bool TcpConnection::_prepare_send(const void* data, size_t len, size_t* nwrote)
 {
     loop_->assert_in_loop_thread();
-    int32_t nwrote = 0;
     size_t remaining = len;
     bool faultError = false;
+    *nwrote = 0;
     if (state_ == kDisconnected)
     {
         WHISP_LOG_WARN("disconnected, give up writing");
-        return;
+        return false;
     }
     // if no thing in output queue, try writing directly
-    if (!channel_->is_writing() && output_buffer_.bb_bytes_readable() == 0)
+    if (!coalesce_output_ && !channel_.is_writing() && output_buffer_.cb_bytes_readable() == 0)
     {
-        nwrote = w_sockets::socks_write(channel_->fd(), data, len);
-        //TODO: 打印threadid用于调试，后面去掉
-        //std::stringstream ss;
-        //ss << std::this_thread::get_id();
-        //LOGI << "send data in threadID = " << ss;
-
-        if (nwrote >= 0)
+        int32_t n = w_sockets::socks_write(channel_.fd(), data, len);
+        if (n >= 0)
         {
-            remaining = len - nwrote;
+            loop_->load().add_bytes(n);
+            *nwrote = n;
+            remaining = len - n;
             if (remaining == 0 && write_complete_callback_)
             {
                 loop_->queue_in_loop(std::bind(write_complete_callback_, shared_from_this()));
             }
         }
-        else // nwrote < 0
+        else // n < 0
         {
-            nwrote = 0;
             if (errno != EWOULDBLOCK)
             {
                 WHISP_LOG_SYSERROR("TcpConnection::_send_in_loop");
@@ -149,24 +247,225 @@ void TcpConnection::_send_in_loop(const void* data, size_t len)
         }
     }
 
-    //assert(remaining <= len);
-    if (remaining > len)
+    if (faultError || remaining == 0)
+        return false;
+
+    _schedule_write(remaining);
+    return true;
+}
+
+void TcpConnection::_schedule_write(size_t remaining)
+{
+    //高水位按整个输出队列（所有块）的字节数计算
+    size_t oldLen = output_buffer_.cb_bytes_readable();
+    if (oldLen + remaining >= high_water_mark_
+        && oldLen < high_water_mark_
+        && high_water_mark_callback_)
+    {
+        loop_->queue_in_loop(std::bind(high_water_mark_callback_, shared_from_this(), oldLen + remaining));
+    }
+    if (channel_.is_writing())
+        return;
+
+    if (coalesce_output_)
+    {
+        //正在等可写事件时由 _handle_write 发，不用再排
+        if (!flush_pending_)
+        {
+            flush_pending_ = true;
+            TcpConnectionPtr self(shared_from_this());
+            loop_->queue_flush([self]() { self->_flush_output(); });
+        }
+    }
+    else
+    {
+        channel_.enable_writing();
+    }
+}
+
+void TcpConnection::send_file(int fd, int64_t offset, size_t len, const ChainBuffer::FileOwner& owner/* = ChainBuffer::FileOwner()*/)
+{
+    if (state_ == kConnected && fd >= 0 && len > 0)
+    {
+        if (loop_->is_in_loop_thread())
+        {
+            _send_file_in_loop(fd, offset, len, owner);
+        }
+        else
+        {
+            loop_->run_in_loop(std::bind(&TcpConnection::_send_file_in_loop, shared_from_this(), fd, offset, len, owner));
+        }
+    }
+}
+
+void TcpConnection::_send_file_in_loop(int fd, int64_t offset, size_t len, const ChainBuffer::FileOwner& owner)
+{
+    loop_->assert_in_loop_thread();
+    if (state_ == kDisconnected)
+    {
+        WHISP_LOG_WARN("disconnected, give up sending file");
+        return;
+    }
+
+    size_t nwrote = 0;
+#ifndef WIN32
+    //和 _prepare_send 一样，输出队列为空时先直接发
+    if (!coalesce_output_ && !channel_.is_writing() && output_buffer_.cb_bytes_readable() == 0)
+    {
+        ssize_t n = w_sockets::socks_sendfile(channel_.fd(), fd, offset, len);
+        if (n > 0)
+        {
+            loop_->load().add_bytes(n);
+            nwrote = n;
+            if (nwrote == len && write_complete_callback_)
+            {
+                loop_->queue_in_loop(std::bind(write_complete_callback_, shared_from_this()));
+            }
+        }
+        else if (n < 0 && errno != EWOULDBLOCK)
+        {
+            WHISP_LOG_SYSERROR("TcpConnection::_send_file_in_loop");
+            if (errno == EPIPE || errno == ECONNRESET)
+                return;
+        }
+    }
+#endif
+
+    if (nwrote == len)
+        return;
+
+    _schedule_write(len - nwrote);
+    output_buffer_.cb_append_file(fd, offset + nwrote, len - nwrote, owner);
+    _output_changed();
+}
+
+void TcpConnection::_flush_output()
+{
+    flush_pending_ = false;
+    if (state_ == kDisconnected || channel_.is_writing() || output_buffer_.cb_bytes_readable() == 0)
+        return;
+
+    //整个队列一次 writev，TCP 层看到的就是一次写，效果和 TCP_CORK/MSG_MORE 一样
+    int savedErrno = 0;
+    int32_t n = output_buffer_.cb_write_fd(channel_.fd(), &savedErrno);
+    if (n > 0)
+    {
+        loop_->load().add_bytes(n);
+        _output_changed();
+    }
+    else if (savedErrno != EWOULDBLOCK)
+    {
+        errno = savedErrno;
+        WHISP_LOG_SYSERROR("TcpConnection::_flush_output");
+        if (savedErrno == EPIPE || savedErrno == ECONNRESET)
+        {
+            _handle_close();
+            return;
+        }
+    }
+
+    if (output_buffer_.cb_bytes_readable() > 0)
+    {
+        channel_.enable_writing();
+        return;
+    }
+
+    if (write_complete_callback_)
+    {
+        loop_->queue_in_loop(std::bind(write_complete_callback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting)
+    {
+        _shutdown_in_loop();
+    }
+}
+
+void TcpConnection::set_read_backpressure(size_t high_mark, size_t low_mark)
+{
+    read_pause_high_ = high_mark;
+    read_pause_low_ = low_mark < high_mark ? low_mark : high_mark / 2;
+}
+
+void TcpConnection::_output_changed()
+{
+    if (read_pause_high_ == 0 && !output_budget_)
         return;
 
-    if (!faultError && remaining > 0)
+    //文件块不占内存，不计入背压和预算
+    size_t bytes = output_buffer_.cb_bytes_in_memory();
+    if (read_pause_high_ > 0)
     {
-        size_t oldLen = output_buffer_.bb_bytes_readable();
-        if (oldLen + remaining >= high_water_mark_
-            && oldLen < high_water_mark_
-            && high_water_mark_callback_)
+        if (!reading_paused_ && bytes >= read_pause_high_)
+        {
+            _pause_reading();
+        }
+        else if (reading_paused_ && bytes <= read_pause_low_)
         {
-            loop_->queue_in_loop(std::bind(high_water_mark_callback_, shared_from_this(), oldLen + remaining));
+            _resume_reading();
         }
-        output_buffer_.bb_append(static_cast<const char*>(data) + nwrote, remaining);
-        if (!channel_->is_writing())
+    }
+
+    size_t old = queued_output_bytes_.load(std::memory_order_relaxed);
+    if (output_budget_ && old != bytes)
+    {
+        if (old == 0)
         {
-            channel_->enable_writing();
+            output_since_us_ = Timestamp::now().microSecondsSinceEpoch();
         }
+        queued_output_bytes_.store(bytes, std::memory_order_relaxed);
+        output_budget_->update(shared_from_this(), old, bytes, output_since_us_);
+    }
+}
+
+void TcpConnection::_pause_reading()
+{
+    reading_paused_ = true;
+    WHISP_LOG_DEBUG("TcpConnection::_pause_reading fd = %d, output queue %zu bytes", channel_.fd(), output_buffer_.cb_bytes_in_memory());
+    //边缘触发模式下不再读就不会有新的通知，不用 epoll_ctl
+    if (!channel_.edge_triggered())
+    {
+        channel_.disable_reading();
+    }
+}
+
+void TcpConnection::_resume_reading()
+{
+    reading_paused_ = false;
+    if (state_ != kConnected && state_ != kDisconnecting)
+        return;
+
+    //消息回调暂停时留在输入缓冲区里的数据，不等新数据到达，先交给它
+    if (input_buffer_.bb_bytes_readable() > 0)
+    {
+        TcpConnectionPtr self(shared_from_this());
+        loop_->queue_in_loop([self]() { self->_deliver_pending_input(); });
+    }
+
+    if (channel_.edge_triggered())
+    {
+        //暂停期间到达的数据不会再触发边缘，主动读一次
+        loop_->queue_in_loop(std::bind(&TcpConnection::_handle_read, shared_from_this(), Timestamp::now()));
+    }
+    else
+    {
+        channel_.enable_reading();
+    }
+}
+
+void TcpConnection::_deliver_pending_input()
+{
+    if ((state_ == kConnected || state_ == kDisconnecting) && !reading_paused_ && input_buffer_.bb_bytes_readable() > 0)
+    {
+        msg_callback_(shared_from_this(), &input_buffer_, Timestamp::now());
+    }
+}
+
+void TcpConnection::_release_output_budget()
+{
+    size_t old = queued_output_bytes_.exchange(0, std::memory_order_relaxed);
+    if (output_budget_ && old > 0)
+    {
+        output_budget_->update(shared_from_this(), old, 0, output_since_us_);
     }
 }
 
@@ -184,10 +483,11 @@ void TcpConnection::shutdown()
 void TcpConnection::_shutdown_in_loop()
 {
     loop_->assert_in_loop_thread();
-    if (!channel_->is_writing())
+    //输出合并模式下队列里可能还有没 flush 的数据，发完之后由 _flush_output 再调用
+    if (!channel_.is_writing() && output_buffer_.cb_bytes_readable() == 0)
     {
         // we are not writing
-        socket_->sock_shutdown_write();
+        socket_.sock_shutdown_write();
     }
 }
 
@@ -204,10 +504,10 @@ void TcpConnection::_shutdown_in_loop()
 // void TcpConnection::shutdownAndForceCloseInLoop(double seconds)
 // {
 //   loop_->assert_in_loop_thread();
-//   if (!channel_->is_writing())
+//   if (!channel_.is_writing())
 //   {
 //     // we are not writing
-//     socket_->shutdownWrite();
+//     socket_.shutdownWrite();
 //   }
 //   loop_->runAfter(
 //       seconds,
@@ -253,9 +553,39 @@ const char* TcpConnection::_state_2_string() const
     }
 }
 
+void TcpConnection::set_edge_triggered(bool on)
+{
+    channel_.set_edge_triggered(on);
+}
+
 void TcpConnection::set_tcp_nodelay(bool on)
 {
-    socket_->sock_set_tcp_nodelay(on);
+    socket_.sock_set_tcp_nodelay(on);
+}
+
+void TcpConnection::set_idle_timeout(int64_t timeout_ms)
+{
+    loop_->run_in_loop(std::bind(&TcpConnection::_set_idle_timeout_in_loop, shared_from_this(), timeout_ms));
+}
+
+void TcpConnection::_set_idle_timeout_in_loop(int64_t timeout_ms)
+{
+    loop_->assert_in_loop_thread();
+    if (timeout_ms <= 0 || state_ == kDisconnected)
+    {
+        loop_->timing_wheel()->remove(&idle_entry_);
+        return;
+    }
+
+    //idle_entry_ 在连接关闭时一定会从时间轮上摘下来，这里用裸指针是安全的
+    loop_->timing_wheel()->add(&idle_entry_, timeout_ms, std::bind(&TcpConnection::_handle_idle_timeout, this));
+}
+
+void TcpConnection::_handle_idle_timeout()
+{
+    loop_->assert_in_loop_thread();
+    WHISP_LOG_INFO("TcpConnection::_handle_idle_timeout [%s] fd = %d, no data received, close it", name().c_str(), channel_.fd());
+    _force_close_in_loop();
 }
 
 void TcpConnection::conn_established()
@@ -270,7 +600,7 @@ void TcpConnection::conn_established()
     _set_state(kConnected);
 
     //假如正在执行这行代码时，对端关闭了连接
-    if (!channel_->enable_reading())
+    if (!channel_.enable_reading())
     {
         WHISP_LOG_ERROR("enable_reading failed.");
         //_set_state(kDisconnected);
@@ -288,22 +618,32 @@ void TcpConnection::conn_destroyed()
     if (state_ == kConnected)
     {
         _set_state(kDisconnected);
-        channel_->disable_all();
+        channel_.disable_all();
 
         conn_callback_(shared_from_this());
     }
-    channel_->remove();
+    _release_output_budget();
+    if (idle_entry_.linked())
+    {
+        loop_->timing_wheel()->remove(&idle_entry_);
+    }
+    channel_.remove();
 }
 
 void TcpConnection::_handle_read(Timestamp receiveTime)
 {
     loop_->assert_in_loop_thread();
+    if (channel_.edge_triggered())
+    {
+        _handle_read_edge_triggered(receiveTime);
+        return;
+    }
+
     int savedErrno = 0;
-    int32_t n = input_buffer_.bb_read_fd(channel_->fd(), &savedErrno);
+    int32_t n = input_buffer_.bb_read_fd(channel_.fd(), &savedErrno);
     if (n > 0)
     {
-        //messageCallback_指向CTcpSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* pBuffer, Timestamp receiveTime)
-        msg_callback_(shared_from_this(), &input_buffer_, receiveTime);
+        _on_read(n, receiveTime);
     }
     else if (n == 0)
     {
@@ -317,18 +657,94 @@ void TcpConnection::_handle_read(Timestamp receiveTime)
     }
 }
 
+void TcpConnection::_handle_read_edge_triggered(Timestamp receiveTime)
+{
+    //排队接着读的任务执行前连接可能已经关了，或者因为背压暂停了
+    if (state_ == kDisconnected || reading_paused_)
+        return;
+
+    for (int i = 0; i < max_reads_per_edge; ++i)
+    {
+        int savedErrno = 0;
+        int32_t n = input_buffer_.bb_read_fd(channel_.fd(), &savedErrno);
+        if (n > 0)
+        {
+            if (!_on_read(n, receiveTime))
+                return;
+        }
+        else if (n == 0)
+        {
+            _handle_close();
+            return;
+        }
+        else if (savedErrno == EINTR)
+        {
+            continue;
+        }
+        else if (savedErrno == EWOULDBLOCK)
+        {
+            return;
+        }
+        else
+        {
+            errno = savedErrno;
+            WHISP_LOG_SYSERROR("TcpConnection::handle_read");
+            _handle_error();
+            return;
+        }
+    }
+
+    //还没读到 EAGAIN，不会再有新的边缘通知，自己排到下一轮接着读
+    loop_->queue_in_loop(std::bind(&TcpConnection::_handle_read, shared_from_this(), Timestamp::now()));
+}
+
+bool TcpConnection::_on_read(int32_t n, Timestamp receiveTime)
+{
+    loop_->load().add_bytes(n);
+    if (idle_entry_.linked())
+    {
+        loop_->timing_wheel()->touch(&idle_entry_);
+    }
+    if (first_data_callback_)
+    {
+        _run_first_data_callback();
+    }
+    //messageCallback_指向CTcpSession::OnRead(const std::shared_ptr<TcpConnection>& conn, Buffer* pBuffer, Timestamp receiveTime)
+    msg_callback_(shared_from_this(), &input_buffer_, receiveTime);
+
+    //回调里可能已经关闭了连接，或者输出积压暂停了读
+    return (state_ == kConnected || state_ == kDisconnecting) && !reading_paused_;
+}
+
 void TcpConnection::_handle_write()
 {
     loop_->assert_in_loop_thread();
-    if (channel_->is_writing())
+    if (channel_.is_writing())
     {
-        int32_t n = w_sockets::socks_write(channel_->fd(), output_buffer_.bb_peek(), output_buffer_.bb_bytes_readable());
+        int savedErrno = 0;
+        //一次 writev 把输出队列里尽量多的块写出去，边缘触发模式下一直写到队列空或者 EAGAIN
+        int32_t n = output_buffer_.cb_write_fd(channel_.fd(), &savedErrno);
+        bool wrote = false;
+        while (n > 0)
+        {
+            wrote = true;
+            loop_->load().add_bytes(n);
+            if (!channel_.edge_triggered() || output_buffer_.cb_bytes_readable() == 0)
+                break;
+            n = output_buffer_.cb_write_fd(channel_.fd(), &savedErrno);
+        }
+
+        //边缘触发模式下可能写了几块之后才 EAGAIN，队列已经变短了，背压和输出预算也要更新
+        if (wrote && (n > 0 || savedErrno == EWOULDBLOCK))
+        {
+            _output_changed();
+        }
+
         if (n > 0)
         {
-            output_buffer_.bb_retrieve(n);
-            if (output_buffer_.bb_bytes_readable() == 0)
+            if (output_buffer_.cb_bytes_readable() == 0)
             {
-                channel_->disable_writing();
+                channel_.disable_writing();
                 if (write_complete_callback_)
                 {
                     loop_->queue_in_loop(std::bind(write_complete_callback_, shared_from_this()));
@@ -339,8 +755,13 @@ void TcpConnection::_handle_write()
                 }
             }
         }
+        else if (n < 0 && savedErrno == EWOULDBLOCK)
+        {
+            //发送缓冲区又满了，等下一次可写事件
+        }
         else
         {
+            errno = savedErrno;
             WHISP_LOG_SYSERROR("TcpConnection::_handle_write");
             // if (state_ == kDisconnecting)
             // {
@@ -352,7 +773,7 @@ void TcpConnection::_handle_write()
     }
     else
     {
-        WHISP_LOG_DEBUG("Connection fd = %d  is down, no more writing", channel_->fd());
+        WHISP_LOG_DEBUG("Connection fd = %d  is down, no more writing", channel_.fd());
     }
 }
 
@@ -365,11 +786,22 @@ void TcpConnection::_handle_close()
         return;
 
     loop_->assert_in_loop_thread();
-    WHISP_LOG_DEBUG("fd = %d  state = %s", channel_->fd(), _state_2_string());
+    WHISP_LOG_DEBUG("fd = %d  state = %s", channel_.fd(), _state_2_string());
     //assert(state_ == kConnected || state_ == kDisconnecting);
     // we don't close fd, leave it to dtor, so we can find leaks easily.
     _set_state(kDisconnected);
-    channel_->disable_all();
+    channel_.disable_all();
+    if (idle_entry_.linked())
+    {
+        loop_->timing_wheel()->remove(&idle_entry_);
+    }
+    //连接关闭后输出队列不会再发，占用的预算先还回去
+    _release_output_budget();
+
+    if (first_data_callback_)
+    {
+        _run_first_data_callback();
+    }
 
     TcpConnectionPtr guardThis(shared_from_this());
     conn_callback_(guardThis);
@@ -379,14 +811,22 @@ void TcpConnection::_handle_close()
     //只处理业务上的关闭，真正的socket fd在TcpConnection析构函数中关闭
     //if (socket_)
     //{
-    //    w_sockets::close(socket_->fd());
+    //    w_sockets::close(socket_.fd());
     //}
 }
 
+void TcpConnection::_run_first_data_callback()
+{
+    //只调用一次
+    ConnectionCallback cb;
+    cb.swap(first_data_callback_);
+    cb(shared_from_this());
+}
+
 void TcpConnection::_handle_error()
 {
-    int err = w_sockets::socks_get_error(channel_->fd());
-    WHISP_LOG_ERROR("TcpConnection::%s _handle_error [%d] - SO_ERROR = %s", name_.c_str(), err, strerror(err));
+    int err = w_sockets::socks_get_error(channel_.fd());
+    WHISP_LOG_ERROR("TcpConnection::%s _handle_error [%d] - SO_ERROR = %s", name().c_str(), err, strerror(err));
 
     //调用handleClose()关闭连接，回收Channel和fd
     _handle_close();
@@ -4,6 +4,12 @@
 #include "net_callback.h"
 #include "inet_address.h"
 #include "byte_buffer.h"
+#include "chain_buffer.h"
+#include "timing_wheel.h"
+#include "channel.h"
+#include "w_sockets.h"
+#include <atomic>
+#include <vector>
 
 // struct tcp_info;  // ?
 struct tcp_info;
@@ -11,21 +17,30 @@ struct tcp_info;
 namespace w_network
 {
     class EventLoop;
-    class Channel;
-    class Socket;
+    class OutputBudget;
 
     class TcpConnection : public std::enable_shared_from_this<TcpConnection>
     {
     public:
+        /// id 由 TcpServer 分配，进程内唯一。用 TcpConnection::create() 创建，
+        /// Socket、Channel 都是成员，和 shared_ptr 控制块一起从 slab 中一次分配
         TcpConnection(EventLoop* loop,
-            const std::string& name,
+            uint64_t id,
             int sockfd,
             const InetAddress& localAddr,
             const InetAddress& peerAddr);
         ~TcpConnection();
 
+        static std::shared_ptr<TcpConnection> create(EventLoop* loop,
+            uint64_t id,
+            int sockfd,
+            const InetAddress& localAddr,
+            const InetAddress& peerAddr);
+
         EventLoop* get_loop() const { return loop_; }
-        const std::string& name() const { return name_; }
+        uint64_t id() const { return id_; }
+        /// "本地地址#id"，每次调用现拼，只在打日志时用
+        std::string name() const;
         const InetAddress& local_address() const { return local_addr_; }
         const InetAddress& peer_address() const { return peer_addr_; }
         bool connected() const { return state_ == kConnected; }
@@ -33,11 +48,53 @@ namespace w_network
         void send(const void* message, int len);
         void send(const std::string& message);
         void send(ByteBuffer* message);  // this one will swap data
+        // 大块数据直接接管，不拷贝
+        void send(std::string&& message);
+        // 只增加引用计数，同一份数据可以发给多个连接
+        void send(const ChainBuffer::Payload& message);
+
+        /// 发送文件 fd 从 offset 开始的 len 字节，和其他 send 按调用顺序排队。
+        /// Linux 上用 sendfile(2)，数据不经过用户态。owner 不为空时一直引用到发完
+        /// （如 AvatarStore 的文件句柄），为空时由调用者保证发完之前不关闭 fd。线程安全
+        void send_file(int fd, int64_t offset, size_t len, const ChainBuffer::FileOwner& owner = ChainBuffer::FileOwner());
+
+        /// 把同一份数据发给一批连接（如群聊成员）。
+        /// 按所属 EventLoop 分组，每个 loop 只投递一个任务，数据本身只有一份。线程安全
+        static void send_to_all(const std::vector<std::shared_ptr<TcpConnection>>& conns, const ChainBuffer::Payload& message);
         void shutdown();
         void force_close();
 
         void set_tcp_nodelay(bool on);
 
+        /// 边缘触发模式，见 Channel::set_edge_triggered()。读写都做到 EAGAIN 为止，
+        /// 可写事件一直注册，发送时不再反复 epoll_ctl(MOD)。
+        /// Not thread safe, 在 conn_established() 之前调用
+        void set_edge_triggered(bool on);
+
+        /// 输出合并：loop 线程里的 send 不再立即 write，先放进输出队列，
+        /// 本轮迭代结束时（见 EventLoop::queue_flush()）每个连接用一次 writev 把队列发出去。
+        /// Not thread safe, 在 conn_established() 之前调用
+        void set_output_coalescing(bool on) { coalesce_output_ = on; }
+
+        /// 读端背压：输出队列达到 high_mark 字节时停止读 socket，降到 low_mark 以下再恢复，
+        /// 不读就不会再产生回包，慢消费者的积压由 TCP 窗口挡在对端。high_mark 为 0 表示不启用。
+        /// 消息回调可以检查 reading_paused()，暂停后不再处理缓冲区里剩下的请求，恢复时会再调用一次消息回调。
+        /// Not thread safe, 在 conn_established() 之前调用
+        void set_read_backpressure(size_t high_mark, size_t low_mark);
+
+        /// 输出队列计入所有连接共用的内存预算，超出时最早开始积压的连接会被关闭，见 OutputBudget。
+        /// Not thread safe, 在 conn_established() 之前调用
+        void set_output_budget(const std::shared_ptr<OutputBudget>& budget) { output_budget_ = budget; }
+
+        /// 最近一次计入预算的输出队列字节数（不含文件块）。Thread safe
+        size_t queued_output_bytes() const { return queued_output_bytes_.load(std::memory_order_relaxed); }
+        bool reading_paused() const { return reading_paused_; }
+
+        /// 空闲超时，单位毫秒，<= 0 表示不检测。
+        /// 每次读到数据（包括心跳包）都会重新计时，超时没有收到任何数据就关闭连接。
+        /// 线程安全
+        void set_idle_timeout(int64_t timeout_ms);
+
         void set_conn_callback(const ConnectionCallback& cb)
         {
             conn_callback_ = cb;
@@ -65,7 +122,7 @@ namespace w_network
             return &input_buffer_;
         }
 
-        ByteBuffer* output_buffer()
+        ChainBuffer* output_buffer()
         {
             return &output_buffer_;
         }
@@ -76,30 +133,59 @@ namespace w_network
             close_callback_ = cb;
         }
 
+        // Internal use only. 第一次读到数据，或者读到数据之前连接就关闭了，调用一次
+        void set_first_data_callback(const ConnectionCallback& cb)
+        {
+            first_data_callback_ = cb;
+        }
+
         void conn_established();
         void conn_destroyed();
 
     private:
         enum StateE { kDisconnected, kConnecting, kConnected, kDisconnecting };
         void _handle_read(Timestamp receiveTime);
+        // 边缘触发模式下读到 EAGAIN 为止
+        void _handle_read_edge_triggered(Timestamp receiveTime);
+        // 读到数据之后的处理，返回 false 表示连接已经不再读了
+        bool _on_read(int32_t n, Timestamp receiveTime);
         void _handle_write();
         void _handle_close();
         void _handle_error();
         // void sendInLoop(std::string&& message);
-        void _send_in_loop(const std::string& message);
         void _send_in_loop(const void* message, size_t len);
+        void _send_in_loop(std::string& message);
+        void _send_payload_in_loop(const ChainBuffer::Payload& message);
+        static void _send_to_all_in_loop(const std::vector<std::shared_ptr<TcpConnection>>& conns, const ChainBuffer::Payload& message);
+        // 输出队列为空时先直接写 socket，已写出的字节数放到 nwrote 中。
+        // 返回 true 表示还有数据要放进输出队列，此时已经检查过高水位并关注了可写事件
+        bool _prepare_send(const void* message, size_t len, size_t* nwrote);
+        // 还有 remaining 字节要放进输出队列：检查高水位，关注可写事件或者排队 flush
+        void _schedule_write(size_t remaining);
+        void _send_file_in_loop(int fd, int64_t offset, size_t len, const ChainBuffer::FileOwner& owner);
         void _shutdown_in_loop();
+        // 输出合并模式下本轮迭代结束时执行
+        void _flush_output();
+        // 输出队列有增减之后调用，处理读端背压和内存预算
+        void _output_changed();
+        void _pause_reading();
+        void _resume_reading();
+        void _deliver_pending_input();
+        void _release_output_budget();
         // void shutdownAndForceCloseInLoop(double seconds);
         void _force_close_in_loop();
+        void _set_idle_timeout_in_loop(int64_t timeout_ms);
+        void _handle_idle_timeout();
+        void _run_first_data_callback();
         void _set_state(StateE s) { state_ = s; }
         const char* _state_2_string() const;
 
     private:
         EventLoop* loop_;
-        const std::string           name_;
+        const uint64_t              id_;
         StateE                      state_;
-        std::unique_ptr<Socket>     socket_;
-        std::unique_ptr<Channel>    channel_;
+        Socket                      socket_;
+        Channel                     channel_;
         const InetAddress           local_addr_;
         const InetAddress           peer_addr_;
         ConnectionCallback          conn_callback_;
@@ -107,9 +193,19 @@ namespace w_network
         WriteCompleteCallback       write_complete_callback_;
         HighWaterMarkCallback       high_water_mark_callback_;
         CloseCallback               close_callback_;
+        ConnectionCallback          first_data_callback_;
         size_t                      high_water_mark_;
         ByteBuffer                  input_buffer_;
-        ByteBuffer                  output_buffer_;
+        ChainBuffer                 output_buffer_;
+        TimingWheel::Entry          idle_entry_;        // 挂在 loop_->timing_wheel() 上
+        bool                        coalesce_output_;
+        bool                        flush_pending_;     // 已经 queue_flush 过，还没执行
+        size_t                      read_pause_high_;
+        size_t                      read_pause_low_;
+        bool                        reading_paused_;
+        std::shared_ptr<OutputBudget> output_budget_;
+        std::atomic<size_t>         queued_output_bytes_;
+        int64_t                     output_since_us_;   // 这一次输出队列开始积压的时间
     };
 
     typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
@@ -3,6 +3,7 @@
 #include "acceptor.h"
 #include "event_loop.h"
 #include "event_loop_threadpool.h"
+#include <future>
 
 using namespace w_network;
 
@@ -11,16 +12,32 @@ TcpServer::TcpServer(EventLoop* loop,
     const std::string& nameArg,
     Option option)
     : loop_(loop),
+    listen_addr_(listenAddr),
+    option_(option),
     host_port_(listenAddr.inet_2_ipport()),
     name_(nameArg),
-    acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
     //threadPool_(new EventLoopThreadPool(loop, name_)),
     conn_callback_(default_conn_callback),
     msg_callback_(default_msg_callback),
     started_(0),
-    next_conn_id_(1)
+    conn_idle_timeout_ms_(0),
+    loop_select_policy_(EventLoopThreadPool::kRoundRobin),
+    edge_triggered_(false),
+    output_coalescing_(false),
+    read_pause_high_(0),
+    read_pause_low_(0),
+    stall_threshold_ms_(0),
+    max_accepts_per_wakeup_(Acceptor::default_max_accepts_per_wakeup),
+    max_conns_(0),
+    max_pending_handshakes_(0),
+    conn_count_(0),
+    pending_handshakes_(0)
 {
-    acceptor_->set_new_conn_callback(std::bind(&TcpServer::new_conn, this, std::placeholders::_1, std::placeholders::_2));
+    //kReusePortPerLoop 的监听 socket 要等 IO 线程起来后在 start() 中创建
+    if (option_ != kReusePortPerLoop)
+    {
+        acceptor_.reset(new Acceptor(loop, listenAddr, option_ == kReusePort));
+    }
 }
 
 TcpServer::~TcpServer()
@@ -43,24 +60,135 @@ void TcpServer::start(int workerThreadCount/* = 4*/)
     {
         event_loop_threadpool_.reset(new EventLoopThreadPool());
         event_loop_threadpool_->init(loop_, workerThreadCount);
+        event_loop_threadpool_->set_select_policy(loop_select_policy_);
+        event_loop_threadpool_->set_thread_cpus(io_cpus_);
         event_loop_threadpool_->start();
 
+        if (stall_threshold_ms_ > 0)
+        {
+            watchdog_.reset(new LoopWatchdog(stall_threshold_ms_));
+            watchdog_->watch(loop_);
+            //没有 IO 线程时 get_all_loops() 返回的就是 base loop
+            for (EventLoop* ioLoop : event_loop_threadpool_->get_all_loops())
+            {
+                if (ioLoop != loop_)
+                    watchdog_->watch(ioLoop);
+            }
+            watchdog_->start();
+        }
+
         //threadPool_->start(threadInitCallback_);
         //assert(!acceptor_->listenning());
-        loop_->run_in_loop(std::bind(&Acceptor::listen, acceptor_.get()));
+        if (option_ == kReusePortPerLoop)
+        {
+            start_per_loop_acceptors();
+        }
+        else
+        {
+            setup_acceptor(acceptor_.get(), nullptr);
+            loop_->run_in_loop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
         started_ = 1;
     }
 }
 
+void TcpServer::start_per_loop_acceptors()
+{
+    //没有 IO 线程时 get_all_loops() 返回 base loop
+    std::vector<EventLoop*> loops = event_loop_threadpool_->get_all_loops();
+    for (EventLoop* ioLoop : loops)
+    {
+        //每个 socket 都要设置 SO_REUSEPORT 才能绑定同一个地址
+        std::unique_ptr<Acceptor> acceptor(new Acceptor(ioLoop, listen_addr_, true));
+        setup_acceptor(acceptor.get(), ioLoop);
+        ioLoop->run_in_loop(std::bind(&Acceptor::listen, acceptor.get()));
+        loop_acceptors_.push_back(std::move(acceptor));
+    }
+
+    WHISP_LOG_INFO("TcpServer::start [%s] - %d SO_REUSEPORT acceptors listen on %s", name_.c_str(), (int)loop_acceptors_.size(), host_port_.c_str());
+}
+
+void TcpServer::setup_acceptor(Acceptor* acceptor, EventLoop* ioLoop)
+{
+    //ioLoop 为空表示 base loop 上唯一的 Acceptor，新连接轮流分给 IO loop
+    if (ioLoop == nullptr)
+    {
+        acceptor->set_new_conn_callback(std::bind(&TcpServer::new_conn, this, std::placeholders::_1, std::placeholders::_2));
+    }
+    else
+    {
+        acceptor->set_new_conn_callback(std::bind(&TcpServer::new_conn_in_io_loop, this, ioLoop, std::placeholders::_1, std::placeholders::_2));
+    }
+    acceptor->set_max_accepts_per_wakeup(max_accepts_per_wakeup_);
+    if (max_conns_ > 0 || max_pending_handshakes_ > 0 || ip_limiter_.enabled())
+    {
+        acceptor->set_admit_callback(std::bind(&TcpServer::admit_conn, this, std::placeholders::_1));
+    }
+}
+
+bool TcpServer::admit_conn(const InetAddress& peerAddr)
+{
+    //先判断不用加锁的条件
+    if (max_conns_ > 0 && conn_count_ >= max_conns_)
+        return false;
+
+    if (max_pending_handshakes_ > 0 && pending_handshakes_ >= max_pending_handshakes_)
+        return false;
+
+    return ip_limiter_.allow(peerAddr.inet_ip_netendian(), Timestamp::now());
+}
+
+void TcpServer::handshake_done(const TcpConnectionPtr& conn)
+{
+    --pending_handshakes_;
+    WHISP_LOG_DEBUG("TcpServer::handshake_done [%s] - connection #%llu sent its first data", name_.c_str(), (unsigned long long)conn->id());
+}
+
+void TcpServer::stop_per_loop_acceptors()
+{
+    //Acceptor 要在自己的 loop 线程中析构，等它们都析构完再停 IO 线程
+    for (auto& acceptor : loop_acceptors_)
+    {
+        EventLoop* ioLoop = acceptor->get_loop();
+        if (ioLoop->is_in_loop_thread())
+        {
+            acceptor.reset();
+            continue;
+        }
+
+        std::promise<void> done;
+        Acceptor* raw = acceptor.release();
+        ioLoop->run_in_loop([raw, &done]() {
+            delete raw;
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+    loop_acceptors_.clear();
+}
+
 void TcpServer::stop()
 {
     if (started_ == 0)
         return;
 
-    for (ConnectionMap::iterator it = conn_map_.begin(); it != conn_map_.end(); ++it)
+    //看门狗要在 IO loop 析构之前停掉
+    watchdog_.reset();
+
+    if (option_ == kReusePortPerLoop)
+    {
+        stop_per_loop_acceptors();
+    }
+
+    std::vector<TcpConnectionPtr> conns;
+    {
+        std::unique_lock<std::mutex> lock(conn_mutex_);
+        conn_table_.take_all(&conns);
+        conn_count_ = 0;
+    }
+
+    for (TcpConnectionPtr& conn : conns)
     {
-        TcpConnectionPtr conn = it->second;
-        it->second.reset();
         conn->get_loop()->run_in_loop(std::bind(&TcpConnection::conn_destroyed, conn));
         conn.reset();
     }
@@ -74,46 +202,101 @@ void TcpServer::new_conn(int sockfd, const InetAddress& peerAddr)
 {
     loop_->assert_in_loop_thread();
     EventLoop* ioLoop = event_loop_threadpool_->get_next_loop();
-    char buf[32];
-    snprintf(buf, sizeof buf, ":%s#%d", host_port_.c_str(), next_conn_id_);
-    ++next_conn_id_;
-    std::string connName = name_ + buf;
+    establish_conn(ioLoop, sockfd, peerAddr);
+}
 
-    WHISP_LOG_DEBUG("TcpServer::newConnection [%s] - new connection [%s] from %s", name_.c_str(), connName.c_str(), peerAddr.inet_2_ipport().c_str());
+void TcpServer::new_conn_in_io_loop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
+    ioLoop->assert_in_loop_thread();
+    //连接就在 accept 它的 loop 上处理，不再经过 base loop 转交
+    establish_conn(ioLoop, sockfd, peerAddr);
+}
+
+void TcpServer::establish_conn(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
+    uint64_t id;
+    {
+        std::unique_lock<std::mutex> lock(conn_mutex_);
+        id = conn_table_.reserve();
+    }
+
+    WHISP_LOG_DEBUG("TcpServer::newConnection [%s] - new connection [#%llu] fd = %d", name_.c_str(), (unsigned long long)id, sockfd);
 
     InetAddress localAddr(w_sockets::socks_get_local_addr(sockfd));
     // FIXME poll with zero timeout to double confirm the new connection
-    // FIXME use make_shared if necessary
-    TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-    conn_map_[connName] = conn;
+    TcpConnectionPtr conn;
+    try
+    {
+        conn = TcpConnection::create(ioLoop, id, sockfd, localAddr, peerAddr);
+    }
+    catch (...)
+    {
+        //创建失败（如 slab 分配不到内存）时把占的槽还回去，异常继续往上抛
+        WHISP_LOG_ERROR("TcpServer::establish_conn [%s] - failed to create connection [#%llu] fd = %d",
+            name_.c_str(), (unsigned long long)id, sockfd);
+        std::unique_lock<std::mutex> lock(conn_mutex_);
+        conn_table_.release(id);
+        throw;
+    }
+    {
+        std::unique_lock<std::mutex> lock(conn_mutex_);
+        conn_table_.fill(id, conn);
+        ++conn_count_;
+    }
+    if (max_pending_handshakes_ > 0)
+    {
+        ++pending_handshakes_;
+        conn->set_first_data_callback(std::bind(&TcpServer::handshake_done, this, std::placeholders::_1));
+    }
+    conn->set_edge_triggered(edge_triggered_);
+    conn->set_output_coalescing(output_coalescing_);
+    conn->set_read_backpressure(read_pause_high_, read_pause_low_);
+    conn->set_output_budget(output_budget_);
     conn->set_conn_callback(conn_callback_);
     conn->set_msg_callback(msg_callback_);
     conn->set_write_complete_callback(write_complete_callback_);
     conn->set_close_callback(std::bind(&TcpServer::remove_conn, this, std::placeholders::_1)); // FIXME: unsafe
     //该线程分离完io事件后，立即调用TcpConnection::conn_established
     ioLoop->run_in_loop(std::bind(&TcpConnection::conn_established, conn));
+    if (conn_idle_timeout_ms_ > 0)
+    {
+        conn->set_idle_timeout(conn_idle_timeout_ms_);
+    }
+}
+
+TcpConnectionPtr TcpServer::find_conn(uint64_t id)
+{
+    std::unique_lock<std::mutex> lock(conn_mutex_);
+    return conn_table_.find(id);
 }
 
 void TcpServer::remove_conn(const TcpConnectionPtr& conn)
 {
     // FIXME: unsafe
-    loop_->run_in_loop(std::bind(&TcpServer::remove_conn_in_loop, this, conn));
+    //close 回调在连接所属的 loop 中执行，conn_table_ 有锁保护，不用再转到 base loop
+    conn->get_loop()->run_in_loop(std::bind(&TcpServer::remove_conn_in_loop, this, conn));
 }
 
 void TcpServer::remove_conn_in_loop(const TcpConnectionPtr& conn)
 {
-    loop_->assert_in_loop_thread();
-    WHISP_LOG_DEBUG("TcpServer::remove_conn_in_loop [%s] - connection %s", name_.c_str(), conn->name().c_str());
-    size_t n = conn_map_.erase(conn->name());
-    //(void)n;
-    //assert(n == 1);
-    if (n != 1)
+    conn->get_loop()->assert_in_loop_thread();
+    WHISP_LOG_DEBUG("TcpServer::remove_conn_in_loop [%s] - connection #%llu", name_.c_str(), (unsigned long long)conn->id());
+    bool erased = false;
+    {
+        std::unique_lock<std::mutex> lock(conn_mutex_);
+        erased = conn_table_.erase(conn->id());
+        if (erased)
+        {
+            --conn_count_;
+        }
+    }
+    if (!erased)
     {
         //出现这种情况，是TcpConneaction对象在创建过程中，对方就断开连接了。
-        WHISP_LOG_DEBUG("TcpServer::remove_conn_in_loop [%s] - connection %s, connection does not exist.", name_.c_str(), conn->name().c_str());
+        WHISP_LOG_DEBUG("TcpServer::remove_conn_in_loop [%s] - connection #%llu does not exist.", name_.c_str(), (unsigned long long)conn->id());
         return;
     }
 
     EventLoop* ioLoop = conn->get_loop();
     ioLoop->queue_in_loop(std::bind(&TcpConnection::conn_destroyed, conn));
-}
\ No newline at end of file
+}
@@ -1,16 +1,21 @@
 #pragma once
 
 #include "tcp_connect.h"
+#include "ip_rate_limiter.h"
+#include "event_loop_threadpool.h"
+#include "conn_table.h"
+#include "output_budget.h"
+#include "loop_watchdog.h"
 
 #include <atomic>
-#include <map>
+#include <mutex>
+#include <vector>
 
 
 namespace w_network
 {
     class Acceptor;
     class EventLoop;
-    class EventLoopThreadPool;
 
     class TcpServer
     {
@@ -20,6 +25,9 @@ namespace w_network
         {
             kNoReusePort,
             kReusePort,
+            //每个 IO loop 各自一个 SO_REUSEPORT 的监听 socket，由内核把新连接分到各个 loop，
+            //accept 不再集中在 base loop 上
+            kReusePortPerLoop,
         };
 
         TcpServer(EventLoop* loop,
@@ -62,31 +70,153 @@ namespace w_network
             write_complete_callback_ = cb;
         }
 
+        /// Set idle timeout (ms) applied to every new connection, <= 0 disables it.
+        /// Not thread safe.
+        void set_conn_idle_timeout(int64_t timeout_ms)
+        {
+            conn_idle_timeout_ms_ = timeout_ms;
+        }
+
+        /// 以下是准入控制，超出限制的新连接在 accept 后直接 RST，不创建 TcpConnection。
+        /// Not thread safe, 在 start() 之前调用
+
+        /// 每次可读事件最多 accept 的连接数
+        void set_max_accepts_per_wakeup(int n)
+        {
+            max_accepts_per_wakeup_ = n;
+        }
+
+        /// 连接数上限，0 表示不限制
+        void set_max_conns(size_t n)
+        {
+            max_conns_ = n;
+        }
+
+        /// 每个源 IP 每秒最多接受 rate 个新连接，允许 burst 个突发，rate <= 0 表示不限制
+        void set_per_ip_accept_rate(int rate, int burst)
+        {
+            ip_limiter_.set_rate(rate, burst);
+        }
+
+        /// 已建立但还没收到过数据（客户端还没发登录包）的连接数上限，0 表示不限制
+        void set_max_pending_handshakes(size_t n)
+        {
+            max_pending_handshakes_ = n;
+        }
+
+        /// 新连接分配到哪个 IO loop，见 EventLoopThreadPool::SelectPolicy。
+        /// kReusePortPerLoop 模式下由内核分配，不使用这个策略
+        void set_loop_select_policy(EventLoopThreadPool::SelectPolicy policy)
+        {
+            loop_select_policy_ = policy;
+        }
+
+        /// 新连接使用 epoll 边缘触发模式，见 TcpConnection::set_edge_triggered()。
+        /// 监听 socket 始终是水平触发
+        /// Not thread safe, 在 start() 之前调用
+        void set_edge_triggered(bool on)
+        {
+            edge_triggered_ = on;
+        }
+
+        /// 新连接打开输出合并，见 TcpConnection::set_output_coalescing()
+        /// Not thread safe, 在 start() 之前调用
+        void set_output_coalescing(bool on)
+        {
+            output_coalescing_ = on;
+        }
+
+        /// 新连接的读端背压，见 TcpConnection::set_read_backpressure()，high_mark 为 0 表示不启用
+        /// Not thread safe, 在 start() 之前调用
+        void set_read_backpressure(size_t high_mark, size_t low_mark)
+        {
+            read_pause_high_ = high_mark;
+            read_pause_low_ = low_mark;
+        }
+
+        /// 所有连接输出队列的内存上限，超出时按积压时间从早到晚关闭慢消费者，见 OutputBudget。
+        /// 0 表示不限制
+        /// Not thread safe, 在 start() 之前调用
+        void set_output_budget(size_t bytes)
+        {
+            output_budget_ = bytes > 0 ? std::make_shared<OutputBudget>(bytes) : nullptr;
+        }
+
+        const std::shared_ptr<OutputBudget>& output_budget() const { return output_budget_; }
+
+        /// base loop 和所有 IO loop 一次迭代超过 threshold_ms 时报告卡住的回调和调用栈，
+        /// 见 LoopWatchdog。0 表示不启用
+        /// Not thread safe, 在 start() 之前调用
+        void set_stall_threshold(int64_t threshold_ms)
+        {
+            stall_threshold_ms_ = threshold_ms;
+        }
+
+        /// IO 线程绑核，见 EventLoopThreadPool::set_thread_cpus()
+        /// Not thread safe, 在 start() 之前调用
+        void set_io_cpus(const std::vector<int>& cpus)
+        {
+            io_cpus_ = cpus;
+        }
+
+        size_t conn_count() const { return conn_count_; }
+        size_t pending_handshakes() const { return pending_handshakes_; }
+
         void remove_conn(const TcpConnectionPtr& conn);
 
+        /// 按 TcpConnection::id() 查找连接，连接已经移除返回空。Thread safe
+        TcpConnectionPtr find_conn(uint64_t id);
+
     private:
         /// Not thread safe, but in loop
         void new_conn(int sockfd, const InetAddress& peerAddr);
-        /// Thread safe.
-
-        /// Not thread safe, but in loop
+        /// kReusePortPerLoop 模式下由 ioLoop 自己的 Acceptor 调用，in ioLoop
+        void new_conn_in_io_loop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+        void establish_conn(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+        /// Thread safe, 在各个 Acceptor 所在的 loop 中调用
+        bool admit_conn(const InetAddress& peerAddr);
+        void handshake_done(const TcpConnectionPtr& conn);
+        void setup_acceptor(Acceptor* acceptor, EventLoop* ioLoop);
+
+        /// Thread safe, in conn's loop
         void remove_conn_in_loop(const TcpConnectionPtr& conn);
 
-        typedef std::map<std::string, TcpConnectionPtr> ConnectionMap;
+        void start_per_loop_acceptors();
+        void stop_per_loop_acceptors();
 
     private:
         EventLoop* loop_;
+        const InetAddress                               listen_addr_;
+        const Option                                    option_;
         const std::string                                    host_port_;
         const std::string                                    name_;
-        std::unique_ptr<Acceptor>                       acceptor_;
+        std::unique_ptr<Acceptor>                       acceptor_;          // kReusePortPerLoop 时为空
+        std::vector<std::unique_ptr<Acceptor>>          loop_acceptors_;    // kReusePortPerLoop 时每个 IO loop 一个
         std::unique_ptr<EventLoopThreadPool>            event_loop_threadpool_;
         ConnectionCallback                              conn_callback_;
         MessageCallback                                 msg_callback_;
         WriteCompleteCallback                           write_complete_callback_;
         ThreadInitCallback                              thread_init_callback_;
         std::atomic<int>                                started_;
-        int                                             next_conn_id_;
-        ConnectionMap                                   conn_map_;
+        int64_t                                         conn_idle_timeout_ms_;
+        EventLoopThreadPool::SelectPolicy               loop_select_policy_;
+        std::vector<int>                                io_cpus_;
+        bool                                            edge_triggered_;
+        bool                                            output_coalescing_;
+        size_t                                          read_pause_high_;
+        size_t                                          read_pause_low_;
+        std::shared_ptr<OutputBudget>                   output_budget_;     // 连接也持有，服务器先析构不影响
+        int64_t                                         stall_threshold_ms_;
+        std::unique_ptr<LoopWatchdog>                   watchdog_;
+        int                                             max_accepts_per_wakeup_;
+        size_t                                          max_conns_;
+        size_t                                          max_pending_handshakes_;
+        std::atomic<size_t>                             conn_count_;
+        std::atomic<size_t>                             pending_handshakes_;
+        IpRateLimiter                                   ip_limiter_;
+        //连接可能在任意 IO loop 中建立和移除，conn_table_ 由 conn_mutex_ 保护
+        std::mutex                                      conn_mutex_;
+        ConnectionTable                                 conn_table_;
     };
 
 }
\ No newline at end of file
@@ -3,8 +3,25 @@
 #include "common/zlibutil.h"
 #include "msg.h"
 #include "whisp_log.h"
+#include <chrono>
+#include <map>
 
-TcpSession::TcpSession(const std::weak_ptr<TcpConnection>& tmpconn): tmp_conn_(tmpconn)
+//send(p, length) 的包体是 BinaryStreamWriter 写的，长度和校验和后面就是 cmd，读不出来的按 0 统计
+static int32_t peek_cmd(const char* p, int32_t length)
+{
+    w_network::BinaryStreamReader reader(p, length);
+    int32_t cmd = 0;
+    if (!reader.ReadInt32(cmd))
+        return 0;
+    return cmd;
+}
+
+static int64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+TcpSession::TcpSession(const std::weak_ptr<TcpConnection>& tmpconn): tmp_conn_(tmpconn), wire_version_(1), dict_id_(0)
 {
 
 }
@@ -16,19 +33,12 @@ TcpSession::~TcpSession()
 
 void TcpSession::send(int32_t cmd, int32_t seq, const std::string& data)
 {
-    send(cmd, data.c_str(), data.length());
+    send(cmd, seq, data.c_str(), data.length());
 }
 
 void TcpSession::send(int32_t cmd, int32_t seq, const char* data, int32_t data_len)
 {
-    std::string outbuf;
-    w_network::BinaryStreamWriter write_stream(&outbuf);
-    write_stream.WriteInt32(cmd);
-    write_stream.WriteInt32(seq);
-    write_stream.WriteCString(data, data_len);
-    write_stream.Flush();
-
-    send_pkg(outbuf.c_str(), outbuf.length());
+    send_frame(_make_adaptive_frame(cmd, seq, data, data_len));
 }
 
 void TcpSession::send(const std::string& outbuf)
@@ -42,31 +52,248 @@ void TcpSession::send(const char* p, int32_t length)
     send_pkg(p, length);
 }
 
+void TcpSession::send_batch(const std::vector<ChatMessageView>& msgs)
+{
+    if (msgs.empty())
+        return;
 
-void TcpSession::send_pkg(const char* p, int32_t length)
-{   
-    std::string srcbuf(p, length);
-    std::string destbuf;
-    if (!ZlibUtil::compressBuf(srcbuf, destbuf))
+    if (wire_version_ == 2)
     {
-        WHISP_LOG_ERROR("compress buf error");
+        //整个批量帧一起压缩，按第一条消息的类型统计
+        CompressPolicy::Decision decision = compress_policy_.choose(msgs[0].cmd);
+        FrameCompressInfo info;
+        ChainBuffer::Payload frame = make_batch_frame_v2(msgs, CompressPolicy::zlib_level(decision.level), &info);
+        _record_compress(msgs[0].cmd, decision, info);
+        send_frame(frame);
         return;
     }
- 
-    std::string strPackageData;
+
+    std::shared_ptr<std::string> package = std::make_shared<std::string>();
+    for (const ChatMessageView& msg : msgs)
+    {
+        ChainBuffer::Payload frame = _make_adaptive_frame(msg.cmd, msg.seq, msg.data, static_cast<int32_t>(msg.data_len));
+        if (!frame)
+            return;
+        package->append(*frame);
+    }
+    send_frame(package);
+}
+
+void TcpSession::send_to_all(const std::vector<std::shared_ptr<TcpSession>>& sessions, int32_t cmd, int32_t seq, const std::string& data)
+{
+    //按协议版本和字典分组，每组只生成一个帧。v1 连接按字典 id 分，v2 连接都放在 v2_conns
+    std::map<uint32_t, std::vector<std::shared_ptr<TcpConnection>>> v1_conns;
+    std::vector<std::shared_ptr<TcpConnection>> v2_conns;
+    for (const auto& session : sessions)
+    {
+        if (!session)
+            continue;
+
+        std::shared_ptr<TcpConnection> conn = session->tmp_conn_.lock();
+        if (!conn)
+            continue;
+
+        if (session->wire_version_ == 2)
+            v2_conns.push_back(std::move(conn));
+        else
+            v1_conns[session->dict_id_].push_back(std::move(conn));
+    }
+
+    for (const auto& group : v1_conns)
+    {
+        ChainBuffer::Payload frame = make_frame(cmd, seq, data.c_str(), data.length(), group.first);
+        if (frame)
+            TcpConnection::send_to_all(group.second, frame);
+    }
+    if (!v2_conns.empty())
+    {
+        ChainBuffer::Payload frame = make_frame_v2(cmd, seq, data.c_str(), data.length());
+        if (frame)
+            TcpConnection::send_to_all(v2_conns, frame);
+    }
+}
+
+ChainBuffer::Payload TcpSession::_make_adaptive_frame(int32_t cmd, int32_t seq, const char* data, int32_t data_len)
+{
+    CompressPolicy::Decision decision = compress_policy_.choose(cmd);
+    int level = CompressPolicy::zlib_level(decision.level);
+    FrameCompressInfo info;
+    ChainBuffer::Payload frame;
+    if (wire_version_ == 2)
+        frame = make_frame_v2(cmd, seq, data, data_len, level, &info);
+    else
+        frame = make_frame(cmd, seq, data, data_len, dict_id_, level, &info);
+    _record_compress(cmd, decision, info);
+    return frame;
+}
+
+ChainBuffer::Payload TcpSession::_make_adaptive_frame(const char* p, int32_t length)
+{
+    int32_t cmd = peek_cmd(p, length);
+    CompressPolicy::Decision decision = compress_policy_.choose(cmd);
+    FrameCompressInfo info;
+    ChainBuffer::Payload frame = make_frame(p, length, dict_id_, CompressPolicy::zlib_level(decision.level), &info);
+    _record_compress(cmd, decision, info);
+    return frame;
+}
+
+void TcpSession::_record_compress(int32_t cmd, const CompressPolicy::Decision& decision, const FrameCompressInfo& info)
+{
+    //选了压缩但包太小没压，不算这个级别的样本
+    if (!info.attempted && decision.level != CompressPolicy::kStore)
+    {
+        compress_policy_.record_small();
+        return;
+    }
+
+    compress_policy_.record(cmd, decision, info.origin_len, info.compressed_len, info.compress_ns);
+}
+
+ChainBuffer::Payload TcpSession::make_frame(int32_t cmd, int32_t seq, const char* data, int32_t data_len, uint32_t dict_id/* = 0*/,
+    int level/* = -1*/, FrameCompressInfo* info/* = nullptr*/)
+{
+    std::string outbuf;
+    w_network::BinaryStreamWriter write_stream(&outbuf);
+    write_stream.WriteInt32(cmd);
+    write_stream.WriteInt32(seq);
+    write_stream.WriteCString(data, data_len);
+    write_stream.Flush();
+
+    return make_frame(outbuf.c_str(), outbuf.length(), dict_id, level, info);
+}
+
+ChainBuffer::Payload TcpSession::make_frame(const char* p, int32_t length, uint32_t dict_id/* = 0*/,
+    int level/* = -1*/, FrameCompressInfo* info/* = nullptr*/)
+{
     chat_msg_header header;
-    header.compressflag = 1;
-    header.compresssize = destbuf.length();
+    memset(&header, 0, sizeof(header));
     header.originsize = length;
+
+    //包体直接压缩到包头后面，小包和 level 为 0 时不压缩
+    std::shared_ptr<std::string> package = std::make_shared<std::string>();
+    package->append((const char*)&header, sizeof(header));
+    if (level == 0 || static_cast<size_t>(length) < ZlibUtil::getMinCompressSize())
+    {
+        header.compressflag = PACKAGE_UNCOMPRESSED;
+        header.compresssize = length;
+        package->append(p, length);
+    }
+    else
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!ZlibUtil::compressBuf(p, length, *package, dict_id, level))
+        {
+            WHISP_LOG_ERROR("compress buf error, dictid = %u, level = %d", dict_id, level);
+            return ChainBuffer::Payload();
+        }
+        if (info != nullptr)
+        {
+            info->attempted = true;
+            info->compress_ns = elapsed_ns(start);
+        }
+        header.compressflag = PACKAGE_COMPRESSED;
+        header.dictid = dict_id;
+        header.compresssize = package->length() - sizeof(header);
+    }
+    if (info != nullptr)
+    {
+        info->origin_len = length;
+        info->compressed_len = header.compresssize;
+    }
     // if (Singleton<ChatServer>::Instance().isLogPackageBinaryEnabled())
     // {
     //     LOGI("Send data, header length: %d, body length: %d", sizeof(header), destbuf.length());
     // }
-    
+    memcpy(&(*package)[0], &header, sizeof(header));
+
+    return package;
+}
+
+ChainBuffer::Payload TcpSession::make_frame_v2(int32_t cmd, int32_t seq, const char* data, int32_t data_len,
+    int level/* = -1*/, FrameCompressInfo* info/* = nullptr*/)
+{
+    //cmd、seq 用 7bit 编码，data 的长度由包体长度推出来，不再单独写
+    std::string payload;
+    payload.reserve(10 + data_len);
+    write7BitEncoded(static_cast<uint32_t>(cmd), payload);
+    write7BitEncoded(static_cast<uint32_t>(seq), payload);
+    payload.append(data, data_len);
+
+    return _make_v2_frame(CHAT_FRAME_V2_MAGIC, payload, level, info);
+}
+
+ChainBuffer::Payload TcpSession::make_batch_frame_v2(const std::vector<ChatMessageView>& msgs,
+    int level/* = -1*/, FrameCompressInfo* info/* = nullptr*/)
+{
+    std::string payload;
+    std::string head;
+    for (const ChatMessageView& msg : msgs)
+    {
+        head.clear();
+        write7BitEncoded(static_cast<uint32_t>(msg.cmd), head);
+        write7BitEncoded(static_cast<uint32_t>(msg.seq), head);
+        write7BitEncoded(static_cast<uint32_t>(head.length() + msg.data_len), payload);
+        payload.append(head);
+        payload.append(msg.data, msg.data_len);
+    }
+
+    return _make_v2_frame(CHAT_FRAME_V2_MAGIC | CHAT_FRAME_V2_BATCH, payload, level, info);
+}
+
+ChainBuffer::Payload TcpSession::_make_v2_frame(unsigned char flag, const std::string& payload, int level, FrameCompressInfo* info)
+{
+    if (payload.length() > static_cast<size_t>(BINARY_PACKAGE_MAXLEN_2))
+    {
+        WHISP_LOG_ERROR("v2 payload too large: %zu", payload.length());
+        return ChainBuffer::Payload();
+    }
+
+    if (info != nullptr)
+    {
+        info->origin_len = payload.length();
+        info->compressed_len = payload.length();
+    }
+
+    std::string compressed;
+    if (level != 0 && !payload.empty() && payload.length() >= ZlibUtil::getMinCompressSize())
+    {
+        //压缩前大小也算在包体里
+        write7BitEncoded(static_cast<uint32_t>(payload.length()), compressed);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool ok = ZlibUtil::compressBuf(payload.c_str(), payload.length(), compressed, 0, level);
+        //压缩后变大也报告实际大小，策略才知道这类数据不值得压缩
+        if (ok && info != nullptr)
+        {
+            info->attempted = true;
+            info->compressed_len = compressed.length();
+            info->compress_ns = elapsed_ns(start);
+        }
+        if (!ok || compressed.length() >= payload.length())
+            compressed.clear();
+    }
+
+    const std::string& body = compressed.empty() ? payload : compressed;
+    if (!compressed.empty())
+        flag |= CHAT_FRAME_V2_COMPRESSED;
+
+    std::shared_ptr<std::string> package = std::make_shared<std::string>();
+    package->reserve(1 + 5 + body.length());
+    package->append(1, static_cast<char>(flag));
+    write7BitEncoded(static_cast<uint32_t>(body.length()), *package);
+    package->append(body);
+
+    return package;
+}
 
-    strPackageData.append((const char*)&header, sizeof(header));
-    strPackageData.append(destbuf);
+void TcpSession::send_pkg(const char* p, int32_t length)
+{
+    send_frame(_make_adaptive_frame(p, length));
+}
 
+void TcpSession::send_frame(const ChainBuffer::Payload& package)
+{
+    if (!package)
+        return;
 
     if (tmp_conn_.expired())
     {
@@ -80,10 +307,10 @@ void TcpSession::send_pkg(const char* p, int32_t length)
     {
         // if (Singleton<ChatServer>::Instance().isLogPackageBinaryEnabled())
         // {
-        //     size_t length = strPackageData.length();
+        //     size_t length = package->length();
         //     LOGI("Send data, package length: %d", length);
         // }
         
-        conn->send(strPackageData);
+        conn->send(package);
     }
-}
\ No newline at end of file
+}
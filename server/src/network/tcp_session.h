@@ -2,10 +2,25 @@
 #pragma once
 
 #include "tcp_connect.h"
+#include "chat_frame_codec.h"
+#include "compress_policy.h"
+#include <atomic>
 #include <memory>
+#include <vector>
 
 using namespace w_network;
 
+/// make_frame 系列的压缩结果，给 CompressPolicy 统计用
+struct FrameCompressInfo
+{
+    bool        attempted;          // 是否真的调用了压缩，store 和小包为 false
+    size_t      origin_len;         // 压缩前的包体大小
+    size_t      compressed_len;     // 压缩后的大小（压缩后更大、最终没有采用也是压缩后的大小），没有压缩时等于 origin_len
+    int64_t     compress_ns;        // 压缩花的时间
+
+    FrameCompressInfo() : attempted(false), origin_len(0), compressed_len(0), compress_ns(0) {}
+};
+
 class TcpSession
 {
 public:
@@ -28,9 +43,60 @@ public:
     void send(const std::string& p);
     void send(const char* p, int32_t length);
 
+    /// 多条消息合成一个帧发送：v2 连接发一个批量帧，v1 连接发连续的多个 v1 帧（仍然只投递一次）
+    void send_batch(const std::vector<ChatMessageView>& msgs);
+
+    /// 对端使用的协议版本，1 或 2，见 msg.h 中的紧凑协议 v2。
+    /// 收到客户端的第一个 v2 帧（ChatFrame::version == 2）后设置为 2，之后 send(cmd, seq, ...) 都发 v2 帧。
+    /// Thread safe
+    void set_wire_version(int version) { wire_version_ = version; }
+    int wire_version() const { return wire_version_; }
+
+    /// 发给对端的 v1 帧使用的预置字典，0 表示不用字典，见 msg.h 中的预置字典压缩。
+    /// 客户端发来的帧带着服务器加载过的字典（ChatFrame::dictid，ZlibUtil::hasDictionary()）时设置。
+    /// Thread safe
+    void set_dict_id(uint32_t dict_id) { dict_id_ = dict_id; }
+    uint32_t dict_id() const { return dict_id_; }
+
+    /// 对端的 online_type（见 msg.h），决定这个连接的自适应压缩策略按哪种链路算收益。
+    /// send()、send_batch() 按 CompressPolicy 为每种消息选择压缩级别或者不压缩，send_to_all() 的帧多个连接共享，仍用默认级别。
+    /// Thread safe
+    void set_online_type(int online_type) { compress_policy_.set_online_type(online_type); }
+    /// 压缩策略的统计，compress_policy().to_string() 可以直接打日志
+    const CompressPolicy& compress_policy() const { return compress_policy_; }
+
+    /// 群发（如 msg_type_multichat）：每种协议版本只序列化、压缩一次，生成的帧被使用同一版本的成员连接共享
+    static void send_to_all(const std::vector<std::shared_ptr<TcpSession>>& sessions, int32_t cmd, int32_t seq, const std::string& data);
+
+    /// 序列化 cmd、seq 和 data 并压缩成一个完整的帧（chat_msg_header + 包体），失败返回空指针
+    static ChainBuffer::Payload make_frame(int32_t cmd, int32_t seq, const char* data, int32_t data_len, uint32_t dict_id = 0,
+        int level = -1, FrameCompressInfo* info = nullptr);
+    /// 把已经序列化好的包体压缩成一个完整的帧，小于 ZlibUtil::getMinCompressSize() 的包体不压缩，
+    /// dict_id 不为 0 时用这个预置字典压缩并写到 chat_msg_header::dictid。
+    /// level 是 zlib 压缩级别，0 表示不压缩，-1 是默认级别；info 不为空时填上压缩结果。失败返回空指针
+    static ChainBuffer::Payload make_frame(const char* p, int32_t length, uint32_t dict_id = 0,
+        int level = -1, FrameCompressInfo* info = nullptr);
+    /// 单条消息的 v2 帧，包体小于 ZlibUtil::getMinCompressSize() 或压缩后不比原来小就不压缩，失败返回空指针
+    static ChainBuffer::Payload make_frame_v2(int32_t cmd, int32_t seq, const char* data, int32_t data_len,
+        int level = -1, FrameCompressInfo* info = nullptr);
+    /// 多条消息的 v2 批量帧，整个包体一起压缩，失败返回空指针
+    static ChainBuffer::Payload make_batch_frame_v2(const std::vector<ChatMessageView>& msgs,
+        int level = -1, FrameCompressInfo* info = nullptr);
+
 private:
     void send_pkg(const char* p, int32_t length);
+    void send_frame(const ChainBuffer::Payload& package);
+
+    /// 按 compress_policy_ 为类型为 cmd 的消息选压缩级别生成帧，并把结果报告给 compress_policy_
+    ChainBuffer::Payload _make_adaptive_frame(int32_t cmd, int32_t seq, const char* data, int32_t data_len);
+    ChainBuffer::Payload _make_adaptive_frame(const char* p, int32_t length);
+    void _record_compress(int32_t cmd, const CompressPolicy::Decision& decision, const FrameCompressInfo& info);
+
+    static ChainBuffer::Payload _make_v2_frame(unsigned char flag, const std::string& payload, int level, FrameCompressInfo* info);
 
 protected:
     std::weak_ptr<TcpConnection>    tmp_conn_;
+    std::atomic<int>                wire_version_;
+    std::atomic<uint32_t>           dict_id_;
+    CompressPolicy                  compress_policy_;
 };
@@ -1,4 +1,5 @@
 #include "timer.h"
+#include "timer_heap.h"
 #include "common/whisp_timestamp.h"
 
 using namespace w_network;
@@ -10,24 +11,44 @@ Timer::Timer(const TimerCallback& cb, Timestamp when, int64_t interval, int64_t
     interval_(interval),
     repeat_count_(repeat_count),
     sequence_(++created_num_),
-    canceled_(false)
+    canceled_(false),
+    heap_index_(TimerHeap::not_in_heap)
 { }
 
-Timer::Timer(TimerCallback&& cb, Timestamp when, int64_t interval)
+Timer::Timer(TimerCallback&& cb, Timestamp when, int64_t interval, int64_t repeat_count/* = -1*/)
     : callback_(std::move(cb)),
     expiration_(when),
     interval_(interval),
-    repeat_count_(-1),
+    repeat_count_(repeat_count),
     sequence_(++created_num_),
-    canceled_(false)
+    canceled_(false),
+    heap_index_(TimerHeap::not_in_heap)
 { }
 
-void Timer::run()
+void Timer::assign(TimerCallback&& cb, Timestamp when, int64_t interval, int64_t repeat_count)
+{
+    callback_ = std::move(cb);
+    expiration_ = when;
+    interval_ = interval;
+    repeat_count_ = repeat_count;
+    sequence_ = ++created_num_;
+    canceled_ = false;
+    heap_index_ = TimerHeap::not_in_heap;
+}
+
+void Timer::release()
 {
-    if (canceled_)
-        return;
+    callback_ = nullptr;
+    //旧的 TimerId 通过 sequence 对不上来识别
+    sequence_ = 0;
+    heap_index_ = TimerHeap::not_in_heap;
+}
 
-    callback_();
+void Timer::run()
+{
+    //被暂停的定时器跳过本次回调，但仍然要消耗掉这一次触发，否则会被反复取出
+    if (!canceled_)
+        callback_();
 
     if (repeat_count_ != -1)
     {
@@ -39,4 +60,4 @@ void Timer::run()
     }
 
     expiration_ += interval_;
-}
\ No newline at end of file
+}
@@ -9,31 +9,41 @@ namespace w_network {
     class Timer {
      public:
       Timer(const TimerCallback& cb, Timestamp when, int64_t interval, int64_t repeat_count = -1);
-      Timer(TimerCallback&& cb, Timestamp when, int64_t interval);
-    
+      Timer(TimerCallback&& cb, Timestamp when, int64_t interval, int64_t repeat_count = -1);
+
+      // 从 TimerQueue 的空闲链表中取出后重新初始化，会分配新的 sequence
+      void assign(TimerCallback&& cb, Timestamp when, int64_t interval, int64_t repeat_count);
+      // 放回空闲链表前调用，释放回调里捕获的对象
+      void release();
+
       void run();
-    
+
       bool is_canceled() const { return canceled_; }
       void cancel(bool off) { canceled_ = off; }
-    
+
       Timestamp expiration() const { return expiration_; }
       int64_t get_repeat_count() const { return repeat_count_; }
       int64_t sequence() const { return sequence_; }
-    
+
+      // 在 TimerHeap 中的下标，不在堆中时为负数，见 TimerHeap
+      int heap_index() const { return heap_index_; }
+      void set_heap_index(int idx) { heap_index_ = idx; }
+
       static int64_t num_created() { return created_num_; }
-    
+
      private:
       Timer(const Timer& rhs) = delete;
       Timer& operator=(const Timer& rhs) = delete;
-    
-      const TimerCallback callback_;
+
+      TimerCallback callback_;
       Timestamp expiration_;
-      const int64_t interval_;
+      int64_t interval_;
       int64_t repeat_count_;  // -1 means infinite repeat
-      const int64_t sequence_;
+      int64_t sequence_;
       bool canceled_;
-    
+      int heap_index_;
+
       static std::atomic<int64_t> created_num_;
     };
-    
-}  // namespace net
\ No newline at end of file
+
+}  // namespace net
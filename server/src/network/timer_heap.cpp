@@ -0,0 +1,100 @@
+#include "timer_heap.h"
+#include "timer.h"
+
+using namespace w_network;
+
+const int TimerHeap::not_in_heap;
+const int TimerHeap::running;
+const int TimerHeap::removed;
+const size_t TimerHeap::arity_;
+
+bool TimerHeap::_less(const Timer* lhs, const Timer* rhs)
+{
+    if (lhs->expiration() != rhs->expiration())
+        return lhs->expiration() < rhs->expiration();
+
+    //到期时间相同时按创建顺序执行
+    return lhs->sequence() < rhs->sequence();
+}
+
+void TimerHeap::_place(size_t idx, Timer* timer)
+{
+    timers_[idx] = timer;
+    timer->set_heap_index(static_cast<int>(idx));
+}
+
+void TimerHeap::push(Timer* timer)
+{
+    timers_.push_back(timer);
+    timer->set_heap_index(static_cast<int>(timers_.size() - 1));
+    _sift_up(timers_.size() - 1);
+}
+
+Timer* TimerHeap::pop()
+{
+    Timer* timer = timers_.front();
+    erase(timer);
+    return timer;
+}
+
+void TimerHeap::erase(Timer* timer)
+{
+    int idx = timer->heap_index();
+    if (idx < 0 || static_cast<size_t>(idx) >= timers_.size() || timers_[idx] != timer)
+        return;
+
+    Timer* last = timers_.back();
+    timers_.pop_back();
+    timer->set_heap_index(not_in_heap);
+    if (last == timer)
+        return;
+
+    //用最后一个元素填补空位，再视情况上浮或下沉
+    _place(idx, last);
+    if (idx > 0 && _less(last, timers_[(idx - 1) / arity_]))
+        _sift_up(idx);
+    else
+        _sift_down(idx);
+}
+
+void TimerHeap::_sift_up(size_t idx)
+{
+    Timer* timer = timers_[idx];
+    while (idx > 0)
+    {
+        size_t parent = (idx - 1) / arity_;
+        if (!_less(timer, timers_[parent]))
+            break;
+
+        _place(idx, timers_[parent]);
+        idx = parent;
+    }
+    _place(idx, timer);
+}
+
+void TimerHeap::_sift_down(size_t idx)
+{
+    Timer* timer = timers_[idx];
+    const size_t n = timers_.size();
+    while (true)
+    {
+        size_t first_child = idx * arity_ + 1;
+        if (first_child >= n)
+            break;
+
+        size_t min_child = first_child;
+        size_t last_child = first_child + arity_ < n ? first_child + arity_ : n;
+        for (size_t child = first_child + 1; child < last_child; ++child)
+        {
+            if (_less(timers_[child], timers_[min_child]))
+                min_child = child;
+        }
+
+        if (!_less(timers_[min_child], timer))
+            break;
+
+        _place(idx, timers_[min_child]);
+        idx = min_child;
+    }
+    _place(idx, timer);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+namespace w_network
+{
+    class Timer;
+
+    /// 按 (到期时间, sequence) 排序的 4 叉小根堆
+    ///
+    /// 每个 Timer 记录自己在堆中的下标，所以删除任意一个定时器是 O(log n)，
+    /// 不需要再遍历查找。4 叉比 2 叉层数少一半，下沉时比较的 4 个孩子在同一段连续内存里。
+    class TimerHeap
+    {
+    public:
+        //Timer::heap_index() 的特殊取值
+        static const int not_in_heap = -1;     // 空闲或尚未入堆
+        static const int running = -2;         // 已到期，正在执行回调
+        static const int removed = -3;         // 执行回调期间被删除
+
+        TimerHeap() = default;
+
+        bool empty() const { return timers_.empty(); }
+        size_t size() const { return timers_.size(); }
+        Timer* top() const { return timers_.front(); }
+
+        void push(Timer* timer);
+        Timer* pop();
+        void erase(Timer* timer);
+
+        void reserve(size_t n) { timers_.reserve(n); }
+
+        // 只用于析构时释放
+        const std::vector<Timer*>& timers() const { return timers_; }
+
+    private:
+        TimerHeap(const TimerHeap& rhs) = delete;
+        TimerHeap& operator=(const TimerHeap& rhs) = delete;
+
+        static const size_t arity_ = 4;
+
+        static bool _less(const Timer* lhs, const Timer* rhs);
+        void _sift_up(size_t idx);
+        void _sift_down(size_t idx);
+        void _place(size_t idx, Timer* timer);
+
+    private:
+        std::vector<Timer*> timers_;
+    };
+}
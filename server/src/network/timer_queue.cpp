@@ -1,116 +1,145 @@
 #include "timer.h"
 #include "timer_id.h"
 #include "timer_queue.h"
+#include "channel.h"
 #include "event_loop.h"
 #include "log/whisp_log.h"
 #include <functional>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/timerfd.h>
+#endif
 
 namespace w_network
 {
-    //namespace detail
-    //{
-
-    //    int createTimerfd()
-    //    {
-    //        int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
-    //        if (timerfd < 0)
-    //        {
-    //            LOG_SYSFATAL << "Failed in timerfd_create";
-    //        }
-    //        return timerfd;
-    //    }
-
-    //    struct timespec howMuchTimeFromNow(Timestamp when)
-    //    {
-    //        int64_t microseconds = when.microSecondsSinceEpoch()
-    //            - Timestamp::now().microSecondsSinceEpoch();
-    //        if (microseconds < 100)
-    //        {
-    //            microseconds = 100;
-    //        }
-    //        struct timespec ts;
-    //        ts.tv_sec = static_cast<time_t>(
-    //            microseconds / Timestamp::kMicroSecondsPerSecond);
-    //        ts.tv_nsec = static_cast<long>(
-    //            (microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
-    //        return ts;
-    //    }
+    namespace detail
+    {
+#ifndef WIN32
+        int create_timerfd()
+        {
+            int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (timerfd < 0)
+            {
+                WHISP_LOG_FALTAL("Failed in timerfd_create");
+            }
+            return timerfd;
+        }
 
-    //    void readTimerfd(int timerfd, Timestamp now)
-    //    {
-    //        uint64_t howmany;
-    //        ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
-    //        LOG_TRACE << "TimerQueue::handleRead() " << howmany << " at " << now.toString();
-    //        if (n != sizeof howmany)
-    //        {
-    //            LOG_ERROR << "TimerQueue::handleRead() reads " << n << " bytes instead of 8";
-    //        }
-    //    }
+        struct timespec how_much_time_from_now(Timestamp when)
+        {
+            int64_t microseconds = when.microSecondsSinceEpoch()
+                - Timestamp::now().microSecondsSinceEpoch();
+            //it_value 全为 0 表示解除定时，所以至少要留 100 微秒
+            if (microseconds < 100)
+            {
+                microseconds = 100;
+            }
+            struct timespec ts;
+            ts.tv_sec = static_cast<time_t>(
+                microseconds / Timestamp::kMicroSecondsPerSecond);
+            ts.tv_nsec = static_cast<long>(
+                (microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+            return ts;
+        }
 
-    //    void resetTimerfd(int timerfd, Timestamp expiration)
-    //    {
-    //        // wake up loop by timerfd_settime()
-    //        struct itimerspec newValue;
-    //        struct itimerspec oldValue;
-    //        bzero(&newValue, sizeof newValue);
-    //        bzero(&oldValue, sizeof oldValue);
-    //        newValue.it_value = howMuchTimeFromNow(expiration);
-    //        int ret = ::timerfd_settime(timerfd, 0, &newValue, &oldValue);
-    //        if (ret)
-    //        {
-    //            LOG_SYSERR << "timerfd_settime()";
-    //        }
-    //    }
+        void read_timerfd(int timerfd, Timestamp now)
+        {
+            uint64_t howmany;
+            ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+            if (n != sizeof howmany)
+            {
+                WHISP_LOG_ERROR("TimerQueue::do_timer() reads %d bytes instead of 8", (int)n);
+                return;
+            }
+            WHISP_LOG_TRACE("TimerQueue::do_timer() %llu expirations at %s", (unsigned long long)howmany, now.toString().c_str());
+        }
 
-    //}
+        void reset_timerfd(int timerfd, Timestamp expiration)
+        {
+            // wake up loop by timerfd_settime()
+            struct itimerspec new_value;
+            struct itimerspec old_value;
+            memset(&new_value, 0, sizeof new_value);
+            memset(&old_value, 0, sizeof old_value);
+            new_value.it_value = how_much_time_from_now(expiration);
+            int ret = ::timerfd_settime(timerfd, 0, &new_value, &old_value);
+            if (ret)
+            {
+                WHISP_LOG_SYSERROR("timerfd_settime()");
+            }
+        }
+#endif
+    }
 }
 
 using namespace w_network;
-//using namespace net::detail;
+using namespace w_network::detail;
 
 TimerQueue::TimerQueue(EventLoop* loop)
-    : loop_(loop),
-    /*timerfd_(createTimerfd()),
-    timerfdChannel_(loop, timerfd_),*/
-    timers_()
-    //callingExpiredTimers_(false)
+    : loop_(loop)
+#ifndef WIN32
+    , timerfd_(create_timerfd()),
+    timerfd_channel_(new Channel(loop, timerfd_))
+#endif
 {
-    //timerfdChannel_.setReadCallback(
-    //    std::bind(&TimerQueue::handleRead, this));
+#ifndef WIN32
+    timerfd_channel_->set_read_callback(std::bind(&TimerQueue::do_timer, this));
     // we are always reading the timerfd, we disarm it with timerfd_settime.
     //将timerfd挂到epollfd上
-    //timerfdChannel_.enableReading();
+    timerfd_channel_->enable_reading();
+#endif
 }
 
 TimerQueue::~TimerQueue()
 {
-    //timerfdChannel_.disableAll();
-    //timerfdChannel_.remove();
-    //::close(timerfd_);
-    // do not remove channel, since we're in EventLoop::dtor();
-    for (TimerList::iterator it = timers_.begin(); it != timers_.end(); ++it)
+#ifndef WIN32
+    timerfd_channel_->disable_all();
+    timerfd_channel_->remove();
+    ::close(timerfd_);
+#endif
+    for (Timer* timer : heap_.timers())
+    {
+        delete timer;
+    }
+    for (Timer* timer : free_timers_)
     {
-        delete it->second;
+        delete timer;
     }
 }
 
 TimerId TimerQueue::add_timer(const TimerCallback& cb, Timestamp when, int64_t interval, int64_t repeat_count)
 {
-    Timer* timer = new Timer(cb, when, interval);
-    loop_->run_in_loop(std::bind(&TimerQueue::add_timer_in_loop, this, timer));
-    return TimerId(timer, timer->sequence());
+    return add_timer(TimerCallback(cb), when, interval, repeat_count);
 }
 
 TimerId TimerQueue::add_timer(TimerCallback&& cb, Timestamp when, int64_t interval, int64_t repeat_count)
 {
+    if (loop_->is_in_loop_thread())
+    {
+        Timer* timer = _alloc_timer(std::move(cb), when, interval, repeat_count);
+        add_timer_in_loop(timer);
+        return TimerId(timer, timer->sequence());
+    }
+
+    //跨线程添加时空闲链表不能碰，直接new，回收时照样进入本loop的空闲链表
     Timer* timer = new Timer(std::move(cb), when, interval, repeat_count);
-    loop_->run_in_loop(std::bind(&TimerQueue::add_timer_in_loop, this, timer));
-    return TimerId(timer, timer->sequence());
+    //投递之后定时器可能马上到期被回收，sequence 必须在投递前取
+    TimerId timer_id(timer, timer->sequence());
+    loop_->queue_in_loop(std::bind(&TimerQueue::add_timer_in_loop, this, timer));
+    return timer_id;
 }
 
 void TimerQueue::remove_timer(TimerId timer_id)
 {
-    loop_->run_in_loop(std::bind(&TimerQueue::remove_timer_in_loop, this, timer_id));
+    if (loop_->is_in_loop_thread())
+    {
+        remove_timer_in_loop(timer_id);
+    }
+    else
+    {
+        loop_->queue_in_loop(std::bind(&TimerQueue::remove_timer_in_loop, this, timer_id));
+    }
 }
 
 void TimerQueue::cancel(TimerId timer_id, bool off)
@@ -123,180 +152,117 @@ void TimerQueue::do_timer()
     loop_->assert_in_loop_thread();
 
     Timestamp now(Timestamp::now());
+#ifndef WIN32
+    read_timerfd(timerfd_, now);
+#endif
+
+    //堆顶没到期就可以停了
+    while (!heap_.empty() && heap_.top()->expiration() <= now)
+    {
+        Timer* timer = heap_.pop();
+        loop_->metrics().on_timer(now.microSecondsSinceEpoch() - timer->expiration().microSecondsSinceEpoch());
+        timer->set_heap_index(TimerHeap::running);
+        expired_.push_back(timer);
+    }
 
-    for (auto iter = timers_.begin(); iter != timers_.end(); )
+    for (Timer* timer : expired_)
     {
-        if (iter->second->expiration() <= now)
+        //前面的回调可能已经删掉了这个定时器
+        if (timer->heap_index() == TimerHeap::running)
         {
-            //LOGD("time: %lld", iter->second->expiration().microSecondsSinceEpoch());
-            iter->second->run();
-            if (iter->second->get_repeat_count() == 0)
-            {
-                iter = timers_.erase(iter);
-            }
-            else
-            {
-                ++iter;
-            }
+            loop_->activity().mark(LoopActivity::kTimer);
+            timer->run();
+        }
+    }
+
+    for (Timer* timer : expired_)
+    {
+        if (timer->heap_index() == TimerHeap::running && timer->get_repeat_count() != 0)
+        {
+            //Timer::run() 已经把到期时间推到了下一个周期
+            heap_.push(timer);
         }
         else
         {
-            break;
+            _free_timer(timer);
         }
     }
+    expired_.clear();
 
-
-    //readTimerfd(timerfd_, now);
-
-    //std::vector<Entry> expired = getExpired(now);
-
-    //callingExpiredTimers_ = true;
-    //cancelingTimers_.clear();
-    //// safe to callback outside critical section
-    //for (std::vector<Entry>::iterator it = expired.begin();
-    //    it != expired.end(); ++it)
-    //{
-    //    it->second->run();
-    //}
-    //callingExpiredTimers_ = false;
-
-    //reset(expired, now);
+#ifndef WIN32
+    if (!heap_.empty())
+    {
+        reset_timerfd(timerfd_, heap_.top()->expiration());
+    }
+#endif
 }
 
 void TimerQueue::add_timer_in_loop(Timer* timer)
 {
     loop_->assert_in_loop_thread();
-    /*bool earliestChanged = */insert(timer);
+    heap_.push(timer);
 
-    //if (earliestChanged)
-    //{
-    //    resetTimerfd(timerfd_, timer->expiration());
-    //}
+#ifndef WIN32
+    if (heap_.top() == timer)
+    {
+        reset_timerfd(timerfd_, timer->expiration());
+    }
+#endif
 }
 
 void TimerQueue::remove_timer_in_loop(TimerId timer_id)
 {
     loop_->assert_in_loop_thread();
-    //assert(timers_.size() == activeTimers_.size());
-    //ActiveTimer timer(timerId.timer_, timerId.sequence_);
-    //ActiveTimerSet::iterator it = activeTimers_.find(timer);
+    if (!_is_alive(timer_id))
+        return;
 
     Timer* timer = timer_id.timer_;
-    for (auto iter = timers_.begin(); iter != timers_.end(); ++iter)
+    int idx = timer->heap_index();
+    if (idx == TimerHeap::running)
     {
-        if (iter->second == timer)
-        {
-            timers_.erase(iter);
-            break;
-        }
+        //正在 do_timer() 里执行，由 do_timer() 回收
+        timer->set_heap_index(TimerHeap::removed);
+        return;
     }
+
+    if (idx < 0)
+        return;
+
+    //删掉的如果是堆顶，timerfd 不用重设：提前醒来时 do_timer() 取不到到期定时器，会按新的堆顶重设
+    heap_.erase(timer);
+    _free_timer(timer);
 }
 
-void TimerQueue::cancel_timer_in_loop(TimerId timerId, bool off)
+void TimerQueue::cancel_timer_in_loop(TimerId timer_id, bool off)
 {
     loop_->assert_in_loop_thread();
+    if (!_is_alive(timer_id))
+        return;
+
+    timer_id.timer_->cancel(off);
+}
 
-    Timer* timer = timerId.timer_;
-    for (auto iter = timers_.begin(); iter != timers_.end(); ++iter)
+Timer* TimerQueue::_alloc_timer(TimerCallback&& cb, Timestamp when, int64_t interval, int64_t repeat_count)
+{
+    if (free_timers_.empty())
     {
-        if (iter->second == timer)
-        {
-            iter->second->cancel(off);
-            break;
-        }
+        return new Timer(std::move(cb), when, interval, repeat_count);
     }
 
-    ////assert(timers_.size() == activeTimers_.size());
-    //ActiveTimer timer(timerId.timer_, timerId.sequence_);
-    //ActiveTimerSet::iterator it = activeTimers_.find(timer);
-    //if (it != activeTimers_.end())
-    //{
-    //    size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
-    //    //assert(n == 1); (void)n;
-    //    delete it->first; // FIXME: no delete please
-    //    activeTimers_.erase(it);
-    //}
-    //else if (callingExpiredTimers_)
-    //{
-    //    cancelingTimers_.insert(timer);
-    //}
-    ////assert(timers_.size() == activeTimers_.size());
+    Timer* timer = free_timers_.back();
+    free_timers_.pop_back();
+    timer->assign(std::move(cb), when, interval, repeat_count);
+    return timer;
 }
 
-//std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now)
-//{
-//    assert(timers_.size() == activeTimers_.size());
-//    std::vector<Entry> expired;
-//    Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
-//    TimerList::iterator end = timers_.lower_bound(sentry);
-//    assert(end == timers_.end() || now < end->first);
-//    std::copy(timers_.begin(), end, back_inserter(expired));
-//    timers_.erase(timers_.begin(), end);
-//
-//    for (std::vector<Entry>::iterator it = expired.begin();
-//        it != expired.end(); ++it)
-//    {
-//        ActiveTimer timer(it->second, it->second->sequence());
-//        size_t n = activeTimers_.erase(timer);
-//        assert(n == 1); (void)n;
-//    }
-//
-//    assert(timers_.size() == activeTimers_.size());
-//    return expired;
-//}
-
-//void TimerQueue::reset(const std::vector<Entry> & expired, Timestamp now)
-//{
-//    Timestamp nextExpire;
-//
-//    for (std::vector<Entry>::const_iterator it = expired.begin();
-//        it != expired.end(); ++it)
-//    {
-//        ActiveTimer timer(it->second, it->second->sequence());
-//        if (it->second->getRepeatCount()
-//            && cancelingTimers_.find(timer) == cancelingTimers_.end())
-//        {
-//            it->second->restart(now);
-//            insert(it->second);
-//        }
-//        else
-//        {
-//            // FIXME move to a free list
-//            delete it->second; // FIXME: no delete please
-//        }
-//    }
-//
-//    if (!timers_.empty())
-//    {
-//        nextExpire = timers_.begin()->second->expiration();
-//    }
-//
-//    if (nextExpire.valid())
-//    {
-//        resetTimerfd(timerfd_, nextExpire);
-//    }
-//}
-
-void TimerQueue::insert(Timer* timer)
+void TimerQueue::_free_timer(Timer* timer)
 {
-    loop_->assert_in_loop_thread();
-    //assert(timers_.size() == activeTimers_.size());
-    bool earliest_changed = false;
-    Timestamp when = timer->expiration();
-    //TimerList::iterator it = timers_.begin();
-    //if (it == timers_.end() || when < it->first)
-    //{
-    //    earliestChanged = true;
-    //}
-    //{
-    /*std::pair<TimerList::iterator, bool> result = */timers_.insert(Entry(when, timer));
-    //assert(result.second); (void)result;
-//}
-//{
-//    std::pair<ActiveTimerSet::iterator, bool> result = activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
-    //assert(result.second); (void)result;
-//}
+    timer->release();
+    free_timers_.push_back(timer);
+}
 
-//assert(timers_.size() == activeTimers_.size());
-//return earliestChanged;
+bool TimerQueue::_is_alive(const TimerId& timer_id)
+{
+    //空闲链表里的 Timer 不会被 delete，所以这里解引用是安全的
+    return timer_id.timer_ != nullptr && timer_id.timer_->sequence() == timer_id.sequence_;
 }
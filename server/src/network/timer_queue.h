@@ -1,14 +1,16 @@
 #pragma once
 
 #include "net_callback.h"
+#include "timer_heap.h"
 #include "common/platform.h"
-#include <utility> // For std::pair
-#include <set>     // For std::set
+#include <vector>
+#include <memory>
 #include <cstdint> // For int64_t
 
 namespace w_network
 {
     class EventLoop;
+    class Channel;
     class Timer;
     class TimerId;
 
@@ -29,23 +31,30 @@ namespace w_network
         // called when timerfd alarms
         void do_timer();
 
+        size_t size() const { return heap_.size(); }
+
     private:
         TimerQueue(const TimerQueue& rhs) = delete;
         TimerQueue& operator=(const TimerQueue& rhs) = delete;
 
-        typedef std::pair<Timestamp, Timer*>    Entry;
-        typedef std::set<Entry>                 TimerList;
-        typedef std::pair<Timer*, int64_t>      ActiveTimer;
-        typedef std::set<ActiveTimer>           ActiveTimerSet;
-
         void add_timer_in_loop(Timer* timer);
         void remove_timer_in_loop(TimerId timer_id);
         void cancel_timer_in_loop(TimerId timer_id, bool off);
 
-        void insert(Timer* timer);
+        // 只在 loop 线程里调用，优先复用空闲链表中的 Timer
+        Timer* _alloc_timer(TimerCallback&& cb, Timestamp when, int64_t interval, int64_t repeat_count);
+        void _free_timer(Timer* timer);
+        // TimerId 指向的定时器是否还是当初那一个（没有到期释放或被复用）
+        static bool _is_alive(const TimerId& timer_id);
 
         private:
         EventLoop* loop_;
-        TimerList           timers_; 
+#ifndef WIN32
+        const int                   timerfd_;
+        std::unique_ptr<Channel>    timerfd_channel_;
+#endif
+        TimerHeap           heap_;
+        std::vector<Timer*> expired_;        // do_timer() 中复用，避免每次分配
+        std::vector<Timer*> free_timers_;    // per-loop 空闲链表，Timer 只在析构时真正释放
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,141 @@
+#include "timing_wheel.h"
+#include "event_loop.h"
+
+using namespace w_network;
+
+TimingWheel::TimingWheel(EventLoop* loop, int64_t tick_ms/* = 1000*/, size_t slot_num/* = 64*/)
+    : loop_(loop),
+    tick_ms_(tick_ms > 0 ? tick_ms : 1000),
+    slots_(slot_num > 0 ? slot_num : 64),
+    current_tick_(0),
+    size_(0),
+    ticking_(false)
+{
+}
+
+TimingWheel::~TimingWheel()
+{
+    //剩下的节点属于使用者，这里只把它们摘下来
+    for (Link& head : slots_)
+    {
+        while (head.next_ != &head)
+        {
+            _unlink(head.next_);
+        }
+    }
+    _stop_ticking();
+}
+
+void TimingWheel::_link(Link* head, Link* node)
+{
+    node->prev_ = head->prev_;
+    node->next_ = head;
+    head->prev_->next_ = node;
+    head->prev_ = node;
+}
+
+void TimingWheel::_unlink(Link* node)
+{
+    node->prev_->next_ = node->next_;
+    node->next_->prev_ = node->prev_;
+    node->prev_ = node;
+    node->next_ = node;
+}
+
+void TimingWheel::add(Entry* entry, int64_t timeout_ms, TimerCallback&& cb)
+{
+    loop_->assert_in_loop_thread();
+    if (entry->linked())
+    {
+        _unlink(entry);
+        --size_;
+    }
+
+    //多加一个 tick，保证至少等满 timeout_ms
+    entry->ticks_ = (timeout_ms + tick_ms_ - 1) / tick_ms_ + 1;
+    entry->callback_ = std::move(cb);
+    touch(entry);
+    _link(&slots_[entry->deadline_ % slots_.size()], entry);
+    ++size_;
+
+    _start_ticking();
+}
+
+void TimingWheel::remove(Entry* entry)
+{
+    if (!entry->linked())
+        return;
+
+    _unlink(entry);
+    --size_;
+    entry->callback_ = nullptr;
+}
+
+void TimingWheel::_on_tick()
+{
+    ++current_tick_;
+
+    //先把整个 slot 摘到临时链表上，回调里可能会 add/remove 任意节点
+    Link pending;
+    Link& head = slots_[current_tick_ % slots_.size()];
+    if (head.next_ != &head)
+    {
+        pending.next_ = head.next_;
+        pending.prev_ = head.prev_;
+        pending.next_->prev_ = &pending;
+        pending.prev_->next_ = &pending;
+        head.next_ = &head;
+        head.prev_ = &head;
+    }
+
+    Link expired;
+    while (pending.next_ != &pending)
+    {
+        Entry* entry = static_cast<Entry*>(pending.next_);
+        _unlink(entry);
+        if (entry->deadline_ <= current_tick_)
+        {
+            _link(&expired, entry);
+        }
+        else
+        {
+            //被 touch 过，挂到新的到期 slot 上
+            _link(&slots_[entry->deadline_ % slots_.size()], entry);
+        }
+    }
+
+    while (expired.next_ != &expired)
+    {
+        Entry* entry = static_cast<Entry*>(expired.next_);
+        _unlink(entry);
+        --size_;
+        TimerCallback cb;
+        cb.swap(entry->callback_);
+        //回调里使用者可能会销毁 entry，之后不能再访问它
+        cb();
+    }
+
+    if (size_ == 0)
+    {
+        _stop_ticking();
+    }
+}
+
+void TimingWheel::_start_ticking()
+{
+    if (ticking_)
+        return;
+
+    ticking_ = true;
+    //run_every 的间隔单位是微秒
+    tick_timer_ = loop_->run_every(tick_ms_ * 1000, std::bind(&TimingWheel::_on_tick, this));
+}
+
+void TimingWheel::_stop_ticking()
+{
+    if (!ticking_)
+        return;
+
+    ticking_ = false;
+    loop_->remove(tick_timer_);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "net_callback.h"
+#include "timer_id.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace w_network
+{
+    class EventLoop;
+
+    /// 哈希时间轮，用于大量连接的空闲超时
+    ///
+    /// 每个 tick 推进一格，每个 slot 是一个侵入式双向链表。
+    /// touch() 只更新到期 tick，不移动节点；节点所在 slot 转到时如果还没到期，
+    /// 再按新的到期 tick 挂到对应 slot 上。所以插入、touch、删除、到期都是 O(1)。
+    /// 超过一圈的超时也一样处理，只是多转几圈。
+    ///
+    /// 时间轮里有节点时才注册 tick 定时器，空了就停掉，空闲的 loop 不会被唤醒。
+    /// 只能在所属 loop 线程中使用。
+    class TimingWheel
+    {
+    public:
+        struct Link
+        {
+            Link* prev_;
+            Link* next_;
+
+            Link() : prev_(this), next_(this) {}
+        };
+
+        /// 嵌入到使用者（如 TcpConnection）中的节点，使用者负责在析构前 remove()
+        class Entry : private Link
+        {
+        public:
+            Entry() : deadline_(0), ticks_(0) {}
+
+            bool linked() const { return next_ != this; }
+
+        private:
+            Entry(const Entry& rhs) = delete;
+            Entry& operator=(const Entry& rhs) = delete;
+
+            friend class TimingWheel;
+
+            int64_t         deadline_;  // 到期的 tick
+            int64_t         ticks_;     // 超时时长折算成的 tick 数
+            TimerCallback   callback_;
+        };
+
+        //tick_ms 是时间轮精度，单位毫秒
+        TimingWheel(EventLoop* loop, int64_t tick_ms = 1000, size_t slot_num = 64);
+        ~TimingWheel();
+
+        /// 加入时间轮（已经在轮中则重新设置超时），timeout_ms 后调用 cb
+        void add(Entry* entry, int64_t timeout_ms, TimerCallback&& cb);
+        /// 从现在开始重新计时，只写一个整数
+        void touch(Entry* entry)
+        {
+            entry->deadline_ = current_tick_ + entry->ticks_;
+        }
+        void remove(Entry* entry);
+
+        size_t size() const { return size_; }
+        int64_t tick_ms() const { return tick_ms_; }
+        /// 已经走过的 tick 数
+        int64_t current_tick() const { return current_tick_; }
+        /// tick 定时器是否在运行
+        bool ticking() const { return ticking_; }
+
+    private:
+        TimingWheel(const TimingWheel& rhs) = delete;
+        TimingWheel& operator=(const TimingWheel& rhs) = delete;
+
+        static void _link(Link* head, Link* node);
+        static void _unlink(Link* node);
+
+        void _on_tick();
+        void _start_ticking();
+        void _stop_ticking();
+
+    private:
+        EventLoop*          loop_;
+        const int64_t       tick_ms_;
+        std::vector<Link>   slots_;         // 创建后不再改变大小，链表头的地址必须固定
+        int64_t             current_tick_;
+        size_t              size_;
+        bool                ticking_;
+        TimerId             tick_timer_;
+    };
+}
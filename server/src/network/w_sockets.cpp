@@ -2,6 +2,9 @@
 
 #include <stdio.h> // snprintf
 #include <string.h>
+#ifndef WIN32
+#include <sys/sendfile.h>
+#endif
 
 #include "log/whisp_log.h"
 #include "inet_address.h"
@@ -193,24 +196,25 @@ SOCKET w_sockets::socks_accept(SOCKET sockfd, struct sockaddr_in* addr)
         WHISP_LOG_FALTAL("unexpected error of ::accept %d", savedErrno);
 #else
         int savedErrno = errno;
-        WHISP_LOG_SYSERROR("w_sockets::socks_accept");
         switch (savedErrno)
         {
         case EAGAIN:
+            //Acceptor 每次都会 accept 到 EAGAIN 为止，这是正常结束，不打日志
+            break;
         case ECONNABORTED:
         case EINTR:
         case EPROTO: // ???
         case EPERM:
         case EMFILE: // per-process lmit of open file desctiptor ???
-            // expected errors
-            errno = savedErrno;
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+            // expected errors，资源耗尽时由 Acceptor 拒绝连接，不能让进程挂掉
+            WHISP_LOG_SYSERROR("w_sockets::socks_accept");
             break;
         case EBADF:
         case EFAULT:
         case EINVAL:
-        case ENFILE:
-        case ENOBUFS:
-        case ENOMEM:
         case ENOTSOCK:
         case EOPNOTSUPP:
             // unexpected errors
@@ -220,6 +224,7 @@ SOCKET w_sockets::socks_accept(SOCKET sockfd, struct sockaddr_in* addr)
             WHISP_LOG_FALTAL("unknown error of ::accept %d", savedErrno);
             break;
         }
+        errno = savedErrno;
 
 #endif
     }
@@ -283,6 +288,19 @@ int32_t w_sockets::socks_write(SOCKET sockfd, const void* buf, int32_t count)
 
 }
 
+#ifndef WIN32
+ssize_t w_sockets::socks_writev(SOCKET sockfd, const struct iovec* iov, int iovcnt)
+{
+    return ::writev(sockfd, iov, iovcnt);
+}
+
+ssize_t w_sockets::socks_sendfile(SOCKET sockfd, int file_fd, int64_t offset, size_t count)
+{
+    off_t off = static_cast<off_t>(offset);
+    return ::sendfile(sockfd, file_fd, &off, count);
+}
+#endif
+
 void w_sockets::socks_close(SOCKET sockfd)
 {
 #ifdef WIN32   
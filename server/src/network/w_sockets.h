@@ -47,6 +47,11 @@ namespace w_network
         ssize_t socks_readv(SOCKET sockfd, const struct iovec* iov, int iovcnt);
 #endif
         int32_t socks_write(SOCKET sockfd, const void* buf, int32_t count);
+#ifndef WIN32
+        ssize_t socks_writev(SOCKET sockfd, const struct iovec* iov, int iovcnt);
+        // 把文件 file_fd 从 offset 开始的 count 字节直接发到 socket，不经过用户态
+        ssize_t socks_sendfile(SOCKET sockfd, int file_fd, int64_t offset, size_t count);
+#endif
         void socks_close(SOCKET sockfd);
         void socks_shutdown_write(SOCKET sockfd);
 
@@ -1,4 +1,5 @@
 #include "whisp_thread_pool.h"
+#include "util/cpu_affinity.h"
 // #include "TalkLog.h"
 
 // 构造函数：启动线程
@@ -97,6 +98,15 @@ void WhispThreadPool::resize(size_t num_threads) {
                     task(); // 执行任务
                 }
             });
+            cpu_bind_thread(workers.back(), cpus);
         }
     }
+}
+
+// 绑核
+void WhispThreadPool::set_cpus(const std::vector<int>& cpus) {
+    this->cpus = cpus;
+    for (std::thread &worker : workers) {
+        cpu_bind_thread(worker, cpus);
+    }
 }
\ No newline at end of file
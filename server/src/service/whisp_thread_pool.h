@@ -48,6 +48,10 @@ public:
     // 调整线程池大小
     void resize(size_t num_threads);
 
+    // 把所有工作线程（包括之后 resize 新增的）绑到 cpus 中的核上，空表示不绑
+    // 数据库这类会阻塞的工作线程一般绑在 IO 核之外，见 cpu_isolated_set()
+    void set_cpus(const std::vector<int>& cpus);
+
 private:
     std::vector<std::thread> workers; // 线程集合
     std::queue<std::function<void()>> tasks; // 任务队列
@@ -55,6 +59,7 @@ private:
     std::mutex queue_mutex; // 互斥锁
     std::condition_variable condition; // 条件变量
     std::atomic<bool> stop; // 线程池是否停止
+    std::vector<int> cpus; // 工作线程绑定的核
 };
 
 #endif // WHISP_THREAD_POOL_H
@@ -0,0 +1,256 @@
+#include "avatar_store.h"
+#include "log/whisp_log.h"
+#include <openssl/evp.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#ifdef WIN32
+#include <io.h>
+#include <direct.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef WIN32
+#define avatar_open     _open
+#define avatar_close    _close
+#define avatar_write    _write
+#define avatar_fsync    _commit
+#define avatar_mkdir(path)  _mkdir(path)
+#define AVATAR_O_FLAGS  _O_BINARY
+#else
+#define avatar_open     ::open
+#define avatar_close    ::close
+#define avatar_write    ::write
+#define avatar_fsync    ::fsync
+#define avatar_mkdir(path)  ::mkdir(path, 0755)
+#define AVATAR_O_FLAGS  O_CLOEXEC
+#endif
+
+//在 path 所在目录里创建一个新的临时文件，名字由系统生成，不会和别的线程、进程重复
+static int open_temp_file(const std::string& path, std::string* tmp_path)
+{
+    *tmp_path = path + ".tmp.XXXXXX";
+#ifdef WIN32
+    if (_mktemp_s(&(*tmp_path)[0], tmp_path->size() + 1) != 0)
+        return -1;
+    return _open(tmp_path->c_str(), _O_WRONLY | _O_CREAT | _O_EXCL | AVATAR_O_FLAGS, _S_IREAD | _S_IWRITE);
+#else
+    int fd = ::mkostemp(&(*tmp_path)[0], O_CLOEXEC);
+    //mkstemp 建的文件是 0600，和直接 open 的头像文件保持一致
+    if (fd >= 0 && ::fchmod(fd, 0644) != 0)
+    {
+        ::close(fd);
+        ::unlink(tmp_path->c_str());
+        return -1;
+    }
+    return fd;
+#endif
+}
+
+AvatarStore::File::File(int fd, size_t size, const std::string& md5)
+    : fd_(fd), size_(size), md5_(md5)
+{
+}
+
+AvatarStore::File::~File()
+{
+    avatar_close(fd_);
+}
+
+AvatarStore::AvatarStore(const std::string& root_dir, size_t max_open_files/* = 1024*/)
+    : root_dir_(root_dir),
+    max_open_files_(max_open_files > 0 ? max_open_files : 1)
+{
+}
+
+bool AvatarStore::init()
+{
+    if (avatar_mkdir(root_dir_.c_str()) != 0 && errno != EEXIST)
+    {
+        WHISP_LOG_SYSERROR("AvatarStore::init, mkdir %s failed", root_dir_.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::string AvatarStore::md5_hex(const char* data, size_t len)
+{
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    if (EVP_Digest(data, len, digest, &digest_len, EVP_md5(), nullptr) != 1)
+        return std::string();
+
+    static const char hex[] = "0123456789abcdef";
+    std::string result(digest_len * 2, '0');
+    for (unsigned int i = 0; i < digest_len; ++i)
+    {
+        result[i * 2] = hex[digest[i] >> 4];
+        result[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+    return result;
+}
+
+bool AvatarStore::_valid_md5(const std::string& md5)
+{
+    if (md5.size() != 32)
+        return false;
+
+    for (char c : md5)
+    {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return false;
+    }
+    return true;
+}
+
+std::string AvatarStore::_dir_of(const std::string& md5) const
+{
+    return root_dir_ + "/" + md5.substr(0, 2);
+}
+
+std::string AvatarStore::_path_of(const std::string& md5) const
+{
+    return _dir_of(md5) + "/" + md5;
+}
+
+std::string AvatarStore::put(const std::string& data)
+{
+    std::string md5 = md5_hex(data.data(), data.size());
+    if (md5.empty())
+    {
+        WHISP_LOG_ERROR("AvatarStore::put, md5 failed");
+        return std::string();
+    }
+
+    //内容相同的文件已经存在，不用再写
+    if (exists(md5))
+        return md5;
+
+    std::string dir = _dir_of(md5);
+    if (avatar_mkdir(dir.c_str()) != 0 && errno != EEXIST)
+    {
+        WHISP_LOG_SYSERROR("AvatarStore::put, mkdir %s failed", dir.c_str());
+        return std::string();
+    }
+
+    //先写临时文件再改名，其他线程、进程要么看不到文件，要么看到完整的文件
+    std::string path = _path_of(md5);
+    std::string tmp_path;
+    int fd = open_temp_file(path, &tmp_path);
+    if (fd < 0)
+    {
+        WHISP_LOG_SYSERROR("AvatarStore::put, create temp file for %s failed", path.c_str());
+        return std::string();
+    }
+
+    size_t written = 0;
+    while (written < data.size())
+    {
+        int n = static_cast<int>(avatar_write(fd, data.data() + written, static_cast<unsigned int>(data.size() - written)));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        written += n;
+    }
+    //改名之前落盘，否则宕机后 md5 名下可能是个不完整的文件，之后一直这样发出去
+    bool ok = written == data.size() && avatar_fsync(fd) == 0;
+    ok = avatar_close(fd) == 0 && ok;
+
+    if (!ok || ::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        WHISP_LOG_SYSERROR("AvatarStore::put, write %s failed", path.c_str());
+        ::remove(tmp_path.c_str());
+        return std::string();
+    }
+
+    return md5;
+}
+
+AvatarStore::FilePtr AvatarStore::get(const std::string& md5)
+{
+    if (!_valid_md5(md5))
+        return FilePtr();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto iter = index_.find(md5);
+        if (iter != index_.end())
+        {
+            _touch(md5);
+            return iter->second.file_;
+        }
+    }
+
+    //打开文件不占着锁，两个线程同时打开同一个文件时后放进索引的那个直接丢掉
+    std::string path = _path_of(md5);
+    int fd = avatar_open(path.c_str(), O_RDONLY | AVATAR_O_FLAGS);
+    if (fd < 0)
+    {
+        if (errno != ENOENT)
+        {
+            WHISP_LOG_SYSERROR("AvatarStore::get, open %s failed", path.c_str());
+        }
+        return FilePtr();
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        WHISP_LOG_SYSERROR("AvatarStore::get, fstat %s failed", path.c_str());
+        avatar_close(fd);
+        return FilePtr();
+    }
+    FilePtr file(std::make_shared<File>(fd, static_cast<size_t>(st.st_size), md5));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = index_.find(md5);
+    if (iter != index_.end())
+    {
+        _touch(md5);
+        return iter->second.file_;
+    }
+
+    //淘汰最久没用的，正在发送的连接还引用着它，发完才真正关闭
+    while (index_.size() >= max_open_files_)
+    {
+        index_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    lru_.push_front(md5);
+    IndexEntry& entry = index_[md5];
+    entry.file_ = file;
+    entry.lru_ = lru_.begin();
+    return file;
+}
+
+void AvatarStore::_touch(const std::string& md5)
+{
+    IndexEntry& entry = index_[md5];
+    lru_.splice(lru_.begin(), lru_, entry.lru_);
+}
+
+bool AvatarStore::exists(const std::string& md5) const
+{
+    if (!_valid_md5(md5))
+        return false;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (index_.find(md5) != index_.end())
+            return true;
+    }
+
+    struct stat st;
+    return ::stat(_path_of(md5).c_str(), &st) == 0;
+}
+
+size_t AvatarStore::open_count() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return index_.size();
+}
@@ -0,0 +1,90 @@
+#ifndef AVATAR_STORE_H
+#define AVATAR_STORE_H
+
+#include <stdint.h>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+
+/**
+ * 按内容寻址的头像存储，User::customface 就是文件内容的 md5
+ *
+ * 文件放在 root_dir/md5 前两位/md5 下，相同内容只存一份，写入后不再修改。
+ * 常用头像的 fd 一直开着（按 LRU 最多 max_open_files 个），取到的 File 交给
+ * TcpConnection::send_file() 直接 sendfile，不读进用户态。线程安全
+ */
+class AvatarStore final
+{
+public:
+    /// 打开的头像文件，最后一个引用（索引或者正在发送的连接）释放时关闭 fd
+    class File
+    {
+    public:
+        File(int fd, size_t size, const std::string& md5);
+        ~File();
+
+        int fd() const { return fd_; }
+        size_t size() const { return size_; }
+        const std::string& md5() const { return md5_; }
+
+    private:
+        File(const File& rhs) = delete;
+        File& operator=(const File& rhs) = delete;
+
+    private:
+        const int           fd_;
+        const size_t        size_;
+        const std::string   md5_;
+    };
+
+    typedef std::shared_ptr<const File> FilePtr;
+
+    explicit AvatarStore(const std::string& root_dir, size_t max_open_files = 1024);
+    ~AvatarStore() = default;
+
+    /// 创建根目录
+    bool init();
+
+    /// 保存头像，返回内容的 md5（32 位小写十六进制），失败返回空串
+    std::string put(const std::string& data);
+
+    /// 按 md5 取头像，索引里有就直接返回，没有就打开并放进索引。md5 不合法或者文件不存在返回空
+    FilePtr get(const std::string& md5);
+
+    bool exists(const std::string& md5) const;
+
+    size_t open_count() const;
+
+    /// 内容的 md5，32 位小写十六进制
+    static std::string md5_hex(const char* data, size_t len);
+
+private:
+    AvatarStore(const AvatarStore& rhs) = delete;
+    AvatarStore& operator=(const AvatarStore& rhs) = delete;
+
+    // md5 只能是 32 位小写十六进制，也就不会拼出 ../ 之类的路径
+    static bool _valid_md5(const std::string& md5);
+    std::string _dir_of(const std::string& md5) const;
+    std::string _path_of(const std::string& md5) const;
+    // 调用者持有 mutex_
+    void _touch(const std::string& md5);
+
+private:
+    typedef std::list<std::string> LruList;
+
+    struct IndexEntry
+    {
+        FilePtr             file_;
+        LruList::iterator   lru_;
+    };
+
+    const std::string                           root_dir_;
+    const size_t                                max_open_files_;
+    mutable std::mutex                          mutex_;
+    std::unordered_map<std::string, IndexEntry> index_;
+    LruList                                     lru_;   // 表头最近使用
+};
+
+#endif // AVATAR_STORE_H
@@ -0,0 +1,111 @@
+#include "cpu_affinity.h"
+#include "log/whisp_log.h"
+#include <algorithm>
+
+#ifndef WIN32
+#include <pthread.h>    // pthread_setaffinity_np()
+#include <sched.h>      // cpu_set_t
+#include <unistd.h>     // sysconf()
+#include <dirent.h>     // opendir()
+#include <stdio.h>
+#include <string.h>
+#endif
+
+int cpu_online_count()
+{
+#ifdef WIN32
+    return static_cast<int>(std::thread::hardware_concurrency());
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? static_cast<int>(n) : 1;
+#endif
+}
+
+int cpu_numa_node(int cpu)
+{
+#ifdef WIN32
+    return -1;
+#else
+    // /sys/devices/system/cpu/cpuN/ 下有一个 nodeM 的链接
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+    DIR* dp = opendir(path);
+    if (dp == NULL)
+        return -1;
+
+    int node = -1;
+    struct dirent* entry;
+    while ((entry = readdir(dp)) != NULL)
+    {
+        if (strncmp(entry->d_name, "node", 4) == 0 && sscanf(entry->d_name + 4, "%d", &node) == 1)
+            break;
+    }
+    closedir(dp);
+    return node;
+#endif
+}
+
+#ifndef WIN32
+static bool bind_pthread(pthread_t thread, const std::vector<int>& cpus)
+{
+    if (cpus.empty())
+        return true;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+
+    int ret = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (ret != 0)
+    {
+        WHISP_LOG_ERROR("pthread_setaffinity_np failed, first cpu = %d, count = %d, ret = %d",
+            cpus[0], static_cast<int>(cpus.size()), ret);
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool cpu_bind_current_thread(const std::vector<int>& cpus)
+{
+#ifdef WIN32
+    return true;
+#else
+    return bind_pthread(pthread_self(), cpus);
+#endif
+}
+
+bool cpu_bind_thread(std::thread& thread, const std::vector<int>& cpus)
+{
+#ifdef WIN32
+    return true;
+#else
+    if (!thread.joinable())
+        return false;
+    return bind_pthread(thread.native_handle(), cpus);
+#endif
+}
+
+std::vector<int> cpu_isolated_set(const std::vector<int>& configured, const std::vector<int>& io_cpus)
+{
+    std::vector<int> result;
+    if (configured.empty())
+    {
+        int count = cpu_online_count();
+        for (int cpu = 0; cpu < count; ++cpu)
+            result.push_back(cpu);
+    }
+    else
+    {
+        result = configured;
+    }
+
+    result.erase(std::remove_if(result.begin(), result.end(), [&io_cpus](int cpu) {
+        return std::find(io_cpus.begin(), io_cpus.end(), cpu) != io_cpus.end();
+    }), result.end());
+    return result;
+}
@@ -0,0 +1,31 @@
+#ifndef CPU_AFFINITY_H
+#define CPU_AFFINITY_H
+
+#include <vector>
+#include <thread>
+
+/**
+ * 线程绑核，Windows 上都是空操作
+ *
+ * NUMA 上依赖内核的 first-touch 策略：线程先绑核再分配内存（EventLoop、
+ * 缓冲区都在绑核之后才创建），内存自然落在本节点上，不需要 libnuma。
+ */
+
+// 在线 CPU 个数
+int cpu_online_count();
+
+// cpu 所在的 NUMA 节点，取不到（非 NUMA 机器或 WIN32）返回 -1
+int cpu_numa_node(int cpu);
+
+// 把当前线程绑到 cpus 中的核上，cpus 为空时什么也不做
+bool cpu_bind_current_thread(const std::vector<int>& cpus);
+
+// 把另一个线程绑到 cpus 中的核上，cpus 为空时什么也不做
+bool cpu_bind_thread(std::thread& thread, const std::vector<int>& cpus);
+
+// 隔离模式下日志、数据库等后台线程可用的核：
+// configured 非空时去掉其中的 IO 核，为空时取所有不是 IO 核的在线核；
+// 结果为空（核全被 IO 线程占了）表示不绑
+std::vector<int> cpu_isolated_set(const std::vector<int>& configured, const std::vector<int>& io_cpus);
+
+#endif // CPU_AFFINITY_H
@@ -0,0 +1,88 @@
+// IO 线程绑核基准：一个 IO loop 加若干个忙一阵歇一阵的后台线程（模拟日志、数据库线程），
+// 主线程一次投递一个任务到 IO loop，等它执行完再投下一个，统计投递到执行的延迟分布。
+// 先不绑核跑一次，再把 IO 线程绑到最后一个核、后台线程绑到其余的核（cpu_isolated_set）跑一次。
+// 只有一个核时 cpu_isolated_set 为空，后台线程不绑，两次结果应该差不多
+// 用法：bench_affinity [任务数] [后台线程数]，默认 20000 和 2
+#include "network/event_loop.h"
+#include "network/event_loop_threadpool.h"
+#include "util/cpu_affinity.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace w_network;
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void bench(bool pin, int tasks, int noise_threads)
+{
+    std::vector<int> io_cpus = { cpu_online_count() - 1 };
+    std::vector<int> other_cpus = cpu_isolated_set({}, io_cpus);
+
+    EventLoop base;
+    EventLoopThreadPool pool;
+    pool.init(&base, 1);
+    if (pin)
+        pool.set_thread_cpus(io_cpus);
+    pool.start();
+    EventLoop* loop = pool.get_all_loops()[0];
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> noise;
+    for (int i = 0; i < noise_threads; ++i)
+    {
+        noise.emplace_back([&stop]() {
+            volatile uint64_t x = 0;
+            while (!stop)
+            {
+                for (int k = 0; k < 100000; ++k)
+                    x += k;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        });
+        if (pin)
+            cpu_bind_thread(noise.back(), other_cpus);
+    }
+
+    std::vector<int64_t> latency;
+    latency.reserve(tasks);
+    std::atomic<int> done(0);
+    for (int i = 0; i < tasks; ++i)
+    {
+        int64_t start = now_ns();
+        loop->queue_in_loop([&latency, &done, start]() {
+            latency.push_back(now_ns() - start);
+            done.fetch_add(1, std::memory_order_release);
+        });
+        while (done.load(std::memory_order_acquire) <= i)
+            std::this_thread::yield();
+    }
+    stop = true;
+    for (std::thread& t : noise)
+        t.join();
+    pool.stop();
+
+    std::sort(latency.begin(), latency.end());
+    printf("pin=%d cpus=%d io cpu=%d other cpus=%d: p50=%lldus p99=%lldus p999=%lldus max=%lldus\n",
+        pin, cpu_online_count(), io_cpus[0], (int)other_cpus.size(),
+        (long long)latency[latency.size() / 2] / 1000,
+        (long long)latency[latency.size() * 99 / 100] / 1000,
+        (long long)latency[latency.size() * 999 / 1000] / 1000,
+        (long long)latency.back() / 1000);
+}
+
+int main(int argc, char* argv[])
+{
+    int tasks = argc > 1 ? atoi(argv[1]) : 20000;
+    int noise_threads = argc > 2 ? atoi(argv[2]) : 2;
+    bench(false, tasks, noise_threads);
+    bench(true, tasks, noise_threads);
+    return 0;
+}
@@ -0,0 +1,98 @@
+// ChatFrameCodec 解码基准：一个 ByteBuffer 里放满 32B~2KB 包体的 v1 帧，比较
+//   decode             - ChatFrameCodec::decode() 原地解析，最后 bb_retrieve 一次
+//   retrieve_as_string - 原来的写法，包头、包体各 bb_retrieve_as_string 一次
+// 每种跑 5 次取最好的一次
+// 用法：bench_frame_codec [MB]，默认 64
+#include "network/chat_frame_codec.h"
+#include "network/byte_buffer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+using namespace w_network;
+
+static std::string make_frame(size_t body_len, char c)
+{
+    chat_msg_header header;
+    memset(&header, 0, sizeof(header));
+    header.compressflag = PACKAGE_COMPRESSED;
+    header.originsize = static_cast<int32_t>(body_len * 3);
+    header.compresssize = static_cast<int32_t>(body_len);
+    std::string frame(reinterpret_cast<const char*>(&header), sizeof(header));
+    frame.append(body_len, c);
+    return frame;
+}
+
+static size_t decode_in_place(const ChatFrameCodec& codec, ByteBuffer* buf, size_t* sum)
+{
+    const char* data = buf->bb_peek();
+    size_t len = buf->bb_bytes_readable();
+    size_t offset = 0;
+    size_t frames = 0;
+    ChatFrame frame;
+    size_t n = 0;
+    const char* reason = nullptr;
+    while (codec.decode(data + offset, len - offset, &frame, &n, &reason) == ChatFrameCodec::kFrame)
+    {
+        *sum += frame.body[0];
+        offset += n;
+        ++frames;
+    }
+    buf->bb_retrieve(offset);
+    return frames;
+}
+
+static size_t decode_as_string(ByteBuffer* buf, size_t* sum)
+{
+    size_t frames = 0;
+    while (buf->bb_bytes_readable() >= sizeof(chat_msg_header))
+    {
+        chat_msg_header header;
+        memcpy(&header, buf->bb_peek(), sizeof(header));
+        if (buf->bb_bytes_readable() < sizeof(header) + header.compresssize)
+            break;
+        std::string head = buf->bb_retrieve_as_string(sizeof(header));
+        std::string body = buf->bb_retrieve_as_string(header.compresssize);
+        *sum += body[0];
+        ++frames;
+    }
+    return frames;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t mb = argc > 1 ? atoi(argv[1]) : 64;
+    std::mt19937 rng(7);
+    std::string stream;
+    size_t frames = 0;
+    while (stream.size() < (mb << 20))
+    {
+        stream += make_frame(32 + rng() % 2048, 'a' + frames % 26);
+        ++frames;
+    }
+
+    ChatFrameCodec codec([](const TcpConnectionPtr&, const ChatFrame&, Timestamp) {});
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        double best = 1e9;
+        size_t sum = 0;
+        for (int rep = 0; rep < 5; ++rep)
+        {
+            ByteBuffer buf(stream.size());
+            buf.bb_append(stream.data(), stream.size());
+            auto start = std::chrono::steady_clock::now();
+            size_t got = mode == 0 ? decode_in_place(codec, &buf, &sum) : decode_as_string(&buf, &sum);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (seconds < best)
+                best = seconds;
+            if (got != frames)
+                printf("decoded %zu of %zu frames\n", got, frames);
+        }
+        printf("%-18s: %zu frames, %.0f MB/s, %.1f M frames/s (checksum %zu)\n",
+            mode == 0 ? "decode" : "retrieve_as_string", frames, stream.size() / best / 1048576, frames / best / 1e6, sum);
+    }
+    return 0;
+}
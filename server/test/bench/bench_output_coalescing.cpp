@@ -0,0 +1,129 @@
+// TcpConnection 输出合并基准：16 个连接每次请求回 4 条消息（64、800、32、32 字节，模拟登录应答、
+// 好友列表、两条状态通知），关闭和打开输出合并各跑一次，输出 IO 线程平均每条消息的 write 类和 read 类
+// 系统调用数（取自 /proc/self/task/<tid>/io 的 syscw、syscr）以及总耗时。
+// 关闭合并时服务端的小包会碰上 Nagle 加延迟 ACK，每轮要等几十毫秒，所以默认轮数不大
+// 用法：bench_output_coalescing [轮数]，轮数默认 200
+#include "network/tcp_server.h"
+#include "network/event_loop.h"
+#include "log/whisp_log.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace w_network;
+
+static const uint16_t port = 19095;
+static const int conns = 16;
+static const int sizes[4] = {64, 800, 32, 32};
+static const int reply = 64 + 800 + 32 + 32;
+
+// 读线程的 syscr、syscw
+static void thread_io(long tid, long* reads, long* writes)
+{
+    std::ifstream in("/proc/self/task/" + std::to_string(tid) + "/io");
+    std::string key;
+    long value;
+    while (in >> key >> value)
+    {
+        if (key == "syscr:")
+            *reads = value;
+        else if (key == "syscw:")
+            *writes = value;
+    }
+}
+
+static void bench(bool coalesce, int rounds)
+{
+    EventLoop base;
+    TcpServer server(&base, InetAddress(port, true), "bench", TcpServer::kReusePort);
+    server.set_output_coalescing(coalesce);
+    std::string parts[4];
+    for (int i = 0; i < 4; ++i)
+        parts[i].assign(sizes[i], 'a' + i);
+    std::atomic<long> io_tid(0);
+    server.set_msg_callback([&](const TcpConnectionPtr& conn, ByteBuffer* buf, Timestamp) {
+        io_tid = syscall(SYS_gettid);
+        size_t n = buf->bb_bytes_readable();
+        buf->bb_retrieve_all();
+        for (size_t k = 0; k < n; ++k)
+            for (int i = 0; i < 4; ++i)
+                conn->send(parts[i]);
+    });
+    server.start(1);
+
+    std::thread client([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < conns; ++i)
+        {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            while (connect(fd, (sockaddr*)&addr, sizeof addr) != 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            fds.push_back(fd);
+        }
+
+        char buf[4096];
+        bool ok = true;
+        long r0 = 0, w0 = 0, r1 = 0, w1 = 0;
+        std::chrono::steady_clock::time_point start;
+        for (int r = 0; r <= rounds; ++r)
+        {
+            //第 0 轮只用来拿到 IO 线程的 tid
+            if (r == 1)
+            {
+                thread_io(io_tid, &r0, &w0);
+                start = std::chrono::steady_clock::now();
+            }
+            for (int fd : fds)
+                ok = write(fd, "L", 1) == 1 && ok;
+            for (int fd : fds)
+            {
+                int got = 0;
+                while (ok && got < reply)
+                {
+                    ssize_t n = read(fd, buf, reply - got);
+                    if (n <= 0)
+                        ok = false;
+                    else
+                        got += n;
+                }
+            }
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        thread_io(io_tid, &r1, &w1);
+
+        long msgs = (long)conns * rounds * 4;
+        printf("coalesce=%d ok=%d: %d requests, write syscalls/msg %.2f, read syscalls/msg %.2f, %.0f ms\n",
+            coalesce, ok, conns * rounds, (double)(w1 - w0) / msgs, (double)(r1 - r0) / msgs, ms);
+        for (int fd : fds)
+            close(fd);
+        base.quit();
+    });
+    base.loop();
+    client.join();
+}
+
+int main(int argc, char* argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200;
+    WhispLog::get_instance().log_set_level(LOG_LEVEL_INFO);
+    bench(false, rounds);
+    bench(true, rounds);
+    return 0;
+}
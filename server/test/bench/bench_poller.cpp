@@ -0,0 +1,185 @@
+// Poller 后端基准：epoll 和 io_uring、水平触发和边缘触发组合，统计 IO 线程的系统调用数
+//   echo - 32 个连接 128 字节一问一答
+//   chat - 一个连接发 128 字节，服务端转发给全部 32 个连接
+//   idle - 32 个连接都不发数据，1 秒内 IO 线程的系统调用数（边缘触发不能因为一直可写而空转）
+// 系统调用用链接选项 --wrap 计数（见 CMakeLists.txt），只算 IO 线程上的
+// 用法：bench_poller [轮数]，轮数默认 2000
+#include "network/tcp_server.h"
+#include "network/event_loop.h"
+#include "log/whisp_log.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace w_network;
+
+static std::atomic<long> calls(0);
+static thread_local bool io_thread = false;
+
+#define WRAP(ret, name, params, args) \
+    extern "C" ret __real_##name params; \
+    extern "C" ret __wrap_##name params { if (io_thread) ++calls; return __real_##name args; }
+
+WRAP(int, epoll_ctl, (int a, int b, int c, struct epoll_event* e), (a, b, c, e))
+WRAP(int, epoll_wait, (int a, struct epoll_event* e, int m, int t), (a, e, m, t))
+WRAP(ssize_t, read, (int fd, void* b, size_t n), (fd, b, n))
+WRAP(ssize_t, write, (int fd, const void* b, size_t n), (fd, b, n))
+WRAP(ssize_t, readv, (int fd, const struct iovec* v, int n), (fd, v, n))
+WRAP(ssize_t, writev, (int fd, const struct iovec* v, int n), (fd, v, n))
+
+// io_uring_enter 通过 syscall() 调用
+extern "C" long __real_syscall(long n, long a, long b, long c, long d, long e, long f);
+extern "C" long __wrap_syscall(long n, long a, long b, long c, long d, long e, long f)
+{
+    if (io_thread)
+        ++calls;
+    return __real_syscall(n, a, b, c, d, e, f);
+}
+
+enum Mode { kEcho, kChat, kIdle };
+
+static const uint16_t port = 19093;
+static const int conns = 32;
+static const size_t msg_size = 128;
+
+static void read_full(int fd, char* buf, size_t n)
+{
+    size_t got = 0;
+    while (got < n)
+    {
+        ssize_t r = read(fd, buf + got, n - got);
+        if (r <= 0)
+            return;
+        got += r;
+    }
+}
+
+static void bench(EventLoop::PollerBackend backend, bool et, Mode mode, int rounds)
+{
+    EventLoop::set_poller_backend(backend);
+    EventLoop base;
+    TcpServer server(&base, InetAddress(port, true), "bench", TcpServer::kReusePort);
+    server.set_edge_triggered(et);
+    std::vector<TcpConnectionPtr> members;
+    std::mutex mutex;
+    server.set_conn_callback([&](const TcpConnectionPtr& conn) {
+        io_thread = true;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (conn->connected())
+            members.push_back(conn);
+    });
+    server.set_msg_callback([&](const TcpConnectionPtr& conn, ByteBuffer* buf, Timestamp) {
+        if (mode == kEcho)
+        {
+            conn->send(buf->bb_peek(), (int)buf->bb_bytes_readable());
+            buf->bb_retrieve_all();
+            return;
+        }
+        while (buf->bb_bytes_readable() >= msg_size)
+        {
+            auto payload = std::make_shared<const std::string>(buf->bb_peek(), msg_size);
+            buf->bb_retrieve(msg_size);
+            std::vector<TcpConnectionPtr> all;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                all = members;
+            }
+            TcpConnection::send_to_all(all, payload);
+        }
+    });
+    server.start(1);
+
+    std::thread client([&]() {
+        std::vector<int> fds;
+        for (int i = 0; i < conns; ++i)
+        {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            while (connect(fd, (sockaddr*)&addr, sizeof addr) != 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            fds.push_back(fd);
+        }
+        while (true)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (members.size() == conns)
+                break;
+        }
+
+        char buf[msg_size];
+        memset(buf, 'x', sizeof buf);
+        long msgs = 0;
+        long before = calls.load();
+        auto start = std::chrono::steady_clock::now();
+        if (mode == kEcho)
+        {
+            for (int r = 0; r < rounds; ++r)
+            {
+                for (int fd : fds)
+                    write(fd, buf, msg_size);
+                for (int fd : fds)
+                    read_full(fd, buf, msg_size);
+            }
+            msgs = (long)rounds * conns;
+        }
+        else if (mode == kChat)
+        {
+            for (int r = 0; r < rounds / 10; ++r)
+            {
+                write(fds[r % conns], buf, msg_size);
+                for (int fd : fds)
+                    read_full(fd, buf, msg_size);
+            }
+            msgs = (long)(rounds / 10) * conns;
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        long c = calls.load() - before;
+
+        const char* names[] = {"echo", "chat", "idle"};
+        if (mode == kIdle)
+            printf("%-8s %s %s: %ld server syscalls in %.0f ms\n",
+                backend == EventLoop::kIoUringBackend ? "io_uring" : "epoll", et ? "ET" : "LT", names[mode], c, ms);
+        else
+            printf("%-8s %s %s: %ld msgs, %ld server syscalls, %.2f per msg, %.0f ms\n",
+                backend == EventLoop::kIoUringBackend ? "io_uring" : "epoll", et ? "ET" : "LT", names[mode], msgs, c, (double)c / msgs, ms);
+        fflush(stdout);
+
+        for (int fd : fds)
+            close(fd);
+        base.quit();
+    });
+    base.loop();
+    client.join();
+}
+
+int main(int argc, char* argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+    WhispLog::get_instance().log_set_level(LOG_LEVEL_INFO);
+    for (Mode mode : {kEcho, kChat, kIdle})
+        for (EventLoop::PollerBackend backend : {EventLoop::kEpollBackend, EventLoop::kIoUringBackend})
+            for (bool et : {false, true})
+                bench(backend, et, mode, rounds);
+    return 0;
+}
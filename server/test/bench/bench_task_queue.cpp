@@ -0,0 +1,58 @@
+// EventLoop::queue_in_loop 基准：1、4、16 个生产者线程一共投递 N 个空任务到同一个 loop，
+// 最后一个任务执行完才停表，输出每秒投递数和 loop 迭代次数（迭代少说明唤醒被合并了）
+// 用法：bench_task_queue [N]，N 默认 4000000
+#include "network/event_loop.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace w_network;
+
+static void bench(int producers, long total)
+{
+    EventLoop* loop = nullptr;
+    std::atomic<bool> ready(false);
+    std::atomic<long> done(0);
+    int64_t iterations = 0;
+    std::thread loop_thread([&]() {
+        EventLoop l;
+        loop = &l;
+        ready = true;
+        l.loop();
+        iterations = l.iteration();
+    });
+    while (!ready)
+        std::this_thread::yield();
+
+    long per_producer = total / producers;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&]() {
+            for (long k = 0; k < per_producer; ++k)
+                loop->queue_in_loop([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    while (done.load() < per_producer * producers)
+        std::this_thread::yield();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    loop->quit();
+    loop_thread.join();
+    printf("producers=%2d posts=%ld  %.2f Mposts/s  loop iterations=%lld\n",
+        producers, per_producer * producers, per_producer * producers / seconds / 1e6, (long long)iterations);
+}
+
+int main(int argc, char* argv[])
+{
+    long total = argc > 1 ? atol(argv[1]) : 4000000;
+    for (int producers : {1, 4, 16})
+        bench(producers, total);
+    return 0;
+}
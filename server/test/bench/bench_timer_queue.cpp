@@ -0,0 +1,78 @@
+// TimerQueue 基准：在一个 loop 里测
+//   churn - 增删定时器，任意时刻最多 4096 个活着，模拟连接的超时定时器
+//   fire  - 一次加入 N 个已经到期的一次性定时器，直到全部执行完
+//   idle  - 1 秒内只有一个 100ms 的重复定时器时 loop 的迭代次数和 CPU 时间
+// 用法：bench_timer_queue [N]，N 默认 1000000
+#include "network/event_loop.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <sys/resource.h>
+
+using namespace w_network;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void bench_churn_and_fire(int n)
+{
+    EventLoop loop;
+    long fired = 0;
+    loop.run_after(0, [&]() {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<TimerId> ids;
+        ids.reserve(4096);
+        for (int i = 0; i < n; ++i)
+        {
+            ids.push_back(loop.run_after(1000000 + (i * 7919) % 5000000, [&]() { ++fired; }));
+            if (ids.size() == 4096)
+            {
+                for (TimerId& id : ids)
+                    loop.remove(id);
+                ids.clear();
+            }
+        }
+        for (TimerId& id : ids)
+            loop.remove(id);
+        double ms = elapsed_ms(start);
+        printf("churn: add+remove %d timers, %.1f ms, %.0f ns/timer\n", n, ms, ms * 1e6 / n);
+
+        start = std::chrono::steady_clock::now();
+        Timestamp now = Timestamp::now();
+        for (int i = 0; i < n; ++i)
+            loop.run_at(now, [&]() { ++fired; });
+        loop.run_after(1, [&, start]() {
+            printf("fire:  add+fire %d timers, %.1f ms, fired %ld\n", n, elapsed_ms(start), fired);
+            loop.quit();
+        });
+    });
+    loop.loop();
+}
+
+static void bench_idle()
+{
+    EventLoop loop;
+    int ticks = 0;
+    loop.run_every(100 * 1000, [&]() { ++ticks; });
+    loop.run_after(1000 * 1000, [&]() { loop.quit(); });
+
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    loop.loop();
+    getrusage(RUSAGE_SELF, &after);
+
+    long cpu_us = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) * 1000000L + (after.ru_utime.tv_usec - before.ru_utime.tv_usec)
+        + (after.ru_stime.tv_sec - before.ru_stime.tv_sec) * 1000000L + (after.ru_stime.tv_usec - before.ru_stime.tv_usec);
+    printf("idle:  1 s with a 100 ms timer, %d ticks, %lld loop iterations, %ld us cpu\n", ticks, (long long)loop.iteration(), cpu_us);
+}
+
+int main(int argc, char* argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    bench_churn_and_fire(n);
+    bench_idle();
+    return 0;
+}
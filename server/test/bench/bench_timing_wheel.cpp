@@ -0,0 +1,102 @@
+// TimingWheel 基准：在一个 loop 里测
+//   memory - 每个连接嵌入的 TimingWheel::Entry 大小
+//   touch  - N 个节点轮流 touch 的平均耗时
+//   tick   - N 个节点、10ms 一个 tick 跑 1 秒，每个 tick touch N/64 个节点（模拟心跳），
+//            平均每个 tick 的 CPU 时间，包括 timerfd 唤醒和把 touch 过的节点挪到新 slot
+//   expire - 100ms 的 tick 上 300ms 的超时实际多久到期；一直被 touch 的节点不到期
+// 用法：bench_timing_wheel [N]，N 默认 100000
+#include "network/event_loop.h"
+#include "network/timing_wheel.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sys/resource.h>
+
+using namespace w_network;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long cpu_us()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000L + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void bench_touch_and_tick(int n)
+{
+    printf("memory: %zu bytes per entry\n", sizeof(TimingWheel::Entry));
+
+    EventLoop loop;
+    TimingWheel wheel(&loop, 10);
+    std::unique_ptr<TimingWheel::Entry[]> entries(new TimingWheel::Entry[n]);
+    long expired = 0;
+    for (int i = 0; i < n; ++i)
+        wheel.add(&entries[i], 60 * 1000, [&]() { ++expired; });
+
+    const int rounds = 100;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (int i = 0; i < n; ++i)
+            wheel.touch(&entries[i]);
+    }
+    printf("touch:  %.1f ns\n", elapsed_ms(start) * 1e6 / (static_cast<double>(n) * rounds));
+
+    //每个 tick 之后 touch 下一批，每个节点一圈被 touch 一次
+    int next = 0;
+    int batch = n / 64 > 0 ? n / 64 : 1;
+    loop.run_every(10 * 1000, [&]() {
+        for (int i = 0; i < batch; ++i)
+        {
+            wheel.touch(&entries[next]);
+            next = (next + 1) % n;
+        }
+    });
+    loop.run_after(1000 * 1000, [&]() { loop.quit(); });
+
+    int64_t first_tick = wheel.current_tick();
+    long cpu_before = cpu_us();
+    loop.loop();
+    long cpu = cpu_us() - cpu_before;
+    int64_t ticks = wheel.current_tick() - first_tick;
+    printf("tick:   %d entries, %lld ticks in 1 s, %.1f us cpu per tick, expired %ld\n",
+        n, (long long)ticks, ticks > 0 ? static_cast<double>(cpu) / ticks : 0.0, expired);
+
+    for (int i = 0; i < n; ++i)
+        wheel.remove(&entries[i]);
+}
+
+static void bench_expire()
+{
+    EventLoop loop;
+    TimingWheel wheel(&loop, 100);
+    TimingWheel::Entry idle, busy;
+    double fired_ms = -1;
+    bool busy_expired = false;
+
+    auto start = std::chrono::steady_clock::now();
+    wheel.add(&idle, 300, [&]() { fired_ms = elapsed_ms(start); });
+    wheel.add(&busy, 300, [&]() { busy_expired = true; });
+    loop.run_every(100 * 1000, [&]() { wheel.touch(&busy); });
+    loop.run_after(1000 * 1000, [&]() { loop.quit(); });
+    loop.loop();
+
+    printf("expire: 300 ms timeout on a 100 ms tick fired at %.0f ms, touched entry %s\n",
+        fired_ms, busy_expired ? "expired" : "never expired");
+    wheel.remove(&busy);
+}
+
+int main(int argc, char* argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    if (n <= 0)
+        n = 1;
+    bench_touch_and_tick(n);
+    bench_expire();
+    return 0;
+}
@@ -0,0 +1,85 @@
+// 每种消息在线上占多少字节：同样的包体分别用 v1 帧（chat_msg_header，TcpSession::make_frame()）
+// 和 v2 帧（TcpSession::make_frame_v2()）发送，批量的一行是 20 条状态通知连续发 v1 帧
+// 和一个 v2 批量帧（make_batch_frame_v2()）。都按默认压缩级别，小于 getMinCompressSize() 的包体不压缩
+// 用法：bench_wire_size
+#include "network/tcp_session.h"
+#include "common/msg.h"
+#include "log/whisp_log.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace w_network;
+
+static std::string make_login_response()
+{
+    return "{\"code\":0,\"msg\":\"ok\",\"userid\":100023,\"username\":\"13800001234\",\"nickname\":\"zhangsan\","
+        "\"facetype\":0,\"customface\":\"e10adc3949ba59abbe56e057f20f883e\",\"gender\":1,\"birthday\":19900101,"
+        "\"signature\":\"hello world\",\"address\":\"shanghai\",\"phonenumber\":\"13800001234\","
+        "\"mail\":\"zhangsan@example.com\",\"clienttype\":1,\"status\":1}";
+}
+
+//count 个好友，分在两个分组里
+static std::string make_friend_list(int count)
+{
+    std::string s = "{\"code\":0,\"msg\":\"ok\",\"userinfo\":[";
+    for (int team = 0; team < 2; ++team)
+    {
+        s += team == 0 ? "{\"teamname\":\"My Friends\",\"members\":[" : ",{\"teamname\":\"Colleagues\",\"members\":[";
+        for (int i = 0; i < count / 2; ++i)
+        {
+            char buf[320];
+            int id = 100100 + team * 100 + i;
+            snprintf(buf, sizeof(buf),
+                "%s{\"userid\":%d,\"username\":\"138%08d\",\"nickname\":\"friend%d\",\"facetype\":0,"
+                "\"customface\":\"\",\"gender\":%d,\"birthday\":1990%02d%02d,\"signature\":\"signature of %d\","
+                "\"address\":\"beijing\",\"phonenumber\":\"138%08d\",\"mail\":\"friend%d@example.com\","
+                "\"clienttype\":1,\"status\":%d,\"markname\":\"\"}",
+                i == 0 ? "" : ",", id, id, id, i % 2, i % 12 + 1, i % 28 + 1, id, id, id, i % 3 == 0 ? 1 : 0);
+            s += buf;
+        }
+        s += "]}";
+    }
+    s += "]}";
+    return s;
+}
+
+static void print_row(const char* name, size_t payload, size_t v1, size_t v2)
+{
+    printf("%-22s %8zu %8zu %8zu\n", name, payload, v1, v2);
+}
+
+static void print_single(const char* name, int32_t cmd, int32_t seq, const std::string& data)
+{
+    ChainBuffer::Payload v1 = TcpSession::make_frame(cmd, seq, data.data(), static_cast<int32_t>(data.size()));
+    ChainBuffer::Payload v2 = TcpSession::make_frame_v2(cmd, seq, data.data(), static_cast<int32_t>(data.size()));
+    print_row(name, data.size(), v1 ? v1->size() : 0, v2 ? v2->size() : 0);
+}
+
+int main()
+{
+    WhispLog::get_instance().log_set_level(LOG_LEVEL_INFO);
+    printf("%-22s %8s %8s %8s\n", "type", "payload", "v1", "v2");
+
+    std::string status = "{\"type\":3,\"onlinestatus\":1,\"clienttype\":2}";
+    print_single("heartbeat", msg_type_heartbeat, 0, "");
+    print_single("heartbeat seq=123456", msg_type_heartbeat, 123456, "");
+    print_single("userstatuschange", msg_type_userstatuschange, 0, status);
+    print_single("chat (short)", msg_type_chat, 0,
+        "{\"msgType\":1,\"time\":1700000000,\"clientType\":1,\"content\":[{\"msgText\":\"hello\"}]}");
+    print_single("login response", msg_type_login, 0, make_login_response());
+    print_single("friend list (20)", msg_type_getofriendlist, 0, make_friend_list(20));
+
+    //批量：v1 连接收到的是连续的 20 个 v1 帧
+    std::vector<ChatMessageView> msgs;
+    size_t v1_bytes = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+        msgs.push_back(ChatMessageView{ msg_type_userstatuschange, i, status.data(), status.size() });
+        ChainBuffer::Payload v1 = TcpSession::make_frame(msg_type_userstatuschange, i, status.data(), static_cast<int32_t>(status.size()));
+        v1_bytes += v1 ? v1->size() : 0;
+    }
+    ChainBuffer::Payload batch = TcpSession::make_batch_frame_v2(msgs);
+    printf("%-22s %8s %8zu %8zu\n", "20x status, batched", "-", v1_bytes, batch ? batch->size() : 0);
+    return 0;
+}
@@ -0,0 +1,281 @@
+// ZlibUtil 基准
+//   按消息类型 - 按线上比例构造 1 万条消息（心跳、状态通知、短聊天、登录应答、群成员、好友列表），
+//                每种类型 TcpSession::make_frame() 的平均耗时和帧长
+//   按长度     - 15B~64KB 的 JSON，ZlibUtil::compressBuf()（复用线程上下文）和一次性 compress() 的耗时，
+//                以及 uncompressBuf() 的耗时和压缩率
+//   --dict     - 只跑这一项：同样的消息按类型比较一次性 compress()、复用上下文的 compressBuf()
+//                和带预置字典的 compressBuf()，每种的平均压缩后字节数和耗时，并检查字典解压正确。
+//                字典从文件加载（scripts/build_zdict.py 的输出），不给文件时用另一批同分布的消息
+//                拼一个最多 16KB 的字典代替
+// 用法：bench_zlib [迭代倍数] [--dict [字典文件]]，迭代倍数默认 1
+#include "common/zlibutil.h"
+#include "network/tcp_session.h"
+#include "log/whisp_log.h"
+#include "zlib.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace w_network;
+
+static std::string make_json(std::mt19937& rng, size_t n)
+{
+    static const char* keys[] = {"userid", "nickname", "status", "clienttype", "signature", "customface", "msgText", "time"};
+    if (n == 0)
+        return std::string();
+    std::string s = "{";
+    while (s.size() < n)
+    {
+        char buf[96];
+        snprintf(buf, sizeof(buf), "\"%s\":\"%u\",", keys[rng() % 8], static_cast<unsigned>(rng() % 100000));
+        s += buf;
+    }
+    s.resize(n);
+    s.back() = '}';
+    return s;
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct MsgType
+{
+    const char* name;
+    int         cmd;
+    int         percent;
+    size_t      min_len;
+    size_t      max_len;
+};
+
+static const MsgType s_types[] = {
+    {"heartbeat", 1000, 40, 0, 0},
+    {"status", 1006, 20, 40, 70},
+    {"chat", 1100, 25, 80, 400},
+    {"login", 1002, 5, 260, 340},
+    {"members", 1010, 5, 1500, 2500},
+    {"friends", 1003, 5, 4000, 6000},
+};
+
+typedef std::vector<std::pair<const MsgType*, std::string>> Corpus;
+
+//按线上比例构造 n 条消息
+static Corpus make_corpus(std::mt19937& rng, int n)
+{
+    Corpus corpus;
+    for (int i = 0; i < n; ++i)
+    {
+        int r = rng() % 100;
+        for (const MsgType& type : s_types)
+        {
+            if (r < type.percent)
+            {
+                size_t len = type.max_len == 0 ? 0 : type.min_len + rng() % (type.max_len - type.min_len);
+                corpus.push_back(std::make_pair(&type, make_json(rng, len)));
+                break;
+            }
+            r -= type.percent;
+        }
+    }
+    return corpus;
+}
+
+static void bench_types(std::mt19937& rng)
+{
+    Corpus corpus = make_corpus(rng, 10000);
+    for (const MsgType& type : s_types)
+    {
+        double ns = 0;
+        size_t bytes = 0;
+        int count = 0;
+        for (const auto& msg : corpus)
+        {
+            if (msg.first != &type)
+                continue;
+            auto start = std::chrono::steady_clock::now();
+            ChainBuffer::Payload frame = TcpSession::make_frame(type.cmd, 0, msg.second.data(), msg.second.size());
+            ns += elapsed_ns(start);
+            bytes += frame->size();
+            ++count;
+        }
+        printf("%-10s n=%5d  %7.0f ns/msg  %6.0f B/msg\n", type.name, count, ns / count, static_cast<double>(bytes) / count);
+    }
+}
+
+//用另一批消息拼一个字典，每种类型按比例放几条，常见的放在后面（离要压缩的数据近，引用距离短）
+static std::string make_training_dict(std::mt19937& rng)
+{
+    Corpus sample = make_corpus(rng, 2000);
+    std::string dict;
+    for (int t = static_cast<int>(sizeof(s_types) / sizeof(s_types[0])) - 1; t >= 0; --t)
+    {
+        size_t quota = dict.size() + 16 * 1024 * s_types[t].percent / 100;
+        for (const auto& msg : sample)
+        {
+            if (msg.first == &s_types[t] && dict.size() + msg.second.size() <= quota)
+                dict += msg.second;
+        }
+    }
+    return dict;
+}
+
+static void bench_dict(std::mt19937& rng, uint32_t dict_id, int scale)
+{
+    Corpus corpus = make_corpus(rng, 10000);
+    printf("%-10s %5s %6s | %-22s | %-22s | %s\n", "type", "n", "raw B", "compress()", "compressBuf reused", "compressBuf dict");
+    for (const MsgType& type : s_types)
+    {
+        std::vector<const std::string*> msgs;
+        size_t raw = 0;
+        for (const auto& msg : corpus)
+        {
+            if (msg.first == &type && !msg.second.empty())
+            {
+                msgs.push_back(&msg.second);
+                raw += msg.second.size();
+            }
+        }
+        if (msgs.empty())
+            continue;
+
+        int iters = 0;
+        size_t once_bytes = 0, reuse_bytes = 0, dict_bytes = 0;
+        double once_ns = 0, reuse_ns = 0, dict_ns = 0;
+        bool ok = true;
+        std::string once;
+        std::string dst;
+        std::string back;
+        for (int round = 0; round < scale; ++round)
+        {
+            for (const std::string* msg : msgs)
+            {
+                ++iters;
+                once.resize(compressBound(msg->size()));
+                uLongf len = once.size();
+                auto start = std::chrono::steady_clock::now();
+                ::compress(reinterpret_cast<Bytef*>(&once[0]), &len, reinterpret_cast<const Bytef*>(msg->data()), msg->size());
+                once_ns += elapsed_ns(start);
+                once_bytes += len;
+
+                dst.clear();
+                start = std::chrono::steady_clock::now();
+                ZlibUtil::compressBuf(msg->data(), msg->size(), dst);
+                reuse_ns += elapsed_ns(start);
+                reuse_bytes += dst.size();
+
+                dst.clear();
+                start = std::chrono::steady_clock::now();
+                ok = ZlibUtil::compressBuf(msg->data(), msg->size(), dst, dict_id) && ok;
+                dict_ns += elapsed_ns(start);
+                dict_bytes += dst.size();
+
+                back.clear();
+                ok = ZlibUtil::uncompressBuf(dst.data(), dst.size(), back, msg->size()) && back == *msg && ok;
+            }
+        }
+
+        double n = iters;
+        printf("%-10s %5d %6.0f | %5.0f B %.2f %6.0f ns | %5.0f B %.2f %6.0f ns | %5.0f B %.2f %6.0f ns%s\n",
+            type.name, static_cast<int>(msgs.size()), static_cast<double>(raw) / msgs.size(),
+            once_bytes / n, once_bytes / n * msgs.size() / raw, once_ns / n,
+            reuse_bytes / n, reuse_bytes / n * msgs.size() / raw, reuse_ns / n,
+            dict_bytes / n, dict_bytes / n * msgs.size() / raw, dict_ns / n,
+            ok ? "" : "  roundtrip FAILED");
+    }
+}
+
+static void bench_sizes(std::mt19937& rng, int scale)
+{
+    for (size_t n : {15, 64, 256, 1024, 4096, 65536})
+    {
+        std::string src = make_json(rng, n);
+        std::string dst;
+        std::string back;
+        int iters = (n > 4096 ? 2000 : 20000) * scale;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iters; ++i)
+        {
+            dst.clear();
+            ZlibUtil::compressBuf(src, dst);
+        }
+        double reuse_ns = elapsed_ns(start) / iters;
+
+        std::string once(compressBound(n), '\0');
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iters; ++i)
+        {
+            uLongf len = once.size();
+            ::compress(reinterpret_cast<Bytef*>(&once[0]), &len, reinterpret_cast<const Bytef*>(src.data()), src.size());
+        }
+        double once_ns = elapsed_ns(start) / iters;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iters; ++i)
+        {
+            back.clear();
+            ZlibUtil::uncompressBuf(dst, back, src.size());
+        }
+        double uncompress_ns = elapsed_ns(start) / iters;
+
+        printf("%6zu B: compressBuf %7.0f ns, compress() %7.0f ns, uncompressBuf %6.0f ns, ratio %.2f, roundtrip %s\n",
+            n, reuse_ns, once_ns, uncompress_ns, static_cast<double>(dst.size()) / n, back == src ? "ok" : "FAILED");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int scale = 1;
+    bool dict = false;
+    const char* dict_file = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--dict") == 0)
+        {
+            dict = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && atoi(argv[i + 1]) == 0)
+                dict_file = argv[++i];
+        }
+        else
+        {
+            scale = atoi(argv[i]);
+        }
+    }
+    if (scale <= 0)
+        scale = 1;
+
+    WhispLog::get_instance().log_set_level(LOG_LEVEL_INFO);
+    std::mt19937 rng(11);
+    if (dict)
+    {
+        uint32_t dict_id = 0;
+        if (dict_file != nullptr)
+        {
+            if (!ZlibUtil::loadDictionary(dict_file, dict_id))
+            {
+                printf("failed to load dictionary %s\n", dict_file);
+                return 1;
+            }
+            printf("dictionary %s, id %u\n", dict_file, dict_id);
+        }
+        else
+        {
+            std::mt19937 train_rng(29);
+            std::string trained = make_training_dict(train_rng);
+            dict_id = ZlibUtil::addDictionary(trained);
+            printf("dictionary built from sample messages, %zu bytes, id %u\n", trained.size(), dict_id);
+        }
+        bench_dict(rng, dict_id, scale);
+        return 0;
+    }
+
+    bench_types(rng);
+    bench_sizes(rng, scale);
+    return 0;
+}
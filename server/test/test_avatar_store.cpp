@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "util/avatar_store.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+class AvatarStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::string tmpl = ::testing::TempDir() + "avatar_store_XXXXXX";
+        ASSERT_NE(::mkdtemp(&tmpl[0]), nullptr);
+        root_ = tmpl;
+    }
+
+    void TearDown() override {
+        std::string cmd = "rm -rf '" + root_ + "'";
+        ASSERT_EQ(::system(cmd.c_str()), 0);
+    }
+
+    static std::string read_all(const AvatarStore::FilePtr& file) {
+        std::string data(file->size(), '\0');
+        EXPECT_EQ(::pread(file->fd(), &data[0], data.size(), 0), static_cast<ssize_t>(data.size()));
+        return data;
+    }
+
+    // 目录里所有文件名，包括子目录里的
+    std::vector<std::string> list_files() {
+        std::vector<std::string> names;
+        DIR* root = ::opendir(root_.c_str());
+        while (struct dirent* sub = ::readdir(root)) {
+            if (sub->d_name[0] == '.') {
+                continue;
+            }
+            std::string dir = root_ + "/" + sub->d_name;
+            DIR* d = ::opendir(dir.c_str());
+            while (struct dirent* entry = ::readdir(d)) {
+                if (entry->d_name[0] != '.') {
+                    names.push_back(entry->d_name);
+                }
+            }
+            ::closedir(d);
+        }
+        ::closedir(root);
+        return names;
+    }
+
+    std::string root_;
+};
+
+// 测试按内容的 md5 保存，取出来的文件和原内容相同
+TEST_F(AvatarStoreTest, PutThenGet) {
+    AvatarStore store(root_);
+    ASSERT_TRUE(store.init());
+
+    std::string data(5000, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i * 7);
+    }
+    std::string md5 = store.put(data);
+    EXPECT_EQ(md5, AvatarStore::md5_hex(data.data(), data.size()));
+    EXPECT_EQ(AvatarStore::md5_hex("", 0), "d41d8cd98f00b204e9800998ecf8427e");
+    EXPECT_TRUE(store.exists(md5));
+
+    AvatarStore::FilePtr file = store.get(md5);
+    ASSERT_TRUE(file);
+    EXPECT_EQ(file->md5(), md5);
+    EXPECT_EQ(file->size(), data.size());
+    EXPECT_EQ(read_all(file), data);
+    EXPECT_EQ(store.get(md5), file);
+    EXPECT_EQ(store.open_count(), 1u);
+
+    // 相同内容只存一份，不留临时文件
+    EXPECT_EQ(store.put(data), md5);
+    EXPECT_EQ(list_files(), std::vector<std::string>({md5}));
+}
+
+// 测试多个线程同时保存同一个头像，文件完整，没有残留的临时文件
+TEST_F(AvatarStoreTest, ConcurrentPutsOfSameContent) {
+    AvatarStore store(root_);
+    ASSERT_TRUE(store.init());
+    std::string data(256 * 1024, 'q');
+    std::string expected = AvatarStore::md5_hex(data.data(), data.size());
+
+    std::vector<std::string> results(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < results.size(); ++i) {
+        threads.emplace_back([&store, &results, i]() {
+            std::string copy(256 * 1024, 'q');
+            results[i] = store.put(copy);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (const std::string& md5 : results) {
+        EXPECT_EQ(md5, expected);
+    }
+    AvatarStore::FilePtr file = store.get(expected);
+    ASSERT_TRUE(file);
+    EXPECT_EQ(read_all(file), data);
+    EXPECT_EQ(list_files(), std::vector<std::string>({expected}));
+}
+
+// 测试不合法的 md5 和不存在的头像
+TEST_F(AvatarStoreTest, RejectsBadNames) {
+    AvatarStore store(root_);
+    ASSERT_TRUE(store.init());
+    std::string md5 = store.put("avatar");
+    ASSERT_FALSE(md5.empty());
+
+    std::string upper = md5;
+    for (char& c : upper) {
+        c = static_cast<char>(toupper(c));
+    }
+    for (const std::string& bad : {std::string(), md5.substr(1), md5 + "0", upper,
+                                   std::string("../../../../../../etc/passwd"),
+                                   std::string(30, '.') + "/x", md5.substr(0, 31) + "g"}) {
+        EXPECT_FALSE(store.get(bad)) << bad;
+        EXPECT_FALSE(store.exists(bad)) << bad;
+    }
+
+    std::string missing(32, '0');
+    EXPECT_FALSE(store.get(missing));
+    EXPECT_FALSE(store.exists(missing));
+    EXPECT_EQ(store.open_count(), 0u);
+}
+
+// 测试 LRU 淘汰：最久没用的先关，正在发送的连接还引用着时 fd 不关
+TEST_F(AvatarStoreTest, LruEvictionKeepsFilesInUse) {
+    AvatarStore store(root_, 2);
+    ASSERT_TRUE(store.init());
+    std::string a = store.put("avatar a");
+    std::string b = store.put("avatar b");
+    std::string c = store.put("avatar c");
+
+    // 正在发送 a
+    AvatarStore::FilePtr sending = store.get(a);
+    ASSERT_TRUE(sending);
+    AvatarStore::FilePtr file_b = store.get(b);
+    file_b.reset();
+    // 用一次 a，b 就成了最久没用的
+    EXPECT_EQ(store.get(a), sending);
+    ASSERT_TRUE(store.get(c));
+    EXPECT_EQ(store.open_count(), 2u);
+    EXPECT_EQ(store.get(a), sending);
+
+    // 再打开 b，淘汰 c，然后淘汰 a；a 被淘汰出索引后发送还能继续
+    ASSERT_TRUE(store.get(b));
+    AvatarStore::FilePtr file_c = store.get(c);
+    ASSERT_TRUE(file_c);
+    EXPECT_EQ(store.open_count(), 2u);
+    EXPECT_NE(::fcntl(sending->fd(), F_GETFD), -1);
+    EXPECT_EQ(read_all(sending), "avatar a");
+
+    // 重新取 a 打开的是新的 fd
+    AvatarStore::FilePtr again = store.get(a);
+    ASSERT_TRUE(again);
+    EXPECT_NE(again, sending);
+    EXPECT_NE(again->fd(), sending->fd());
+
+    // 最后一个引用释放时关闭
+    int fd = sending->fd();
+    sending.reset();
+    EXPECT_EQ(::fcntl(fd, F_GETFD), -1);
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "network/byte_buffer.h"
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace w_network;
+
+class ByteBufferTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+    }
+
+    void TearDown() override {
+        ::close(fds_[0]);
+        ::close(fds_[1]);
+    }
+
+    // 往对端写 n 个字节，内容是按位置递增的字符，返回写入的内容
+    std::string feed(size_t n) {
+        std::string data(n, '\0');
+        for (size_t i = 0; i < n; ++i) {
+            data[i] = static_cast<char>('a' + (sent_ + i) % 26);
+        }
+        sent_ += n;
+        size_t off = 0;
+        while (off < n) {
+            ssize_t w = ::write(fds_[1], data.data() + off, n - off);
+            if (w <= 0) {
+                ADD_FAILURE() << "write failed";
+                break;
+            }
+            off += w;
+        }
+        return data;
+    }
+
+    int32_t read(ByteBuffer* buf) {
+        int saved_errno = 0;
+        return buf->bb_read_fd(fds_[0], &saved_errno);
+    }
+
+    int fds_[2];
+    size_t sent_ = 0;
+};
+
+// 测试超过可写空间的数据先读到栈上再补进来，顺序不乱
+TEST_F(ByteBufferTest, ReadvOverflowsIntoStackBuffer) {
+    ByteBuffer buf;
+    std::string data = feed(50000);
+    size_t got = 0;
+    while (got < data.size()) {
+        int32_t n = read(&buf);
+        ASSERT_GT(n, 0);
+        got += n;
+    }
+    EXPECT_EQ(buf.bb_retrieve_all_as_string(), data);
+}
+
+// 测试读满预留空间时 hint 加倍到上限，连续两次读不到一半才减半
+TEST_F(ByteBufferTest, ReadHintGrowsAndDecays) {
+    ByteBuffer buf;
+    EXPECT_EQ(buf.bb_read_hint(), ByteBuffer::initial_size);
+
+    size_t expected = ByteBuffer::initial_size;
+    while (expected < ByteBuffer::max_read_hint) {
+        feed(buf.bb_read_hint());
+        ASSERT_EQ(read(&buf), static_cast<int32_t>(expected));
+        expected *= 2;
+        EXPECT_EQ(buf.bb_read_hint(), expected);
+        buf.bb_retrieve_all();
+    }
+    feed(ByteBuffer::max_read_hint);
+    read(&buf);
+    EXPECT_EQ(buf.bb_read_hint(), ByteBuffer::max_read_hint);
+    buf.bb_retrieve_all();
+
+    // 一次小包不减，连续两次才减半
+    feed(100);
+    read(&buf);
+    EXPECT_EQ(buf.bb_read_hint(), ByteBuffer::max_read_hint);
+    feed(100);
+    read(&buf);
+    EXPECT_EQ(buf.bb_read_hint(), ByteBuffer::max_read_hint / 2);
+
+    // 大小交替时不减
+    feed(30000);
+    read(&buf);
+    feed(100);
+    read(&buf);
+    EXPECT_EQ(buf.bb_read_hint(), ByteBuffer::max_read_hint / 2);
+
+    // 最多减到 initial_size
+    for (int i = 0; i < 40; ++i) {
+        feed(10);
+        read(&buf);
+    }
+    EXPECT_EQ(buf.bb_read_hint(), ByteBuffer::initial_size);
+}
+
+// 测试数据都取走之后，突发时扩大的缓冲区缩回去
+TEST_F(ByteBufferTest, EmptyOversizedBufferShrinks) {
+    ByteBuffer buf;
+    buf.bb_append(std::string(1 << 20, 'x'));
+    buf.bb_retrieve_all();
+    EXPECT_GE(buf.bb_internal_capacity(), 1u << 20);
+
+    std::string data = feed(10);
+    ASSERT_EQ(read(&buf), 10);
+    EXPECT_LT(buf.bb_internal_capacity(), 64u * 1024);
+    EXPECT_EQ(buf.bb_retrieve_all_as_string(), data);
+}
+
+// 测试半个帧留在缓冲区里时，为整个帧预留的空间不会被缩掉，慢速链路上的小段数据直接读进去
+TEST_F(ByteBufferTest, PendingFrameKeepsReservation) {
+    ByteBuffer buf;
+    std::string data = feed(1400);
+    ASSERT_EQ(read(&buf), 1400);
+    buf.bb_bytes_check_writable(100 * 1024);
+    const char* begin = buf.bb_peek();
+    size_t capacity = buf.bb_internal_capacity();
+
+    for (int i = 0; i < 70; ++i) {
+        data += feed(1400);
+        ASSERT_EQ(read(&buf), 1400);
+        ASSERT_EQ(buf.bb_peek(), begin) << i;
+        ASSERT_EQ(buf.bb_internal_capacity(), capacity) << i;
+    }
+    EXPECT_EQ(buf.bb_retrieve_all_as_string(), data);
+}
+
+// 测试对端关闭时返回 0
+TEST_F(ByteBufferTest, ReadReturnsZeroOnClose) {
+    ByteBuffer buf;
+    ::shutdown(fds_[1], SHUT_WR);
+    EXPECT_EQ(read(&buf), 0);
+    EXPECT_EQ(buf.bb_bytes_readable(), 0u);
+}
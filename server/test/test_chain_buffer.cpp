@@ -0,0 +1,254 @@
+#include <gtest/gtest.h>
+#include "network/chain_buffer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace w_network;
+
+class ChainBufferTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_), 0);
+        ASSERT_EQ(::fcntl(fds_[0], F_SETFL, O_NONBLOCK), 0);
+        ASSERT_EQ(::fcntl(fds_[1], F_SETFL, O_NONBLOCK), 0);
+        // 发送缓冲设小，大块数据一次写不完
+        int sndbuf = 4096;
+        ASSERT_EQ(::setsockopt(fds_[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf), 0);
+    }
+
+    void TearDown() override {
+        ::close(fds_[0]);
+        ::close(fds_[1]);
+        for (int fd : files_) {
+            ::close(fd);
+        }
+    }
+
+    // 内容按位置递增的数据，seed 不同内容不同
+    static std::string make_data(size_t n, int seed) {
+        std::string data(n, '\0');
+        for (size_t i = 0; i < n; ++i) {
+            data[i] = static_cast<char>(seed + i * 13 + i / 251);
+        }
+        return data;
+    }
+
+    // 创建一个内容为 data 的临时文件，返回 fd
+    int make_file(const std::string& data) {
+        std::string path = ::testing::TempDir() + "chain_buffer_XXXXXX";
+        int fd = ::mkstemp(&path[0]);
+        EXPECT_GE(fd, 0);
+        ::unlink(path.c_str());
+        EXPECT_EQ(::write(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+        files_.push_back(fd);
+        return fd;
+    }
+
+    int32_t write(ChainBuffer* buf, int* saved_errno) {
+        *saved_errno = 0;
+        return buf->cb_write_fd(fds_[0], saved_errno);
+    }
+
+    // 读出对端现有的全部数据
+    std::string drain() {
+        std::string data;
+        char buf[65536];
+        ssize_t n;
+        while ((n = ::read(fds_[1], buf, sizeof buf)) > 0) {
+            data.append(buf, n);
+        }
+        return data;
+    }
+
+    // 反复写到队列为空，返回对端收到的数据
+    std::string pump(ChainBuffer* buf) {
+        std::string received;
+        while (buf->cb_bytes_readable() > 0) {
+            int saved_errno;
+            size_t before = buf->cb_bytes_readable();
+            int32_t n = write(buf, &saved_errno);
+            if (n < 0) {
+                EXPECT_EQ(saved_errno, EAGAIN);
+                if (saved_errno != EAGAIN) {
+                    break;
+                }
+            } else {
+                EXPECT_EQ(buf->cb_bytes_readable(), before - n);
+            }
+            received += drain();
+        }
+        received += drain();
+        return received;
+    }
+
+    int fds_[2];
+    std::vector<int> files_;
+};
+
+// 测试内存块、文件块交替入队，发出去的字节顺序和入队顺序一致
+TEST_F(ChainBufferTest, MemoryAndFileChunksKeepOrder) {
+    std::string file_data = make_data(100000, 1);
+    int file_fd = make_file(file_data);
+
+    ChainBuffer buf;
+    std::string expected;
+    auto add_memory = [&](const std::string& data) {
+        buf.cb_append(data.data(), data.size());
+        expected += data;
+    };
+    auto add_file = [&](int64_t offset, size_t len) {
+        buf.cb_append_file(file_fd, offset, len);
+        expected += file_data.substr(offset, len);
+    };
+
+    add_memory("header");
+    add_file(0, 30000);
+    add_memory(make_data(20000, 2));
+    add_file(30000, 7);
+    add_file(50000, 50000);
+    std::string moved = make_data(9000, 3);
+    expected += moved.substr(100);
+    buf.cb_append(std::move(moved), 100);
+    auto payload = std::make_shared<const std::string>(make_data(6000, 4));
+    buf.cb_append(payload);
+    expected += *payload;
+    add_memory("tail");
+
+    EXPECT_EQ(buf.cb_bytes_readable(), expected.size());
+    EXPECT_EQ(pump(&buf), expected);
+    EXPECT_EQ(buf.cb_chunk_count(), 0u);
+    EXPECT_EQ(buf.cb_bytes_in_memory(), 0u);
+}
+
+// 测试块数超过 IOV_MAX 时分多次 writev，数据不丢不乱
+TEST_F(ChainBufferTest, MoreChunksThanIovMax) {
+    ChainBuffer buf;
+    std::string expected;
+    const size_t count = IOV_MAX * 2 + 100;
+    for (size_t i = 0; i < count; ++i) {
+        auto payload = std::make_shared<const std::string>(make_data(ChainBuffer::copy_threshold + 1 + i % 7, static_cast<int>(i)));
+        buf.cb_append(payload);
+        expected += *payload;
+    }
+    EXPECT_EQ(buf.cb_chunk_count(), count);
+    EXPECT_EQ(pump(&buf), expected);
+}
+
+// 测试 writev 只写了一部分时，剩下的从断开的位置继续写
+TEST_F(ChainBufferTest, PartialWritevResumes) {
+    ChainBuffer buf;
+    std::string expected = make_data(300000, 5);
+    buf.cb_append(expected.substr(0, 100000));
+    buf.cb_append(expected.substr(100000, 100000));
+    buf.cb_append(expected.substr(200000));
+
+    int saved_errno;
+    int32_t n = write(&buf, &saved_errno);
+    ASSERT_GT(n, 0);
+    ASSERT_LT(static_cast<size_t>(n), expected.size());
+    EXPECT_EQ(buf.cb_bytes_readable(), expected.size() - n);
+
+    // 对端还没读，再写就是 EAGAIN，队列不变
+    EXPECT_EQ(write(&buf, &saved_errno), -1);
+    EXPECT_EQ(saved_errno, EAGAIN);
+    EXPECT_EQ(buf.cb_bytes_readable(), expected.size() - n);
+
+    EXPECT_EQ(drain() + pump(&buf), expected);
+}
+
+// 测试 sendfile 只发了一部分时，剩下的从文件里接着发
+TEST_F(ChainBufferTest, PartialSendfileResumes) {
+    std::string file_data = make_data(500000, 6);
+    int file_fd = make_file(file_data);
+
+    ChainBuffer buf;
+    buf.cb_append_file(file_fd, 1000, 400000);
+    buf.cb_append("after", 5);
+
+    int saved_errno;
+    int32_t n = write(&buf, &saved_errno);
+    ASSERT_GT(n, 0);
+    ASSERT_LT(n, 400000);
+    EXPECT_EQ(buf.cb_bytes_readable(), 400005u - n);
+    EXPECT_EQ(drain() + pump(&buf), file_data.substr(1000, 400000) + "after");
+}
+
+// 测试文件比入队时短：能发的先发完，之后返回 EIO，不会一直空转
+TEST_F(ChainBufferTest, ShortFileFailsWithEio) {
+    std::string file_data = make_data(1000, 7);
+    int file_fd = make_file(file_data);
+
+    ChainBuffer buf;
+    buf.cb_append("head", 4);
+    buf.cb_append_file(file_fd, 0, 2000);
+    buf.cb_append("tail", 4);
+
+    int saved_errno;
+    EXPECT_EQ(write(&buf, &saved_errno), 1004);
+    EXPECT_EQ(buf.cb_bytes_readable(), 1004u);
+    EXPECT_EQ(write(&buf, &saved_errno), -1);
+    EXPECT_EQ(saved_errno, EIO);
+    EXPECT_EQ(buf.cb_bytes_readable(), 1004u);
+    EXPECT_EQ(drain(), "head" + file_data);
+}
+
+// 测试高水位用到的统计：文件块不算内存，跨块取走时两个计数都正确
+TEST_F(ChainBufferTest, MemoryAccountingAcrossChunks) {
+    std::string file_data = make_data(10000, 8);
+    int file_fd = make_file(file_data);
+
+    ChainBuffer buf;
+    buf.cb_append(make_data(5000, 9));
+    buf.cb_append_file(file_fd, 0, 10000);
+    buf.cb_append("small", 5);
+    buf.cb_append_file(file_fd, 100, 3000);
+    buf.cb_append(make_data(8000, 10));
+    EXPECT_EQ(buf.cb_bytes_readable(), 26005u);
+    EXPECT_EQ(buf.cb_bytes_in_memory(), 13005u);
+
+    // 取走第一块内存和半个文件块
+    buf.cb_retrieve(10000);
+    EXPECT_EQ(buf.cb_bytes_readable(), 16005u);
+    EXPECT_EQ(buf.cb_bytes_in_memory(), 8005u);
+
+    // 取到第二个文件块中间
+    buf.cb_retrieve(6000);
+    EXPECT_EQ(buf.cb_bytes_readable(), 10005u);
+    EXPECT_EQ(buf.cb_bytes_in_memory(), 8000u);
+
+    // 写的时候同样更新
+    EXPECT_EQ(pump(&buf), file_data.substr(1095, 2005) + make_data(8000, 10));
+    EXPECT_EQ(buf.cb_bytes_readable(), 0u);
+    EXPECT_EQ(buf.cb_bytes_in_memory(), 0u);
+
+    buf.cb_append_file(file_fd, 0, 100);
+    buf.cb_append("x", 1);
+    buf.cb_retrieve_all();
+    EXPECT_EQ(buf.cb_bytes_readable(), 0u);
+    EXPECT_EQ(buf.cb_bytes_in_memory(), 0u);
+}
+
+// 测试文件块发完之前一直引用 owner，发完就释放
+TEST_F(ChainBufferTest, FileOwnerReleasedAfterSend) {
+    std::string file_data = make_data(200000, 11);
+    int file_fd = make_file(file_data);
+    auto owner = std::make_shared<int>(file_fd);
+    std::weak_ptr<int> weak = owner;
+
+    ChainBuffer buf;
+    buf.cb_append_file(file_fd, 0, file_data.size(), owner);
+    owner.reset();
+
+    int saved_errno;
+    ASSERT_GT(write(&buf, &saved_errno), 0);
+    EXPECT_FALSE(weak.expired());
+    EXPECT_EQ(drain() + pump(&buf), file_data);
+    EXPECT_TRUE(weak.expired());
+}
@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+#include "network/chat_frame_codec.h"
+#include "network/tcp_session.h"
+#include "common/zlibutil.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace w_network;
+
+class ChatFrameCodecTest : public ::testing::Test {
+protected:
+    ChatFrameCodecTest() : codec_([](const TcpConnectionPtr&, const ChatFrame&, Timestamp) {}) {}
+
+    static std::string v1_header(char compressflag, int32_t originsize, int32_t compresssize) {
+        chat_msg_header header;
+        memset(&header, 0, sizeof(header));
+        header.compressflag = compressflag;
+        header.originsize = originsize;
+        header.compresssize = compresssize;
+        return std::string(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    // 把 data 里的帧依次解出来，遇到不完整或者不合法的帧就停下
+    std::vector<ChatFrame> decode_all(const std::string& data, ChatFrameCodec::DecodeResult* last) {
+        std::vector<ChatFrame> frames;
+        size_t offset = 0;
+        while (offset < data.size()) {
+            ChatFrame frame;
+            size_t n = 0;
+            const char* reason = nullptr;
+            *last = codec_.decode(data.data() + offset, data.size() - offset, &frame, &n, &reason);
+            if (*last != ChatFrameCodec::kFrame) {
+                return frames;
+            }
+            frames.push_back(frame);
+            offset += n;
+        }
+        *last = ChatFrameCodec::kFrame;
+        return frames;
+    }
+
+    ChatFrameCodec::DecodeResult decode(const std::string& data, size_t* n, const char** reason) {
+        ChatFrame frame;
+        *reason = nullptr;
+        return codec_.decode(data.data(), data.size(), &frame, n, reason);
+    }
+
+    ChatFrameCodec codec_;
+};
+
+// 测试不压缩的 v1 帧
+TEST_F(ChatFrameCodecTest, DecodesUncompressedV1Frame) {
+    std::string body = "hello talko";
+    ChainBuffer::Payload package = TcpSession::make_frame(body.data(), body.size(), 0, 0);
+    ASSERT_TRUE(package);
+
+    ChatFrame frame;
+    size_t n = 0;
+    const char* reason = nullptr;
+    ASSERT_EQ(codec_.decode(package->data(), package->size(), &frame, &n, &reason), ChatFrameCodec::kFrame);
+    EXPECT_EQ(n, package->size());
+    EXPECT_EQ(frame.version, 1);
+    EXPECT_FALSE(frame.batch);
+    EXPECT_EQ(frame.compressflag, PACKAGE_UNCOMPRESSED);
+    EXPECT_EQ(frame.originsize, static_cast<int32_t>(body.size()));
+    EXPECT_EQ(frame.dictid, 0u);
+    EXPECT_EQ(frame.reserved, package->data() + offsetof(chat_msg_header, reserved));
+    EXPECT_EQ(std::string(frame.body, frame.body_len), body);
+}
+
+// 测试压缩的 v1 帧解压后和原包体相同
+TEST_F(ChatFrameCodecTest, DecodesCompressedV1Frame) {
+    std::string body(4096, 'x');
+    ChainBuffer::Payload package = TcpSession::make_frame(body.data(), body.size());
+    ASSERT_TRUE(package);
+
+    ChatFrame frame;
+    size_t n = 0;
+    const char* reason = nullptr;
+    ASSERT_EQ(codec_.decode(package->data(), package->size(), &frame, &n, &reason), ChatFrameCodec::kFrame);
+    EXPECT_EQ(frame.compressflag, PACKAGE_COMPRESSED);
+    EXPECT_EQ(frame.originsize, 4096);
+    EXPECT_EQ(frame.body_len, static_cast<size_t>(frame.compresssize));
+    EXPECT_LT(frame.body_len, body.size());
+
+    std::string origin;
+    ASSERT_TRUE(ZlibUtil::uncompressBuf(frame.body, frame.body_len, origin, frame.originsize));
+    EXPECT_EQ(origin, body);
+}
+
+// 测试每种长度的不完整帧都返回 kNeedMore，并且给出整个帧至少要多少字节
+TEST_F(ChatFrameCodecTest, PartialFramesNeedMore) {
+    std::string body(300, 'p');
+    ChainBuffer::Payload v1 = TcpSession::make_frame(body.data(), body.size(), 0, 0);
+    ChainBuffer::Payload v2 = TcpSession::make_frame_v2(7, 8, body.data(), body.size(), 0);
+    ASSERT_TRUE(v1);
+    ASSERT_TRUE(v2);
+
+    for (size_t len = 0; len < v1->size(); ++len) {
+        size_t needed = 0;
+        const char* reason = nullptr;
+        ASSERT_EQ(decode(v1->substr(0, len), &needed, &reason), ChatFrameCodec::kNeedMore) << len;
+        ASSERT_EQ(needed, len < ChatFrameCodec::header_len ? ChatFrameCodec::header_len : v1->size()) << len;
+    }
+    for (size_t len = 1; len < v2->size(); ++len) {
+        size_t needed = 0;
+        const char* reason = nullptr;
+        ASSERT_EQ(decode(v2->substr(0, len), &needed, &reason), ChatFrameCodec::kNeedMore) << len;
+        ASSERT_GT(needed, len) << len;
+        ASSERT_LE(needed, v2->size()) << len;
+    }
+}
+
+// 测试包体超过 max_body 或者协议上限
+TEST_F(ChatFrameCodecTest, OversizeFramesAreBad) {
+    size_t n = 0;
+    const char* reason = nullptr;
+    EXPECT_EQ(decode(v1_header(PACKAGE_COMPRESSED, 100, BINARY_PACKAGE_MAXLEN_2 + 1), &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "body too large");
+    EXPECT_EQ(decode(v1_header(PACKAGE_UNCOMPRESSED, BINARY_PACKAGE_MAXLEN_2 + 1, 0), &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "invalid originsize");
+
+    ChatFrameCodec small([](const TcpConnectionPtr&, const ChatFrame&, Timestamp) {}, 1024);
+    std::string body(2048, 's');
+    ChatFrame frame;
+    ChainBuffer::Payload v1 = TcpSession::make_frame(body.data(), body.size(), 0, 0);
+    ASSERT_EQ(small.decode(v1->data(), v1->size(), &frame, &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "body too large");
+    ChainBuffer::Payload v2 = TcpSession::make_frame_v2(1, 1, body.data(), body.size(), 0);
+    ASSERT_EQ(small.decode(v2->data(), v2->size(), &frame, &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "body too large");
+
+    // 只收到包头也能判断出来，不用等包体
+    std::string header = v1->substr(0, ChatFrameCodec::header_len);
+    EXPECT_EQ(small.decode(header.data(), header.size(), &frame, &n, &reason), ChatFrameCodec::kBadFrame);
+}
+
+// 测试不合法的压缩标志、负的长度和过长的 7bit 长度
+TEST_F(ChatFrameCodecTest, BadFlagsAndLengthsAreBad) {
+    size_t n = 0;
+    const char* reason = nullptr;
+    EXPECT_EQ(decode(v1_header(2, 10, 10), &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "invalid compressflag");
+    EXPECT_EQ(decode(v1_header(PACKAGE_UNCOMPRESSED, -1, 0), &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "invalid originsize");
+    EXPECT_EQ(decode(v1_header(PACKAGE_COMPRESSED, 10, -1), &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "body too large");
+
+    // v2 帧长度最多 5 个字节
+    std::string v2(1, static_cast<char>(CHAT_FRAME_V2_MAGIC));
+    v2.append(5, static_cast<char>(0x80));
+    EXPECT_EQ(decode(v2, &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "invalid length");
+
+    // v2 压缩帧的压缩前大小超过上限
+    std::string compressed(1, static_cast<char>(CHAT_FRAME_V2_MAGIC | CHAT_FRAME_V2_COMPRESSED));
+    compressed += static_cast<char>(6);
+    compressed += "\xff\xff\xff\xff\x0f";
+    compressed += 'z';
+    EXPECT_EQ(decode(compressed, &n, &reason), ChatFrameCodec::kBadFrame);
+    EXPECT_STREQ(reason, "invalid originsize");
+}
+
+// 测试同一段数据里 v1、v2 单条、v2 批量帧混在一起
+TEST_F(ChatFrameCodecTest, MixedV1AndV2Frames) {
+    std::string small = "status";
+    std::string large(2000, 'L');
+    std::vector<ChatMessageView> batch_msgs = {
+        {1001, 1, small.data(), small.size()},
+        {1002, -1, large.data(), large.size()},
+    };
+
+    std::string stream;
+    stream += *TcpSession::make_frame(small.data(), small.size(), 0, 0);
+    stream += *TcpSession::make_frame_v2(1003, 42, small.data(), small.size(), 0);
+    stream += *TcpSession::make_frame(large.data(), large.size());
+    stream += *TcpSession::make_batch_frame_v2(batch_msgs, 0);
+    stream += *TcpSession::make_frame_v2(1004, 43, large.data(), large.size());
+
+    ChatFrameCodec::DecodeResult last;
+    std::vector<ChatFrame> frames = decode_all(stream, &last);
+    EXPECT_EQ(last, ChatFrameCodec::kFrame);
+    ASSERT_EQ(frames.size(), 5u);
+
+    EXPECT_EQ(frames[0].version, 1);
+    EXPECT_EQ(std::string(frames[0].body, frames[0].body_len), small);
+
+    EXPECT_EQ(frames[1].version, 2);
+    EXPECT_FALSE(frames[1].batch);
+    EXPECT_EQ(frames[1].compressflag, PACKAGE_UNCOMPRESSED);
+    EXPECT_EQ(frames[1].reserved, nullptr);
+    std::vector<ChatMessageView> msgs;
+    auto collect = [&msgs](const ChatMessageView& msg) { msgs.push_back(msg); };
+    ASSERT_TRUE(ChatFrameCodec::parse_v2_payload(frames[1].body, frames[1].body_len, false, collect));
+    ASSERT_EQ(msgs.size(), 1u);
+    EXPECT_EQ(msgs[0].cmd, 1003);
+    EXPECT_EQ(msgs[0].seq, 42);
+    EXPECT_EQ(std::string(msgs[0].data, msgs[0].data_len), small);
+
+    EXPECT_EQ(frames[2].version, 1);
+    EXPECT_EQ(frames[2].compressflag, PACKAGE_COMPRESSED);
+
+    EXPECT_EQ(frames[3].version, 2);
+    EXPECT_TRUE(frames[3].batch);
+    msgs.clear();
+    ASSERT_TRUE(ChatFrameCodec::parse_v2_payload(frames[3].body, frames[3].body_len, true, collect));
+    ASSERT_EQ(msgs.size(), 2u);
+    EXPECT_EQ(msgs[0].cmd, 1001);
+    EXPECT_EQ(msgs[1].cmd, 1002);
+    EXPECT_EQ(msgs[1].seq, -1);
+    EXPECT_EQ(std::string(msgs[1].data, msgs[1].data_len), large);
+
+    // v2 压缩帧先解压再解析包体
+    EXPECT_EQ(frames[4].version, 2);
+    ASSERT_EQ(frames[4].compressflag, PACKAGE_COMPRESSED);
+    std::string payload;
+    ASSERT_TRUE(ZlibUtil::uncompressBuf(frames[4].body, frames[4].body_len, payload, frames[4].originsize));
+    msgs.clear();
+    ASSERT_TRUE(ChatFrameCodec::parse_v2_payload(payload.data(), payload.size(), false, collect));
+    ASSERT_EQ(msgs.size(), 1u);
+    EXPECT_EQ(msgs[0].cmd, 1004);
+    EXPECT_EQ(std::string(msgs[0].data, msgs[0].data_len), large);
+
+    // 最后一个帧只收到一半
+    frames = decode_all(stream.substr(0, stream.size() - 1), &last);
+    EXPECT_EQ(frames.size(), 4u);
+    EXPECT_EQ(last, ChatFrameCodec::kNeedMore);
+}
+
+// 测试格式不对的 v2 包体
+TEST_F(ChatFrameCodecTest, MalformedV2PayloadIsRejected) {
+    auto ignore = [](const ChatMessageView&) {};
+    // 批量帧里的消息长度超出包体
+    std::string batch = "\x10\x01\x01";
+    EXPECT_FALSE(ChatFrameCodec::parse_v2_payload(batch.data(), batch.size(), true, ignore));
+    // 单条消息 seq 没有结束
+    std::string single = "\x01\x80";
+    EXPECT_FALSE(ChatFrameCodec::parse_v2_payload(single.data(), single.size(), false, ignore));
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include "network/compress_policy.h"
+#include "msg.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+using namespace w_network;
+
+// 按 decision 真正压缩一次并报告结果，和 TcpSession 的用法一样
+static CompressPolicy::Decision send(CompressPolicy* policy, int32_t cmd, const std::string& data) {
+    CompressPolicy::Decision decision = policy->choose(cmd);
+    size_t out = data.size();
+    int64_t cpu_ns = 0;
+    if (decision.level != CompressPolicy::kStore) {
+        std::vector<Bytef> buf(compressBound(data.size()));
+        uLongf len = buf.size();
+        auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(compress2(buf.data(), &len, reinterpret_cast<const Bytef*>(data.data()), data.size(),
+                            CompressPolicy::zlib_level(decision.level)), Z_OK);
+        cpu_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        out = len;
+    }
+    policy->record(cmd, decision, data.size(), out, cpu_ns);
+    return decision;
+}
+
+static std::string random_bytes(size_t n) {
+    std::mt19937 rng(42);
+    std::string data(n, '\0');
+    for (char& c : data) {
+        c = static_cast<char>(rng());
+    }
+    return data;
+}
+
+static std::string json_text(size_t n) {
+    std::string data = "[";
+    for (int i = 0; data.size() < n; ++i) {
+        data += "{\"userid\":" + std::to_string(10000 + i) + ",\"nickname\":\"user" + std::to_string(i) +
+                "\",\"signature\":\"hello world\",\"status\":1},";
+    }
+    data.back() = ']';
+    return data;
+}
+
+// 测试压不下来的数据（图片等）热身之后选 store，只有抽样时才压缩
+TEST(CompressPolicyTest, IncompressibleConvergesToStore) {
+    CompressPolicy policy;
+    std::string data = random_bytes(8192);
+    int compressed = 0;
+    for (int i = 0; i < 300; ++i) {
+        CompressPolicy::Decision decision = send(&policy, 1000, data);
+        if (i >= 2 * CompressPolicy::warmup_samples && !decision.probe) {
+            EXPECT_EQ(decision.level, CompressPolicy::kStore) << i;
+        }
+        if (decision.level != CompressPolicy::kStore) {
+            ++compressed;
+        }
+    }
+    EXPECT_EQ(compressed, 2 * CompressPolicy::warmup_samples + 300 / CompressPolicy::probe_interval);
+    EXPECT_EQ(policy.counters().decisions[CompressPolicy::kStore].load(), 300 - compressed);
+}
+
+// 测试蜂窝网络上的 JSON 收敛到压缩；别的类型的统计互不影响
+TEST(CompressPolicyTest, JsonOnCellularCompresses) {
+    CompressPolicy policy;
+    policy.set_online_type(online_type_android_cellular);
+    EXPECT_EQ(policy.link(), CompressPolicy::kLinkCellular);
+
+    std::string json = json_text(8192);
+    std::string image = random_bytes(8192);
+    for (int i = 0; i < 300; ++i) {
+        CompressPolicy::Decision decision = send(&policy, 1001, json);
+        CompressPolicy::Decision other = send(&policy, 1002, image);
+        if (i >= 2 * CompressPolicy::warmup_samples && !decision.probe) {
+            EXPECT_NE(decision.level, CompressPolicy::kStore) << i;
+        }
+        if (i >= 2 * CompressPolicy::warmup_samples && !other.probe) {
+            EXPECT_EQ(other.level, CompressPolicy::kStore) << i;
+        }
+    }
+    EXPECT_LT(policy.counters().bytes_out.load(), policy.counters().bytes_in.load());
+}
+
+// 测试热身之后每 probe_interval 次选择抽样一次没选中的级别
+TEST(CompressPolicyTest, ProbesEveryInterval) {
+    CompressPolicy policy;
+    const int32_t cmd = 1003;
+    std::vector<int> probes;
+    std::vector<CompressPolicy::Level> probe_levels;
+    const int total = 10 * CompressPolicy::probe_interval;
+    for (int count = 1; count <= total; ++count) {
+        CompressPolicy::Decision decision = policy.choose(cmd);
+        if (count <= 2 * CompressPolicy::warmup_samples) {
+            // 热身：先 default 再 fast，都算抽样
+            EXPECT_EQ(decision.level, count <= CompressPolicy::warmup_samples ? CompressPolicy::kDefault : CompressPolicy::kFast);
+            EXPECT_TRUE(decision.probe);
+        } else if (decision.probe) {
+            probes.push_back(count);
+            probe_levels.push_back(decision.level);
+        } else {
+            EXPECT_EQ(decision.level, CompressPolicy::kStore);
+        }
+        // 压不下来：输出比输入还大
+        size_t out = decision.level == CompressPolicy::kStore ? 1000 : 1010;
+        policy.record(cmd, decision, 1000, out, 1000);
+    }
+
+    std::vector<int> expected;
+    for (int count = CompressPolicy::probe_interval; count <= total; count += CompressPolicy::probe_interval) {
+        expected.push_back(count);
+    }
+    EXPECT_EQ(probes, expected);
+    // best 是 store 时轮流抽样 fast 和 default
+    for (size_t i = 0; i < probe_levels.size(); ++i) {
+        EXPECT_EQ(probe_levels[i], i % 2 == 0 ? CompressPolicy::kFast : CompressPolicy::kDefault) << i;
+    }
+    EXPECT_EQ(policy.counters().probes.load(), static_cast<int64_t>(2 * CompressPolicy::warmup_samples + expected.size()));
+}
+
+// 测试包太小没压缩时只计数，不算作样本，热身不会被小包耗掉
+TEST(CompressPolicyTest, RecordSmallIsNotASample) {
+    CompressPolicy policy;
+    const int32_t cmd = 1004;
+    for (int i = 0; i < 10; ++i) {
+        CompressPolicy::Decision decision = policy.choose(cmd);
+        EXPECT_EQ(decision.level, CompressPolicy::kDefault);
+        EXPECT_TRUE(decision.probe);
+        policy.record_small();
+    }
+    EXPECT_EQ(policy.counters().too_small.load(), 10);
+    EXPECT_EQ(policy.counters().decisions[CompressPolicy::kDefault].load(), 0);
+    EXPECT_EQ(policy.counters().bytes_in.load(), 0);
+
+    for (int i = 0; i < CompressPolicy::warmup_samples; ++i) {
+        CompressPolicy::Decision decision = policy.choose(cmd);
+        EXPECT_EQ(decision.level, CompressPolicy::kDefault);
+        policy.record(cmd, decision, 1000, 300, 1000);
+    }
+    EXPECT_EQ(policy.choose(cmd).level, CompressPolicy::kFast);
+}
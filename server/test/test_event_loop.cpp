@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "network/event_loop.h"
+#include <chrono>
+
+using namespace w_network;
+
+// 这些测试里除了保护定时器没有任何 fd 事件，工作没被处理的话 loop 会一直阻塞到保护定时器超时
+class EventLoopTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        loop_.run_after(2 * 1000 * 1000, [this]() {
+            timed_out_ = true;
+            loop_.quit();
+        });
+    }
+
+    EventLoop loop_;
+    bool timed_out_ = false;
+};
+
+// 测试 loop 开始之前在 loop 线程投递的任务
+TEST_F(EventLoopTest, TaskQueuedBeforeLoopRuns) {
+    loop_.queue_in_loop([this]() { loop_.quit(); });
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+}
+
+// 测试 flush 回调里投递的任务（例如发送完成回调、关闭连接）
+TEST_F(EventLoopTest, TaskQueuedInFlushRuns) {
+    loop_.run_after(0, [this]() {
+        loop_.queue_flush([this]() {
+            loop_.queue_in_loop([this]() { loop_.quit(); });
+        });
+    });
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+}
+
+// 测试 flush 回调里再 queue_flush 的回调在下一轮执行
+TEST_F(EventLoopTest, FlushQueuedInFlushRuns) {
+    int flushes = 0;
+    loop_.run_after(0, [&]() {
+        loop_.queue_flush([&]() {
+            ++flushes;
+            loop_.queue_flush([&]() {
+                ++flushes;
+                loop_.quit();
+            });
+        });
+    });
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(flushes, 2);
+}
+
+// 测试 frame_functor_ 里投递的任务
+TEST_F(EventLoopTest, TaskQueuedInFrameFunctorRuns) {
+    bool armed = false;
+    bool queued = false;
+    loop_.set_frame_functor([&]() {
+        if (armed && !queued) {
+            queued = true;
+            loop_.queue_in_loop([this]() { loop_.quit(); });
+        }
+    });
+    loop_.run_after(0, [&]() { armed = true; });
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+}
+
+// 测试没有工作时 loop 仍然阻塞，不会因为上面的处理变成空转
+TEST_F(EventLoopTest, IdleLoopBlocks) {
+    loop_.run_after(0, [this]() {
+        loop_.queue_flush([this]() {
+            loop_.queue_in_loop([]() {});
+        });
+    });
+    loop_.run_after(200 * 1000, [this]() { loop_.quit(); });
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_LT(loop_.iteration(), 20);
+}
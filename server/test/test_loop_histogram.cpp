@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include "network/loop_metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace w_network;
+
+// 只记录 value 和一个最大值时，p50 落在 value 的桶里，得到的就是这个桶的上界
+static int64_t bucket_high(int64_t value) {
+    LoopHistogram histogram;
+    histogram.record(value);
+    histogram.record(std::numeric_limits<int64_t>::max());
+    return histogram.percentile(0.5);
+}
+
+// 测试空的直方图和负数
+TEST(LoopHistogramTest, EmptyAndNegative) {
+    LoopHistogram histogram;
+    LoopHistogram::Snapshot s = histogram.snapshot();
+    EXPECT_EQ(s.count, 0);
+    EXPECT_EQ(s.max, 0);
+    EXPECT_EQ(s.mean, 0.0);
+    EXPECT_EQ(s.p50, 0);
+    EXPECT_EQ(s.p999, 0);
+
+    // 时钟回拨时记成 0
+    histogram.record(-5);
+    EXPECT_EQ(histogram.count(), 1);
+    EXPECT_EQ(histogram.max(), 0);
+    EXPECT_EQ(histogram.percentile(0.5), 0);
+}
+
+// 测试 1 ~ 1000 的统计值
+TEST(LoopHistogramTest, KnownValues) {
+    LoopHistogram histogram;
+    for (int64_t v = 1; v <= 1000; ++v) {
+        histogram.record(v);
+    }
+    LoopHistogram::Snapshot s = histogram.snapshot();
+    EXPECT_EQ(s.count, 1000);
+    EXPECT_EQ(s.max, 1000);
+    EXPECT_DOUBLE_EQ(s.mean, 500.5);
+    // 500 在 [480, 511] 桶里，900 在 [896, 959] 桶里，990 和 999 在 [960, 1023] 桶里，不超过 max
+    EXPECT_EQ(s.p50, 511);
+    EXPECT_EQ(s.p90, 959);
+    EXPECT_EQ(s.p99, 1000);
+    EXPECT_EQ(s.p999, 1000);
+    EXPECT_EQ(histogram.percentile(0.0), 1);
+    EXPECT_EQ(histogram.percentile(1.0), 1000);
+}
+
+// 测试桶的边界：小于 sub_buckets 的值和第一段每个值一个桶，之后每段 2^e 分成 sub_buckets 个桶
+TEST(LoopHistogramTest, BucketBoundaries) {
+    for (int64_t v = 0; v < 2 * LoopHistogram::sub_buckets; ++v) {
+        EXPECT_EQ(bucket_high(v), v);
+    }
+    EXPECT_EQ(bucket_high(16), 17);
+    EXPECT_EQ(bucket_high(17), 17);
+    EXPECT_EQ(bucket_high(18), 19);
+    EXPECT_EQ(bucket_high(1023), 1023);
+    EXPECT_EQ(bucket_high(1024), 1024 + 1024 / LoopHistogram::sub_buckets - 1);
+
+    // 每个 2 的幂前后：上一个桶到 2^e - 1 结束，2^e 开始新桶，桶宽 2^e / sub_buckets
+    for (int e = LoopHistogram::sub_bucket_bits + 1; e < 62; ++e) {
+        int64_t p = int64_t(1) << e;
+        EXPECT_EQ(bucket_high(p - 1), p - 1) << e;
+        EXPECT_EQ(bucket_high(p), p + p / LoopHistogram::sub_buckets - 1) << e;
+        EXPECT_EQ(bucket_high(p + p / LoopHistogram::sub_buckets), p + 2 * (p / LoopHistogram::sub_buckets) - 1) << e;
+    }
+
+    // 最大值落在最后一个桶，上界不溢出
+    LoopHistogram histogram;
+    histogram.record(std::numeric_limits<int64_t>::max());
+    EXPECT_EQ(histogram.percentile(0.5), std::numeric_limits<int64_t>::max());
+    EXPECT_EQ(LoopHistogram::bucket_count, 488);
+}
+
+// 测试分位数的误差：不小于真实值，相对误差不超过 1/sub_buckets
+TEST(LoopHistogramTest, PercentileErrorBound) {
+    std::mt19937_64 rng(7);
+    std::uniform_real_distribution<double> exponent(0.0, 40.0);
+    std::vector<int64_t> values;
+    LoopHistogram histogram;
+    for (int i = 0; i < 100000; ++i) {
+        int64_t v = static_cast<int64_t>(std::pow(2.0, exponent(rng)));
+        values.push_back(v);
+        histogram.record(v);
+    }
+    std::sort(values.begin(), values.end());
+    EXPECT_EQ(histogram.max(), values.back());
+
+    for (double q : {0.01, 0.5, 0.9, 0.99, 0.999}) {
+        int64_t rank = static_cast<int64_t>(q * values.size() + 0.5);
+        int64_t exact = values[rank - 1];
+        int64_t reported = histogram.percentile(q);
+        EXPECT_GE(reported, exact) << q;
+        EXPECT_LE(reported - exact, exact / LoopHistogram::sub_buckets) << q;
+    }
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include "network/task_queue.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace w_network;
+
+// 测试单线程下按入队顺序执行
+TEST(TaskQueueTest, RunsTasksInOrder) {
+    TaskQueue queue;
+    std::vector<int> ran;
+    for (int i = 0; i < 100; ++i) {
+        queue.push([&ran, i]() { ran.push_back(i); });
+    }
+
+    EXPECT_EQ(queue.run_all(), 100u);
+    ASSERT_EQ(ran.size(), 100u);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(ran[i], i);
+    }
+    EXPECT_EQ(queue.run_all(), 0u);
+}
+
+// 测试任务里再入队的任务留到下一次 run_all()
+TEST(TaskQueueTest, TasksQueuedWhileRunningWaitForNextRound) {
+    TaskQueue queue;
+    int runs = 0;
+    std::function<void()> requeue;
+    requeue = [&]() {
+        ++runs;
+        queue.push([&]() { requeue(); });
+    };
+    queue.push([&]() { requeue(); });
+
+    EXPECT_EQ(queue.run_all(), 1u);
+    EXPECT_EQ(runs, 1);
+    EXPECT_EQ(queue.run_all(), 1u);
+    EXPECT_EQ(runs, 2);
+}
+
+// 测试最后一个任务出队之后再入队的任务不会丢
+TEST(TaskQueueTest, PushAfterDrainIsRun) {
+    TaskQueue queue;
+    int runs = 0;
+    for (int round = 0; round < 1000; ++round) {
+        queue.push([&]() { ++runs; });
+        ASSERT_EQ(queue.run_all(), 1u);
+    }
+    EXPECT_EQ(runs, 1000);
+}
+
+// 测试析构时释放没执行的任务
+TEST(TaskQueueTest, DestructorReleasesPendingTasks) {
+    std::shared_ptr<int> captured = std::make_shared<int>(0);
+    {
+        TaskQueue queue;
+        for (int i = 0; i < 10; ++i) {
+            queue.push([captured]() { ++*captured; });
+        }
+        EXPECT_EQ(captured.use_count(), 11);
+    }
+    EXPECT_EQ(captured.use_count(), 1);
+    EXPECT_EQ(*captured, 0);
+}
+
+// 压力测试：多个生产者一个消费者，每个任务都要执行，同一个生产者的任务按顺序执行。
+// 消费者在队列经常被取空的情况下反复 run_all()，覆盖取走最后一个节点时生产者同时入队的窗口
+TEST(TaskQueueTest, ManyProducersOneConsumerRunEveryTask) {
+    const int producers = 4;
+    const int tasks_per_producer = 200000;
+    const int total = producers * tasks_per_producer;
+
+    TaskQueue queue;
+    std::vector<int> next(producers, 0);
+    std::atomic<int> out_of_order(0);
+    int ran = 0;
+
+    std::atomic<bool> start(false);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            while (!start.load()) {
+                std::this_thread::yield();
+            }
+            for (int i = 0; i < tasks_per_producer; ++i) {
+                queue.push([&, p, i]() {
+                    if (next[p] != i) {
+                        ++out_of_order;
+                    }
+                    next[p] = i + 1;
+                    ++ran;
+                });
+                if (i % 64 == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    start = true;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (ran < total && std::chrono::steady_clock::now() < deadline) {
+        if (queue.run_all() == 0) {
+            std::this_thread::yield();
+        }
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    // 生产者都退出之后，剩下的任务一次 run_all() 就能执行完
+    queue.run_all();
+
+    EXPECT_EQ(ran, total);
+    EXPECT_EQ(out_of_order.load(), 0);
+}
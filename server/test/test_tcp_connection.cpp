@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include "network/event_loop.h"
+#include "network/output_budget.h"
+#include "network/tcp_connect.h"
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace w_network;
+
+// 连接建立在 socketpair 上，对端是测试自己持有的 fd，不读就能让连接的输出积压
+class TcpConnectionTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        loop_.run_after(5 * 1000 * 1000, [this]() {
+            timed_out_ = true;
+            loop_.quit();
+        });
+    }
+
+    void TearDown() override {
+        for (const TcpConnectionPtr& conn : conns_) {
+            conn->force_close();
+        }
+        loop_.run_after(20 * 1000, [this]() { loop_.quit(); });
+        loop_.loop();
+        conns_.clear();
+        for (int fd : peers_) {
+            ::close(fd);
+        }
+    }
+
+    // 创建连接，返回对端 fd；连接的发送缓冲设小，大块数据一次写不完
+    int make_conn(TcpConnectionPtr* conn) {
+        int fds[2];
+        EXPECT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        EXPECT_EQ(::fcntl(fds[0], F_SETFL, O_NONBLOCK), 0);
+        EXPECT_EQ(::fcntl(fds[1], F_SETFL, O_NONBLOCK), 0);
+        int sndbuf = 4096;
+        EXPECT_EQ(::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf), 0);
+
+        *conn = TcpConnection::create(&loop_, conns_.size() + 1, fds[0], InetAddress(), InetAddress());
+        (*conn)->set_conn_callback([](const TcpConnectionPtr&) {});
+        (*conn)->set_msg_callback([](const TcpConnectionPtr&, ByteBuffer* buffer, Timestamp) { buffer->bb_retrieve_all(); });
+        (*conn)->set_close_callback([this](const TcpConnectionPtr& closed) {
+            loop_.queue_in_loop([closed]() { closed->conn_destroyed(); });
+        });
+        conns_.push_back(*conn);
+        peers_.push_back(fds[1]);
+        return fds[1];
+    }
+
+    // 读掉对端收到的所有数据
+    static void drain(int fd) {
+        char buf[65536];
+        while (::read(fd, buf, sizeof buf) > 0) {
+        }
+    }
+
+    void check_read_backpressure(bool edge_triggered);
+
+    EventLoop loop_;
+    bool timed_out_ = false;
+    std::vector<TcpConnectionPtr> conns_;
+    std::vector<int> peers_;
+};
+
+// 每收到一个请求回 48 KB：第一个回包积压在 64 KB 以下，第二个超过 high_mark 暂停读。
+// 暂停期间到达的请求不读，对端把回包读走、积压降到 low_mark 以下才读到
+void TcpConnectionTest::check_read_backpressure(bool edge_triggered) {
+    const size_t high_mark = 64 * 1024;
+    const size_t low_mark = 16 * 1024;
+    TcpConnectionPtr conn;
+    int peer = make_conn(&conn);
+    // 预算足够大，只用来看输出队列的字节数
+    auto budget = std::make_shared<OutputBudget>(1024 * 1024 * 1024);
+    conn->set_output_budget(budget);
+    conn->set_edge_triggered(edge_triggered);
+    conn->set_read_backpressure(high_mark, low_mark);
+
+    std::string received;
+    conn->set_msg_callback([&](const TcpConnectionPtr& c, ByteBuffer* buffer, Timestamp) {
+        std::string request = buffer->bb_retrieve_all_as_string();
+        received += request;
+        if (request.find('c') != std::string::npos) {
+            // 恢复读的时候积压已经降到 low_mark 以下
+            EXPECT_LE(c->queued_output_bytes(), low_mark);
+            EXPECT_FALSE(c->reading_paused());
+            loop_.quit();
+            return;
+        }
+        c->send(std::string(48 * 1024, 'r'));
+    });
+    conn->conn_established();
+
+    ASSERT_EQ(::write(peer, "a", 1), 1);
+    loop_.run_after(20 * 1000, [&]() {
+        EXPECT_EQ(received, "a");
+        EXPECT_FALSE(conn->reading_paused());
+        EXPECT_GT(conn->queued_output_bytes(), 0u);
+        EXPECT_LT(conn->queued_output_bytes(), high_mark);
+        ASSERT_EQ(::write(peer, "b", 1), 1);
+    });
+    loop_.run_after(40 * 1000, [&]() {
+        EXPECT_EQ(received, "ab");
+        EXPECT_TRUE(conn->reading_paused());
+        EXPECT_GE(conn->queued_output_bytes(), high_mark);
+        ASSERT_EQ(::write(peer, "c", 1), 1);
+    });
+    TimerId drainer;
+    loop_.run_after(60 * 1000, [&]() {
+        // 暂停期间不读
+        EXPECT_EQ(received, "ab");
+        EXPECT_TRUE(conn->reading_paused());
+        // 恢复之后就不再读：对端不读，socket 不会再有新的可写边缘顺带报告可读，
+        // 边缘触发模式下只能靠恢复时主动读到 c
+        drainer = loop_.run_every(2 * 1000, [&conn, peer]() {
+            if (conn->reading_paused()) {
+                drain(peer);
+            }
+        });
+    });
+    loop_.loop();
+    loop_.remove(drainer);
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(received, "abc");
+}
+
+// 测试水平触发：暂停时关掉读事件，恢复时重新打开
+TEST_F(TcpConnectionTest, ReadBackpressureLevelTriggered) {
+    check_read_backpressure(false);
+}
+
+// 测试边缘触发：暂停期间到达数据的边缘已经错过，恢复时主动读一次
+TEST_F(TcpConnectionTest, ReadBackpressureEdgeTriggered) {
+    check_read_backpressure(true);
+}
+
+// 测试超出预算时按开始积压的先后关闭连接，腾出超出的部分就停；
+// 两次淘汰至少间隔 shed_interval_us，被关掉的连接关闭后把预算还回来
+TEST_F(TcpConnectionTest, OutputBudgetShedsOldestFirstAndRateLimits) {
+    auto budget = std::make_shared<OutputBudget>(300 * 1024);
+    TcpConnectionPtr a, b, c, d;
+    for (TcpConnectionPtr* conn : {&a, &b, &c, &d}) {
+        make_conn(conn);
+        (*conn)->set_output_budget(budget);
+        (*conn)->conn_established();
+    }
+    auto queued = [&]() {
+        return a->queued_output_bytes() + b->queued_output_bytes() + c->queued_output_bytes() + d->queued_output_bytes();
+    };
+
+    // a 最早开始积压，只关掉 a 就够了
+    a->send(std::string(150 * 1024, 'a'));
+    ::usleep(2000);
+    b->send(std::string(150 * 1024, 'b'));
+    ::usleep(2000);
+    c->send(std::string(150 * 1024, 'c'));
+    EXPECT_EQ(budget->shed_count(), 1);
+    EXPECT_FALSE(a->connected());
+    EXPECT_TRUE(b->connected());
+    EXPECT_TRUE(c->connected());
+    EXPECT_EQ(budget->used(), queued());
+
+    // 还在间隔内，超出预算也不淘汰
+    d->send(std::string(60 * 1024, 'd'));
+    EXPECT_GT(budget->used(), budget->budget());
+    EXPECT_EQ(budget->shed_count(), 1);
+    EXPECT_TRUE(b->connected());
+    EXPECT_TRUE(d->connected());
+
+    loop_.run_after(OutputBudget::shed_interval_us + 20 * 1000, [&]() {
+        // a 已经关闭，它的积压不再计入
+        EXPECT_EQ(a->queued_output_bytes(), 0u);
+        EXPECT_EQ(budget->used(), queued());
+
+        // 再次超出：剩下的连接里 b 最早，关掉 b 就够了
+        d->send(std::string(100 * 1024, 'd'));
+        EXPECT_EQ(budget->shed_count(), 2);
+        EXPECT_FALSE(b->connected());
+        EXPECT_TRUE(c->connected());
+        EXPECT_TRUE(d->connected());
+        loop_.quit();
+    });
+    loop_.loop();
+    EXPECT_FALSE(timed_out_);
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include "network/timer_heap.h"
+#include "network/timer.h"
+#include "network/event_loop.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace w_network;
+
+class TimerHeapTest : public ::testing::Test {
+protected:
+    Timer* make_timer(int64_t when_us) {
+        timers_.emplace_back(new Timer([]() {}, Timestamp(when_us), 0, 1));
+        return timers_.back().get();
+    }
+
+    // 每个元素记录的下标都要和它在堆中的位置一致，并且不小于父节点
+    void check_heap(const TimerHeap& heap) {
+        const std::vector<Timer*>& timers = heap.timers();
+        for (size_t i = 0; i < timers.size(); ++i) {
+            ASSERT_EQ(timers[i]->heap_index(), static_cast<int>(i));
+            if (i > 0) {
+                const Timer* parent = timers[(i - 1) / 4];
+                ASSERT_FALSE(timers[i]->expiration() < parent->expiration());
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Timer>> timers_;
+};
+
+// 测试按到期时间出堆
+TEST_F(TimerHeapTest, PopsInExpirationOrder) {
+    std::mt19937 rng(1);
+    TimerHeap heap;
+    for (int i = 0; i < 1000; ++i) {
+        heap.push(make_timer(rng() % 100000));
+    }
+    check_heap(heap);
+
+    int64_t last = -1;
+    while (!heap.empty()) {
+        Timer* timer = heap.pop();
+        EXPECT_EQ(timer->heap_index(), TimerHeap::not_in_heap);
+        EXPECT_GE(timer->expiration().microSecondsSinceEpoch(), last);
+        last = timer->expiration().microSecondsSinceEpoch();
+    }
+}
+
+// 测试到期时间相同时按创建顺序出堆
+TEST_F(TimerHeapTest, EqualExpirationKeepsCreationOrder) {
+    TimerHeap heap;
+    std::vector<Timer*> created;
+    for (int i = 0; i < 100; ++i) {
+        created.push_back(make_timer(42));
+    }
+    std::vector<Timer*> shuffled = created;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(2));
+    for (Timer* timer : shuffled) {
+        heap.push(timer);
+    }
+
+    for (Timer* timer : created) {
+        ASSERT_EQ(heap.pop(), timer);
+    }
+}
+
+// 测试删除任意元素后堆仍然有序
+TEST_F(TimerHeapTest, EraseKeepsHeapOrder) {
+    std::mt19937 rng(3);
+    TimerHeap heap;
+    std::vector<Timer*> live;
+    for (int i = 0; i < 2000; ++i) {
+        Timer* timer = make_timer(rng() % 5000);
+        heap.push(timer);
+        live.push_back(timer);
+    }
+
+    std::shuffle(live.begin(), live.end(), rng);
+    for (size_t i = 0; i < live.size() / 2; ++i) {
+        heap.erase(live[i]);
+        EXPECT_EQ(live[i]->heap_index(), TimerHeap::not_in_heap);
+        if (i % 100 == 0) {
+            check_heap(heap);
+        }
+    }
+    check_heap(heap);
+    EXPECT_EQ(heap.size(), live.size() - live.size() / 2);
+
+    // 不在堆中的定时器删除两次没有影响
+    heap.erase(live[0]);
+    EXPECT_EQ(heap.size(), live.size() - live.size() / 2);
+
+    int64_t last = -1;
+    while (!heap.empty()) {
+        int64_t when = heap.pop()->expiration().microSecondsSinceEpoch();
+        EXPECT_GE(when, last);
+        last = when;
+    }
+}
+
+class TimerQueueTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // 出错时不要让测试一直卡住
+        loop_.run_after(5 * 1000 * 1000, [this]() {
+            timed_out_ = true;
+            loop_.quit();
+        });
+    }
+
+    EventLoop loop_;
+    bool timed_out_ = false;
+};
+
+// 测试一次性定时器按到期时间依次触发
+TEST_F(TimerQueueTest, OneShotTimersFireInOrder) {
+    std::vector<int> fired;
+    loop_.run_after(30 * 1000, [&]() { fired.push_back(3); loop_.quit(); });
+    loop_.run_after(10 * 1000, [&]() { fired.push_back(1); });
+    loop_.run_after(20 * 1000, [&]() { fired.push_back(2); });
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(fired, std::vector<int>({1, 2, 3}));
+}
+
+// 测试删除后的定时器不再触发，包括在另一个定时器的回调里删除
+TEST_F(TimerQueueTest, RemovedTimersDoNotFire) {
+    int fired = 0;
+    TimerId removed = loop_.run_after(10 * 1000, [&]() { ++fired; });
+    loop_.remove(removed);
+
+    // 同一时刻到期，first 先执行并删除 second
+    Timestamp when = add_time(Timestamp::now(), 20 * 1000);
+    TimerId second;
+    loop_.run_at(when, [&]() { loop_.remove(second); });
+    second = loop_.run_at(when, [&]() { ++fired; });
+
+    loop_.run_after(40 * 1000, [&]() { loop_.quit(); });
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(fired, 0);
+}
+
+// 测试重复定时器在回调里删除自己
+TEST_F(TimerQueueTest, RepeatingTimerRemovesItself) {
+    int fired = 0;
+    TimerId every;
+    every = loop_.run_every(5 * 1000, [&]() {
+        if (++fired == 3) {
+            loop_.remove(every);
+            loop_.run_after(30 * 1000, [&]() { loop_.quit(); });
+        }
+    });
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(fired, 3);
+}
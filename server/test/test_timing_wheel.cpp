@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "network/event_loop.h"
+#include "network/timing_wheel.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace w_network;
+
+// 时间轮精度设为 1ms，断言只看 tick 数，不看实际时间
+class TimingWheelTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        loop_.run_after(5 * 1000 * 1000, [this]() {
+            timed_out_ = true;
+            loop_.quit();
+        });
+    }
+
+    // 到期时记下名字和当时的 tick，时间轮空了就退出 loop
+    TimerCallback record(TimingWheel* wheel, const std::string& name) {
+        return [this, wheel, name]() {
+            fired_.emplace_back(name, wheel->current_tick());
+            if (wheel->size() == 0) {
+                loop_.quit();
+            }
+        };
+    }
+
+    typedef std::vector<std::pair<std::string, int64_t>> Fired;
+
+    EventLoop loop_;
+    bool timed_out_ = false;
+    Fired fired_;
+};
+
+// 测试按到期时间先后触发，同一 tick 到期的按加入顺序；超时会多等一个 tick
+TEST_F(TimingWheelTest, ExpiresInDeadlineOrder) {
+    TimingWheel wheel(&loop_, 1, 8);
+    TimingWheel::Entry a, b, c, d;
+    wheel.add(&a, 5, record(&wheel, "a"));
+    wheel.add(&b, 2, record(&wheel, "b"));
+    wheel.add(&c, 7, record(&wheel, "c"));
+    wheel.add(&d, 2, record(&wheel, "d"));
+    EXPECT_EQ(wheel.size(), 4u);
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(fired_, Fired({{"b", 3}, {"d", 3}, {"a", 6}, {"c", 8}}));
+    EXPECT_FALSE(a.linked());
+}
+
+// 测试 touch 从当前 tick 重新计时，重新 add 会替换超时时间和回调
+TEST_F(TimingWheelTest, TouchRearms) {
+    TimingWheel wheel(&loop_, 1, 8);
+    TimingWheel::Entry idle, toucher, readded;
+    wheel.add(&idle, 3, record(&wheel, "idle"));
+
+    // 前 5 个 tick 每个 tick 都 touch 一次，idle 从第 5 个 tick 开始计时
+    std::function<void()> touch = [&]() {
+        wheel.touch(&idle);
+        if (wheel.current_tick() < 5) {
+            wheel.add(&toucher, 0, [&]() { touch(); });
+        }
+    };
+    wheel.add(&toucher, 0, [&]() { touch(); });
+
+    wheel.add(&readded, 1, record(&wheel, "first"));
+    wheel.add(&readded, 10, record(&wheel, "readded"));
+    EXPECT_EQ(wheel.size(), 3u);
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(fired_, Fired({{"idle", 9}, {"readded", 11}}));
+}
+
+// 测试超过一圈的超时：slot 转到时还没到期的节点留到后面的圈
+TEST_F(TimingWheelTest, TimeoutLongerThanWheel) {
+    TimingWheel wheel(&loop_, 1, 8);
+    TimingWheel::Entry near, far, farther;
+    wheel.add(&far, 20, record(&wheel, "far"));
+    wheel.add(&near, 3, record(&wheel, "near"));
+    wheel.add(&farther, 100, record(&wheel, "farther"));
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(fired_, Fired({{"near", 4}, {"far", 21}, {"farther", 101}}));
+}
+
+// 测试回调里删除同一 tick 到期的其他节点、删除别的 slot 的节点、再加入节点
+TEST_F(TimingWheelTest, RemoveDuringTick) {
+    TimingWheel wheel(&loop_, 1, 8);
+    TimingWheel::Entry a, b, c, later, added;
+    wheel.add(&later, 6, record(&wheel, "later"));
+    wheel.add(&a, 2, [&]() {
+        fired_.emplace_back("a", wheel.current_tick());
+        wheel.remove(&b);
+        wheel.remove(&later);
+        wheel.remove(&a);
+        wheel.add(&added, 1, record(&wheel, "added"));
+    });
+    wheel.add(&b, 2, record(&wheel, "b"));
+    wheel.add(&c, 2, record(&wheel, "c"));
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(fired_, Fired({{"a", 3}, {"c", 3}, {"added", 5}}));
+    EXPECT_FALSE(b.linked());
+    EXPECT_FALSE(later.linked());
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+// 测试时间轮空了以后停掉 tick 定时器，不再推进；再加入节点时重新启动
+TEST_F(TimingWheelTest, StopsTickingWhenEmpty) {
+    TimingWheel wheel(&loop_, 1, 8);
+    TimingWheel::Entry entry, removed;
+    EXPECT_FALSE(wheel.ticking());
+
+    int64_t stopped_at = -1;
+    wheel.add(&entry, 2, [&]() {
+        // 回调返回之后才停
+        loop_.queue_in_loop([&]() {
+            EXPECT_FALSE(wheel.ticking());
+            stopped_at = wheel.current_tick();
+            loop_.run_after(30 * 1000, [&]() {
+                EXPECT_EQ(wheel.current_tick(), stopped_at);
+
+                // 重新启动；中途 remove 掉的节点不会触发
+                wheel.add(&removed, 100, [&]() { ADD_FAILURE(); });
+                EXPECT_TRUE(wheel.ticking());
+                wheel.remove(&removed);
+                wheel.add(&entry, 3, record(&wheel, "restarted"));
+            });
+        });
+    });
+    EXPECT_TRUE(wheel.ticking());
+    loop_.loop();
+
+    EXPECT_FALSE(timed_out_);
+    EXPECT_EQ(stopped_at, 3);
+    EXPECT_EQ(fired_, Fired({{"restarted", 3 + 4}}));
+
+    // 最后一个节点到期后又停掉
+    EXPECT_FALSE(wheel.ticking());
+}
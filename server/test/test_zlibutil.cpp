@@ -0,0 +1,340 @@
+#include <gtest/gtest.h>
+#include "common/zlibutil.h"
+#include "network/chat_frame_codec.h"
+#include "network/tcp_session.h"
+#include "zlib.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace w_network;
+
+// 有重复键的 JSON，和聊天包体差不多
+static std::string make_json(std::mt19937& rng, size_t n) {
+    static const char* keys[] = {"userid", "nickname", "status", "clienttype", "signature", "msgText"};
+    std::string s = "{";
+    while (s.size() < n) {
+        s += "\"";
+        s += keys[rng() % 6];
+        s += "\":\"" + std::to_string(rng() % 100000) + "\",";
+    }
+    s.resize(n);
+    s.back() = '}';
+    return s;
+}
+
+static std::string make_random(std::mt19937& rng, size_t n) {
+    std::string s(n, '\0');
+    for (char& c : s) {
+        c = static_cast<char>(rng());
+    }
+    return s;
+}
+
+// 用 zlib 自己的 uncompress() 解，确认输出是标准格式
+static bool zlib_uncompress(const std::string& src, size_t origin_len, std::string* out) {
+    out->assign(origin_len, '\0');
+    uLongf len = origin_len;
+    if (::uncompress(reinterpret_cast<Bytef*>(&(*out)[0]), &len,
+                     reinterpret_cast<const Bytef*>(src.data()), src.size()) != Z_OK) {
+        return false;
+    }
+    out->resize(len);
+    return true;
+}
+
+// 测试不同长度（跨过小包上下文的 4096 边界）压缩再解压都还原，对端用 uncompress() 也能解
+TEST(ZlibUtilTest, RoundTripAcrossSizes) {
+    std::mt19937 rng(1);
+    for (size_t n : {1, 15, 64, 256, 1024, 4095, 4096, 4097, 65536, 1 << 20}) {
+        std::string src = make_json(rng, n);
+        std::string compressed;
+        ASSERT_TRUE(ZlibUtil::compressBuf(src, compressed)) << n;
+
+        std::string back;
+        ASSERT_TRUE(ZlibUtil::uncompressBuf(compressed, back, src.size())) << n;
+        EXPECT_EQ(back, src) << n;
+        ASSERT_TRUE(zlib_uncompress(compressed, src.size(), &back)) << n;
+        EXPECT_EQ(back, src) << n;
+    }
+}
+
+// 测试压缩、解压结果追加在原有内容后面
+TEST(ZlibUtilTest, AppendsToDestination) {
+    std::mt19937 rng(2);
+    std::string src = make_json(rng, 500);
+
+    std::string compressed = "header";
+    ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), compressed));
+    EXPECT_EQ(compressed.compare(0, 6, "header"), 0);
+
+    std::string back = "prefix";
+    ASSERT_TRUE(ZlibUtil::uncompressBuf(compressed.data() + 6, compressed.size() - 6, back, src.size()));
+    EXPECT_EQ(back, "prefix" + src);
+
+    // 固定缓冲区的版本
+    std::vector<char> buf(compressBound(src.size()));
+    size_t len = buf.size();
+    ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), buf.data(), len));
+    EXPECT_EQ(std::string(buf.data(), len), compressed.substr(6));
+}
+
+// 测试每个压缩级别，同一个线程的上下文在级别之间来回切换
+TEST(ZlibUtilTest, EveryLevelRoundTrips) {
+    std::mt19937 rng(3);
+    for (size_t n : {300, 20000}) {
+        std::string src = make_json(rng, n);
+        size_t stored = 0;
+        size_t best = 0;
+        for (int level = -1; level <= 9; ++level) {
+            std::string compressed;
+            ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), compressed, 0, level)) << level;
+            std::string back;
+            ASSERT_TRUE(zlib_uncompress(compressed, src.size(), &back)) << level;
+            EXPECT_EQ(back, src) << level;
+            if (level == 0) {
+                stored = compressed.size();
+            } else if (level == 9) {
+                best = compressed.size();
+            }
+        }
+        // 0 级只存储，比原数据还大
+        EXPECT_GT(stored, src.size());
+        EXPECT_LT(best, src.size());
+    }
+
+    std::string out;
+    EXPECT_FALSE(ZlibUtil::compressBuf("abc", 3, out, 0, 10));
+    EXPECT_FALSE(ZlibUtil::compressBuf("abc", 3, out, 0, -2));
+    EXPECT_TRUE(out.empty());
+}
+
+// 测试压不下来的数据。小包上下文 memLevel 低，输出可能超过 compressBound()，要换大上下文重压
+TEST(ZlibUtilTest, IncompressibleInputRoundTrips) {
+    std::mt19937 rng(4);
+    for (size_t n = 1; n <= 8192; n += 97) {
+        std::string src = make_random(rng, n);
+        for (int level : {-1, 1, 9}) {
+            std::string compressed;
+            ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), compressed, 0, level)) << n << " " << level;
+            EXPECT_LE(compressed.size(), compressBound(n)) << n;
+            std::string back;
+            ASSERT_TRUE(ZlibUtil::uncompressBuf(compressed, back, src.size())) << n;
+            ASSERT_EQ(back, src) << n;
+        }
+    }
+}
+
+// 测试不合法的输入
+TEST(ZlibUtilTest, RejectsBadInput) {
+    std::string out = "keep";
+    EXPECT_FALSE(ZlibUtil::compressBuf(std::string(), out));
+    EXPECT_FALSE(ZlibUtil::compressBuf(std::string(10 * 1024 * 1024 + 1, 'x'), out));
+    EXPECT_EQ(out, "keep");
+
+    // 不是 zlib 数据
+    EXPECT_FALSE(ZlibUtil::uncompressBuf(std::string("not zlib data"), out, 100));
+    EXPECT_EQ(out, "keep");
+
+    // 给的解压后大小不够
+    std::string src(1000, 'a');
+    std::string compressed;
+    ASSERT_TRUE(ZlibUtil::compressBuf(src, compressed));
+    EXPECT_FALSE(ZlibUtil::uncompressBuf(compressed, out, 999));
+    EXPECT_EQ(out, "keep");
+
+    // 截断的数据
+    EXPECT_FALSE(ZlibUtil::uncompressBuf(compressed.substr(0, compressed.size() - 1), out, 1000));
+    EXPECT_EQ(out, "keep");
+}
+
+// 测试小于 getMinCompressSize() 的包体不压缩
+TEST(ZlibUtilTest, MinCompressSizeSkipsSmallFrames) {
+    size_t old_size = ZlibUtil::getMinCompressSize();
+    ZlibUtil::setMinCompressSize(100);
+    EXPECT_EQ(ZlibUtil::getMinCompressSize(), 100u);
+
+    std::string body(100, 'b');
+    FrameCompressInfo info;
+    ChainBuffer::Payload small = TcpSession::make_frame(body.data(), 99, 0, -1, &info);
+    ASSERT_TRUE(small);
+    EXPECT_FALSE(info.attempted);
+    EXPECT_EQ(small->at(0), PACKAGE_UNCOMPRESSED);
+
+    info = FrameCompressInfo();
+    ChainBuffer::Payload large = TcpSession::make_frame(body.data(), 100, 0, -1, &info);
+    ASSERT_TRUE(large);
+    EXPECT_TRUE(info.attempted);
+    EXPECT_EQ(large->at(0), PACKAGE_COMPRESSED);
+
+    // 0 表示全部压缩
+    ZlibUtil::setMinCompressSize(0);
+    ChainBuffer::Payload tiny = TcpSession::make_frame(body.data(), 1);
+    ASSERT_TRUE(tiny);
+    EXPECT_EQ(tiny->at(0), PACKAGE_COMPRESSED);
+
+    ZlibUtil::setMinCompressSize(old_size);
+}
+
+// 测试多个线程同时压缩解压，各自的上下文互不影响
+TEST(ZlibUtilTest, ThreadsUseTheirOwnContexts) {
+    std::atomic<int> failures(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&failures, t]() {
+            std::mt19937 rng(t);
+            for (int i = 0; i < 2000; ++i) {
+                std::string src = (i % 3 == 0) ? make_random(rng, 1 + rng() % 6000) : make_json(rng, 1 + rng() % 6000);
+                std::string compressed;
+                std::string back;
+                if (!ZlibUtil::compressBuf(src.data(), src.size(), compressed, 0, static_cast<int>(rng() % 11) - 1) ||
+                    !ZlibUtil::uncompressBuf(compressed, back, src.size()) || back != src) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(failures.load(), 0);
+}
+
+class ZlibDictionaryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::mt19937 rng(100);
+        dict_ = make_json(rng, 2048);
+        dict_id_ = ZlibUtil::addDictionary(dict_);
+    }
+
+    std::string dict_;
+    uint32_t dict_id_ = 0;
+};
+
+// 测试字典 id 就是字典内容的 adler32
+TEST_F(ZlibDictionaryTest, IdIsAdler32OfDictionary) {
+    uLong adler = ::adler32(::adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(dict_.data()), dict_.size());
+    EXPECT_EQ(dict_id_, static_cast<uint32_t>(adler));
+    EXPECT_TRUE(ZlibUtil::hasDictionary(dict_id_));
+    EXPECT_FALSE(ZlibUtil::hasDictionary(0));
+    EXPECT_EQ(ZlibUtil::addDictionary(std::string()), 0u);
+}
+
+// 测试用字典压缩，uncompressBuf 按流头的 DICTID 自动找到字典解压
+TEST_F(ZlibDictionaryTest, RoundTripFindsDictionaryById) {
+    std::mt19937 rng(101);
+    for (size_t n : {40, 300, 4096, 20000}) {
+        std::string src = make_json(rng, n);
+        for (int level : {-1, 1, 9}) {
+            std::string with_dict;
+            ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), with_dict, dict_id_, level)) << n;
+            std::string back;
+            ASSERT_TRUE(ZlibUtil::uncompressBuf(with_dict, back, src.size())) << n;
+            EXPECT_EQ(back, src) << n;
+
+            // 确实用了字典：不带字典的 uncompress() 解不了
+            EXPECT_FALSE(zlib_uncompress(with_dict, src.size(), &back)) << n;
+        }
+    }
+
+    // 短的 JSON 有字典时压得更小
+    std::string src = make_json(rng, 120);
+    std::string plain;
+    std::string with_dict;
+    ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), plain));
+    ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), with_dict, dict_id_));
+    EXPECT_LT(with_dict.size(), plain.size());
+}
+
+// 测试同一个线程上下文用过字典之后，不带字典的压缩不受影响
+TEST_F(ZlibDictionaryTest, ReusedContextDropsDictionary) {
+    std::mt19937 rng(102);
+    std::string src = make_json(rng, 500);
+    std::string with_dict;
+    ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), with_dict, dict_id_));
+
+    std::string plain;
+    ASSERT_TRUE(ZlibUtil::compressBuf(src.data(), src.size(), plain));
+    std::string back;
+    ASSERT_TRUE(zlib_uncompress(plain, src.size(), &back));
+    EXPECT_EQ(back, src);
+}
+
+// 测试没有加载的字典：压缩直接失败，解压不出来
+TEST_F(ZlibDictionaryTest, UnknownDictionaryFails) {
+    std::string src(500, 'u');
+    std::string out;
+    uint32_t unknown = dict_id_ + 1;
+    ASSERT_FALSE(ZlibUtil::hasDictionary(unknown));
+    EXPECT_FALSE(ZlibUtil::compressBuf(src.data(), src.size(), out, unknown));
+    EXPECT_TRUE(out.empty());
+
+    // 对端用服务器没有的字典压缩
+    std::string other = "another dictionary that was never loaded";
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    ASSERT_EQ(::deflateInit(&zs, Z_DEFAULT_COMPRESSION), Z_OK);
+    ASSERT_EQ(::deflateSetDictionary(&zs, reinterpret_cast<const Bytef*>(other.data()), other.size()), Z_OK);
+    std::string compressed(compressBound(src.size()) + 4, '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(&src[0]);
+    zs.avail_in = src.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    zs.avail_out = compressed.size();
+    ASSERT_EQ(::deflate(&zs, Z_FINISH), Z_STREAM_END);
+    compressed.resize(zs.total_out);
+    ::deflateEnd(&zs);
+
+    out = "keep";
+    EXPECT_FALSE(ZlibUtil::uncompressBuf(compressed, out, src.size()));
+    EXPECT_EQ(out, "keep");
+}
+
+// 测试从文件加载字典
+TEST_F(ZlibDictionaryTest, LoadsDictionaryFromFile) {
+    std::string path = ::testing::TempDir() + "talko_test.zdict";
+    FILE* file = fopen(path.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    fwrite(dict_.data(), 1, dict_.size(), file);
+    fclose(file);
+
+    uint32_t id = 0;
+    EXPECT_TRUE(ZlibUtil::loadDictionary(path, id));
+    EXPECT_EQ(id, dict_id_);
+    remove(path.c_str());
+
+    EXPECT_FALSE(ZlibUtil::loadDictionary(path, id));
+}
+
+// 测试 make_frame 把字典 id 写进包头，解码后能按 dictid 解压
+TEST_F(ZlibDictionaryTest, FrameCarriesDictionaryId) {
+    std::mt19937 rng(103);
+    std::string body = make_json(rng, 300);
+    ChainBuffer::Payload package = TcpSession::make_frame(body.data(), body.size(), dict_id_);
+    ASSERT_TRUE(package);
+
+    ChatFrameCodec codec([](const TcpConnectionPtr&, const ChatFrame&, Timestamp) {});
+    ChatFrame frame;
+    size_t n = 0;
+    const char* reason = nullptr;
+    ASSERT_EQ(codec.decode(package->data(), package->size(), &frame, &n, &reason), ChatFrameCodec::kFrame);
+    EXPECT_EQ(frame.compressflag, PACKAGE_COMPRESSED);
+    EXPECT_EQ(frame.dictid, dict_id_);
+    std::string back;
+    ASSERT_TRUE(ZlibUtil::uncompressBuf(frame.body, frame.body_len, back, frame.originsize));
+    EXPECT_EQ(back, body);
+
+    // 不压缩的小包不带字典 id
+    ChainBuffer::Payload small = TcpSession::make_frame(body.data(), 10, dict_id_);
+    ASSERT_TRUE(small);
+    ASSERT_EQ(codec.decode(small->data(), small->size(), &frame, &n, &reason), ChatFrameCodec::kFrame);
+    EXPECT_EQ(frame.compressflag, PACKAGE_UNCOMPRESSED);
+    EXPECT_EQ(frame.dictid, 0u);
+
+    // 没有加载的字典生成不了帧
+    EXPECT_FALSE(TcpSession::make_frame(body.data(), body.size(), dict_id_ + 1));
+}